@@ -0,0 +1,54 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#version 330
+
+uniform float uModelID;
+uniform float uZFar;
+
+in float vDepth;
+
+layout(location = 0) out vec4 fragColor;
+
+// blended with GL_MAX and without a depth test, such that a single pass yields
+// R: zFar minus the metric depth of the front surface (0 where no model is rendered)
+// G: the metric depth of the back surface
+// B: the front depth buffer value quantized to 16 bits followed by the model ID in the
+//    lowest 8 bits, exactly representable in a float, such that the ID of the front
+//    surface wins (the depth range is inverted, so the front has the largest value)
+void main()
+{
+	fragColor = vec4(uZFar - vDepth, vDepth, floor(gl_FragCoord.z*65535.0)*256.0 + uModelID, 0.0);
+}
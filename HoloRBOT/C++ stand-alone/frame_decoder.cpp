@@ -0,0 +1,116 @@
+#include "frame_decoder.h"
+
+#include <iostream>
+
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+using namespace cv;
+
+FrameDecoder::FrameDecoder(FrameRing &input, FrameRing &output, int numThreads) : input(input), output(output)
+{
+    lastPublishedID = -1;
+    numCorrupt = 0;
+    
+    numThreads = max(numThreads, 1);
+    numRunning = numThreads;
+    for(int i = 0; i < numThreads; i++)
+    {
+        workers.push_back(thread(&FrameDecoder::run, this));
+    }
+}
+
+FrameDecoder::~FrameDecoder()
+{
+    for(int i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+uint64_t FrameDecoder::getNumCorrupt()
+{
+    return numCorrupt;
+}
+
+void FrameDecoder::run()
+{
+    while(true)
+    {
+        int inSlot = input.waitForNewest(100);
+        if(inSlot < 0)
+        {
+            if(input.isClosed())
+                break;
+            continue;
+        }
+        
+        FrameBuffer &src = input.getFrame(inSlot);
+        
+        int outSlot = output.beginWrite();
+        FrameBuffer &dst = output.getFrame(outSlot);
+        
+        bool decoded = decode(src, dst);
+        int64_t frameID = src.header.frameID;
+        
+        input.release(inSlot);
+        
+        if(!decoded)
+        {
+            output.abortWrite(outSlot);
+            numCorrupt++;
+            continue;
+        }
+        
+        // only publish the frame if no other worker has published a newer one in the meantime
+        lock_guard<mutex> lock(publishMutex);
+        if(frameID > lastPublishedID)
+        {
+            lastPublishedID = frameID;
+            output.commitWrite(outSlot);
+        }
+        else
+            output.abortWrite(outSlot);
+    }
+    
+    // the last worker tells the consumer that no more frames will follow
+    if(--numRunning == 0)
+        output.close();
+}
+
+bool FrameDecoder::decode(FrameBuffer &src, FrameBuffer &dst)
+{
+    dst.header = src.header;
+    dst.receiveTimestamp = src.receiveTimestamp;
+    dst.header.pixelFormat = PIXEL_FORMAT_BGR;
+    
+    size_t length = (size_t)src.header.width*src.header.height*3;
+    if(length > dst.payload.size())
+    {
+        cout << "decoded frame " << src.header.frameID << " would exceed the slot size (" << src.header.width << "x" << src.header.height << ")" << endl;
+        return false;
+    }
+    dst.header.payloadLength = (uint32_t)length;
+    
+    // decode straight into the slot, imdecode only reallocates if the encoded image size does not match the header
+    Mat image;
+    try
+    {
+        image = dst.image();
+        imdecode(Mat(1, src.header.payloadLength, CV_8UC1, src.payload.data()), IMREAD_COLOR, &image);
+    }
+    catch(cv::Exception &e)
+    {
+        // an uncaught exception would terminate the whole server
+        cout << "failed to decode frame " << src.header.frameID << ": " << e.what() << endl;
+        return false;
+    }
+    
+    if(image.data != dst.payload.data())
+    {
+        cout << "failed to decode frame " << src.header.frameID << endl;
+        return false;
+    }
+    
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef FRAME_DECODER_H
+#define FRAME_DECODER_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+
+#include "frame_ring.h"
+
+/**
+ *  A pool of worker threads decoding compressed frames (JPEG, PNG) taken
+ *  from an input ring. Every frame is decoded directly into the payload of
+ *  a slot of the output ring, i.e. into the BGR image that is handed to the
+ *  pose estimator as the first level of its image pyramid, such that no
+ *  copy is needed after decoding.
+ *
+ *  Frames finishing out of order are dropped if a newer frame has already
+ *  been published, so the consumer always sees increasing frame ids.
+ */
+class FrameDecoder
+{
+public:
+    /**
+     *  Constructor of the decoder starting all worker threads.
+     *
+     *  @param  input The ring the compressed frames are taken from.
+     *  @param  output The ring the decoded frames are published to, with at least numThreads + 2 slots each holding a BGR image of the largest frame size.
+     *  @param  numThreads The number of decoding threads.
+     */
+    FrameDecoder(FrameRing &input, FrameRing &output, int numThreads);
+    
+    /**
+     *  Waits for all worker threads to finish, which happens once the input
+     *  ring has been closed.
+     */
+    ~FrameDecoder();
+    
+    /**
+     *  Returns the number of frames that could not be decoded.
+     *
+     *  @return The number of corrupt frames.
+     */
+    uint64_t getNumCorrupt();
+
+private:
+    FrameRing &input;
+    FrameRing &output;
+    
+    std::vector<std::thread> workers;
+    std::atomic<int> numRunning;
+    
+    // publishing is serialized, such that frame ids reach the output ring in increasing order
+    std::mutex publishMutex;
+    int64_t lastPublishedID;
+    
+    std::atomic<uint64_t> numCorrupt;
+    
+    void run();
+    
+    bool decode(FrameBuffer &src, FrameBuffer &dst);
+};
+
+#endif /* FRAME_DECODER_H */
@@ -0,0 +1,79 @@
+#include "frame_protocol.h"
+
+#include <chrono>
+
+size_t FrameProtocol::payloadLength(uint32_t pixelFormat, uint32_t width, uint32_t height)
+{
+    size_t numPixels = (size_t)width*height;
+    
+    // the chroma of YUV frames is subsampled by pixel pairs
+    bool even = width % 2 == 0 && height % 2 == 0;
+    
+    switch (pixelFormat)
+    {
+        case PIXEL_FORMAT_BGRA:
+        case PIXEL_FORMAT_RGBA:
+            return 4*numPixels;
+        case PIXEL_FORMAT_BGR:
+            return 3*numPixels;
+        case PIXEL_FORMAT_NV12:
+            return even ? numPixels*3/2 : 0;
+        case PIXEL_FORMAT_YUYV:
+            return even ? 2*numPixels : 0;
+        default:
+            return 0;
+    }
+}
+
+cv::Mat FrameProtocol::image(const FrameHeader &header, void *payload)
+{
+    switch (header.pixelFormat)
+    {
+        case PIXEL_FORMAT_BGR:
+            return cv::Mat(header.height, header.width, CV_8UC3, payload);
+        case PIXEL_FORMAT_NV12:
+            return cv::Mat(header.height*3/2, header.width, CV_8UC1, payload);
+        case PIXEL_FORMAT_YUYV:
+            return cv::Mat(header.height, header.width, CV_8UC2, payload);
+        default:
+            return cv::Mat(header.height, header.width, CV_8UC4, payload);
+    }
+}
+
+bool FrameProtocol::validateHeader(const FrameHeader &header, size_t maxPayloadLength, uint32_t maxWidth, uint32_t maxHeight, uint32_t codec)
+{
+    if(header.magic != FRAME_MAGIC || header.scaleShift > 3)
+        return false;
+    
+    // scaled and cropped frames are smaller, so the image size of a valid frame never overflows
+    if(header.width == 0 || header.height == 0 || header.width > maxWidth || header.height > maxHeight)
+        return false;
+    
+    if(codec != FRAME_CODEC_RAW)
+        return header.payloadLength > 0 && header.payloadLength <= maxPayloadLength;
+    
+    size_t length = payloadLength(header.pixelFormat, header.width, header.height);
+    
+    if(length == 0 || length != header.payloadLength)
+        return false;
+    
+    return header.payloadLength <= maxPayloadLength;
+}
+
+int FrameProtocol::selectCodec(uint32_t clientCodecs, uint32_t serverCodecs)
+{
+    const int preference[] = {FRAME_CODEC_JPEG, FRAME_CODEC_PNG, FRAME_CODEC_RAW};
+    
+    uint32_t common = clientCodecs & serverCodecs;
+    for(int i = 0; i < 3; i++)
+    {
+        if(common & (1 << preference[i]))
+            return preference[i];
+    }
+    return -1;
+}
+
+uint64_t FrameProtocol::timestamp()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
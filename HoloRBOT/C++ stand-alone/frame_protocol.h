@@ -0,0 +1,336 @@
+#ifndef FRAME_PROTOCOL_H
+#define FRAME_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <opencv2/core.hpp>
+
+/**
+ *  Magic number opening every frame header on the wire ("HRBF" in little endian).
+ */
+#define FRAME_MAGIC 0x46425248
+
+/**
+ *  Magic number opening the handshake messages exchanged once after
+ *  connecting ("HRBH" in little endian).
+ */
+#define HELLO_MAGIC 0x48425248
+
+/**
+ *  The version of the protocol implemented by the server.
+ */
+#define PROTOCOL_VERSION 5
+
+/**
+ *  Magic number opening the crop request sent back to the client after
+ *  every frame ("HRBC" in little endian).
+ */
+#define CROP_MAGIC 0x43425248
+
+/**
+ *  Magic number opening the pose reply following every crop request
+ *  ("HRBP" in little endian).
+ */
+#define POSE_MAGIC 0x50425248
+
+/**
+ *  Magic number opening a command message, which a client may send
+ *  between two frames ("HRBM" in little endian).
+ */
+#define COMMAND_MAGIC 0x4D425248
+
+/**
+ *  The pixel layouts a client may use for the payload of a frame. YUV
+ *  frames are tracked in YUV directly, they must have an even width and
+ *  height.
+ */
+enum PixelFormat
+{
+    PIXEL_FORMAT_BGRA = 0,
+    PIXEL_FORMAT_BGR = 1,
+    PIXEL_FORMAT_RGBA = 2,
+    
+    // the Y plane directly followed by the interleaved UV plane of half the width and height
+    PIXEL_FORMAT_NV12 = 4,
+    
+    // packed 4:2:2, Y0 U Y1 V for every two pixels
+    PIXEL_FORMAT_YUYV = 5
+};
+
+/**
+ *  The encodings a frame payload may use. Compressed payloads are decoded
+ *  with OpenCV into BGR images of the size given in the frame header.
+ */
+enum FrameCodec
+{
+    FRAME_CODEC_RAW = 0,
+    FRAME_CODEC_JPEG = 1,
+    FRAME_CODEC_PNG = 2
+};
+
+/**
+ *  The commands a client can send to control the tracking of a session.
+ */
+enum TrackingCommand
+{
+    // start tracking the object(s) in their initial pose with the next frame
+    COMMAND_START_TRACKING = 0,
+    
+    // stop tracking the object(s)
+    COMMAND_STOP_TRACKING = 1,
+    
+    // stop tracking all objects and move them back to their initial poses
+    COMMAND_RESET = 2
+};
+
+/**
+ *  Bits of the tracking state of an object in a pose reply.
+ */
+enum ObjectPoseFlags
+{
+    // tracking has been started for the object
+    OBJECT_POSE_INITIALIZED = 1,
+    
+    // the object is currently lost and the pose is not valid
+    OBJECT_POSE_LOST = 2,
+    
+    // the pose has been extrapolated to the display timestamp of the frame
+    OBJECT_POSE_EXTRAPOLATED = 4
+};
+
+#pragma pack(push, 1)
+
+/**
+ *  The first message sent by a client after connecting, announcing the
+ *  codecs it is able to encode frames with.
+ */
+struct HelloMessage
+{
+    // Must be HELLO_MAGIC.
+    uint32_t magic;
+    
+    // The protocol version the client implements.
+    uint32_t version;
+    
+    // A bit mask with bit (1 << codec) set for every supported FrameCodec.
+    uint32_t supportedCodecs;
+};
+
+/**
+ *  The answer of the server to a HelloMessage, telling the client which
+ *  codec to use for all following frames.
+ */
+struct HelloReply
+{
+    // Must be HELLO_MAGIC.
+    uint32_t magic;
+    
+    // The protocol version the server implements.
+    uint32_t version;
+    
+    // The FrameCodec chosen for the session.
+    uint32_t codec;
+    
+    // The largest frame size in pixels accepted by the server.
+    uint32_t maxWidth;
+    uint32_t maxHeight;
+};
+
+/**
+ *  The fixed size header preceding every camera frame sent by a client.
+ *  All fields are little endian. The header is directly followed by
+ *  payloadLength bytes of pixel data.
+ */
+struct FrameHeader
+{
+    // Must be FRAME_MAGIC.
+    uint32_t magic;
+    
+    // Consecutive number of the frame assigned by the client.
+    uint32_t frameID;
+    
+    // The time at which the frame was captured in microseconds (client clock).
+    uint64_t captureTimestamp;
+    
+    // The image size in pixels.
+    uint32_t width;
+    uint32_t height;
+    
+    // One of PixelFormat (only used for FRAME_CODEC_RAW).
+    uint32_t pixelFormat;
+    
+    // The number of bytes following the header.
+    uint32_t payloadLength;
+    
+    // The position of the frame within the full resolution camera image,
+    // (0, 0) for uncropped frames.
+    int32_t cropX;
+    int32_t cropY;
+    
+    // The frame is downscaled by 2^scaleShift wrt the full resolution, i.e.
+    // it covers (width << scaleShift) x (height << scaleShift) camera pixels.
+    uint32_t scaleShift;
+    
+    // The time at which the client will display the poses estimated from
+    // this frame (client clock), the server extrapolates the poses to it.
+    // 0 or a time before the capture disables the extrapolation.
+    uint64_t displayTimestamp;
+};
+
+/**
+ *  A command sent by a client instead of a frame header. It is applied
+ *  before the next frame is processed.
+ */
+struct CommandMessage
+{
+    // Must be COMMAND_MAGIC.
+    uint32_t magic;
+    
+    // One of TrackingCommand.
+    uint32_t command;
+    
+    // The index of the object the command refers to, -1 for all objects.
+    int32_t objectIndex;
+};
+
+/**
+ *  Sent by the server after every processed frame, telling the client
+ *  which region of the camera image to send next and at which scale.
+ */
+struct CropRequest
+{
+    // Must be CROP_MAGIC.
+    uint32_t magic;
+    
+    // The id of the frame the request was computed from.
+    uint32_t frameID;
+    
+    // The requested region in full resolution camera pixels.
+    int32_t x;
+    int32_t y;
+    uint32_t width;
+    uint32_t height;
+    
+    // The requested downscaling of the region by 2^scaleShift.
+    uint32_t scaleShift;
+};
+
+/**
+ *  Sent by the server after every crop request, carrying the timestamps
+ *  of the processed frame. It is directly followed by numObjects ObjectPose
+ *  entries, one for every tracked object.
+ *
+ *  The server timestamps are microseconds since the Unix epoch on the
+ *  server's clock, their difference is the time the frame spent in the
+ *  server. Together with the echoed capture timestamp a client can measure
+ *  the end-to-end latency of every frame on its own clock.
+ */
+struct PoseReply
+{
+    // Must be POSE_MAGIC.
+    uint32_t magic;
+    
+    // The id of the frame the poses were estimated from.
+    uint32_t frameID;
+    
+    // The capture timestamp of that frame as sent by the client (client clock).
+    uint64_t captureTimestamp;
+    
+    // The time at which the server received the frame header.
+    uint64_t receiveTimestamp;
+    
+    // The time at which the server sent this reply.
+    uint64_t sendTimestamp;
+    
+    // The display timestamp of the frame as sent by the client (client clock).
+    uint64_t displayTimestamp;
+    
+    // The number of ObjectPose entries following.
+    uint32_t numObjects;
+};
+
+/**
+ *  The pose estimate of a single object within a pose reply.
+ */
+struct ObjectPose
+{
+    // The 4x4 pose relative to the initial pose of the object, row-major,
+    // extrapolated to the display timestamp if OBJECT_POSE_EXTRAPOLATED is set.
+    float pose[16];
+    
+    // A combination of ObjectPoseFlags.
+    uint32_t flags;
+    
+    // The energy of the last evaluated pose estimate, lower is better (0 if none).
+    float energy;
+};
+
+#pragma pack(pop)
+
+/**
+ *  A collection of helper functions for validating and interpreting
+ *  the frame headers of the tracking server protocol.
+ */
+class FrameProtocol
+{
+public:
+    /**
+     *  Returns the size of an uncompressed frame.
+     *
+     *  @param pixelFormat One of PixelFormat.
+     *  @param width The width of the frame in pixels.
+     *  @param height The height of the frame in pixels.
+     *  @return The number of bytes of the frame or 0 if the format is unknown or the size is not valid for it.
+     */
+    static size_t payloadLength(uint32_t pixelFormat, uint32_t width, uint32_t height);
+    
+    /**
+     *  Wraps an uncompressed payload as an OpenCV image without copying it.
+     *  NV12 frames become single channel images of 3/2 times the height,
+     *  YUYV frames 2 channel images.
+     *
+     *  @param header The valid header of the frame.
+     *  @param payload The pixels of the frame.
+     *  @return The image corresponding to the header and payload.
+     */
+    static cv::Mat image(const FrameHeader &header, void *payload);
+    
+    /**
+     *  Checks whether a received header is well-formed, i.e. whether it
+     *  starts with the magic number, uses a known pixel format and announces
+     *  a payload that matches the image size and fits into a buffer of the
+     *  given capacity. The image may not be larger than the camera frames.
+     *
+     *  For compressed codecs only the payload length is checked against the
+     *  capacity, since the size of the encoded image is not known upfront.
+     *
+     *  @param header The received frame header.
+     *  @param maxPayloadLength The largest payload in bytes the receiver is willing to accept.
+     *  @param maxWidth The width in pixels of the camera frames.
+     *  @param maxHeight The height in pixels of the camera frames.
+     *  @param codec The FrameCodec negotiated for the session.
+     *  @return True if the header is valid and false otherwise.
+     */
+    static bool validateHeader(const FrameHeader &header, size_t maxPayloadLength, uint32_t maxWidth, uint32_t maxHeight, uint32_t codec = FRAME_CODEC_RAW);
+    
+    /**
+     *  Chooses the codec used for a session among those supported by both
+     *  sides, preferring the ones with the highest compression.
+     *
+     *  @param clientCodecs The codec bit mask announced by the client.
+     *  @param serverCodecs The codec bit mask supported by the server.
+     *  @return The chosen FrameCodec or -1 if there is no common codec.
+     */
+    static int selectCodec(uint32_t clientCodecs, uint32_t serverCodecs);
+    
+    /**
+     *  Returns the current time as used for the server timestamps of the
+     *  pose reply.
+     *
+     *  @return The wall clock time in microseconds since the Unix epoch.
+     */
+    static uint64_t timestamp();
+};
+
+#endif /* FRAME_PROTOCOL_H */
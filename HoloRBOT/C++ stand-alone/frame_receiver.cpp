@@ -0,0 +1,131 @@
+#include "frame_receiver.h"
+
+#include <iostream>
+
+using namespace std;
+using namespace cv;
+
+Mat FrameBuffer::image()
+{
+    return FrameProtocol::image(header, payload.data());
+}
+
+
+FrameReceiver::FrameReceiver(boost::asio::ip::tcp::socket &socket, size_t maxPayloadLength) : socket(socket)
+{
+    this->maxPayloadLength = maxPayloadLength;
+    
+    maxWidth = 0;
+    maxHeight = 0;
+    
+    codec = FRAME_CODEC_RAW;
+}
+
+FrameReceiver::~FrameReceiver()
+{
+    
+}
+
+bool FrameReceiver::handshake(uint32_t serverCodecs, int maxWidth, int maxHeight, boost::system::error_code &error)
+{
+    HelloMessage hello;
+    boost::asio::read(socket, boost::asio::buffer(&hello, sizeof(HelloMessage)), boost::asio::transfer_exactly(sizeof(HelloMessage)), error);
+    if(error)
+        return false;
+    
+    if(hello.magic != HELLO_MAGIC)
+    {
+        cout << "received malformed hello message" << endl;
+        error = boost::asio::error::invalid_argument;
+        return false;
+    }
+    
+    int selected = FrameProtocol::selectCodec(hello.supportedCodecs, serverCodecs);
+    
+    // an invalid codec in the reply tells the client that the server can not handle any of its codecs
+    HelloReply reply;
+    reply.magic = HELLO_MAGIC;
+    reply.version = PROTOCOL_VERSION;
+    reply.codec = (selected >= 0) ? selected : UINT32_MAX;
+    reply.maxWidth = maxWidth;
+    reply.maxHeight = maxHeight;
+    
+    this->maxWidth = maxWidth;
+    this->maxHeight = maxHeight;
+    
+    boost::asio::write(socket, boost::asio::buffer(&reply, sizeof(HelloReply)), error);
+    if(error)
+        return false;
+    
+    if(selected < 0)
+    {
+        cout << "client does not support any of the server's codecs (" << hello.supportedCodecs << ")" << endl;
+        error = boost::asio::error::operation_not_supported;
+        return false;
+    }
+    
+    codec = selected;
+    
+    return true;
+}
+
+uint32_t FrameReceiver::getCodec()
+{
+    return codec;
+}
+
+bool FrameReceiver::receive(FrameBuffer &frame, boost::system::error_code &error)
+{
+    // commands may arrive between two frames, both start with their magic number
+    uint32_t magic;
+    while(true)
+    {
+        boost::asio::read(socket, boost::asio::buffer(&magic, sizeof(uint32_t)), boost::asio::transfer_exactly(sizeof(uint32_t)), error);
+        if(error)
+            return false;
+        
+        if(magic != COMMAND_MAGIC)
+            break;
+        
+        CommandMessage command;
+        command.magic = magic;
+        boost::asio::read(socket, boost::asio::buffer((uchar*)&command + sizeof(uint32_t), sizeof(CommandMessage) - sizeof(uint32_t)), boost::asio::transfer_exactly(sizeof(CommandMessage) - sizeof(uint32_t)), error);
+        if(error)
+            return false;
+        
+        if(commandHandler)
+            commandHandler(command);
+    }
+    
+    frame.header.magic = magic;
+    boost::asio::read(socket, boost::asio::buffer((uchar*)&frame.header + sizeof(uint32_t), sizeof(FrameHeader) - sizeof(uint32_t)), boost::asio::transfer_exactly(sizeof(FrameHeader) - sizeof(uint32_t)), error);
+    if(error)
+        return false;
+    
+    frame.receiveTimestamp = FrameProtocol::timestamp();
+    
+    if(!FrameProtocol::validateHeader(frame.header, maxPayloadLength, maxWidth, maxHeight, codec))
+    {
+        cout << "received malformed frame header (frame " << frame.header.frameID << ", " << frame.header.width << "x" << frame.header.height << ", " << frame.header.payloadLength << " bytes)" << endl;
+        error = boost::asio::error::invalid_argument;
+        return false;
+    }
+    
+    // only grow the buffer, such that it is allocated once for a constant frame size
+    if(frame.payload.size() < frame.header.payloadLength)
+        frame.payload.resize(frame.header.payloadLength);
+    
+    boost::asio::read(socket, boost::asio::buffer(frame.payload.data(), frame.header.payloadLength), boost::asio::transfer_exactly(frame.header.payloadLength), error);
+    
+    return !error;
+}
+
+size_t FrameReceiver::getMaxPayloadLength()
+{
+    return maxPayloadLength;
+}
+
+void FrameReceiver::setCommandHandler(std::function<void(const CommandMessage&)> handler)
+{
+    commandHandler = handler;
+}
@@ -0,0 +1,119 @@
+#ifndef FRAME_RECEIVER_H
+#define FRAME_RECEIVER_H
+
+#include <functional>
+#include <vector>
+
+#include "boost/asio.hpp"
+#include "boost/asio/ip/tcp.hpp"
+
+#include <opencv2/core.hpp>
+
+#include "frame_protocol.h"
+
+/**
+ *  A received camera frame consisting of its header and the raw pixel
+ *  payload. The payload buffer only ever grows to the size of the largest
+ *  frame received so far, such that a buffer can be reused for every frame
+ *  of a session without reallocation.
+ */
+struct FrameBuffer
+{
+    FrameHeader header;
+    
+    // the time at which the header was received (see FrameProtocol::timestamp)
+    uint64_t receiveTimestamp;
+    
+    std::vector<uchar> payload;
+    
+    /**
+     *  Wraps the payload as an OpenCV image without copying it.
+     *
+     *  @return The image corresponding to the header and payload of the frame.
+     */
+    cv::Mat image();
+};
+
+/**
+ *  This class reads length-prefixed frames from a connected TCP socket.
+ *  Every frame is read with two exact-size reads, one for the fixed size
+ *  header and one for the payload announced in it, directly into a
+ *  preallocated frame buffer.
+ */
+class FrameReceiver
+{
+public:
+    /**
+     *  Constructor of the frame receiver for an already connected socket.
+     *
+     *  @param  socket The connected socket frames are read from.
+     *  @param  maxPayloadLength The largest payload in bytes accepted for a single frame.
+     */
+    FrameReceiver(boost::asio::ip::tcp::socket &socket, size_t maxPayloadLength);
+    
+    ~FrameReceiver();
+    
+    /**
+     *  Performs the handshake opening every session: reads the HelloMessage
+     *  of the client, chooses the codec for all following frames and sends
+     *  it back in a HelloReply.
+     *
+     *  @param  serverCodecs A bit mask with bit (1 << codec) set for every FrameCodec the server can decode.
+     *  @param  maxWidth The largest frame width in pixels accepted by the server.
+     *  @param  maxHeight The largest frame height in pixels accepted by the server.
+     *  @param  error The socket error in case the handshake failed.
+     *  @return True if a common codec was negotiated and false otherwise.
+     */
+    bool handshake(uint32_t serverCodecs, int maxWidth, int maxHeight, boost::system::error_code &error);
+    
+    /**
+     *  Returns the codec negotiated in the handshake, FRAME_CODEC_RAW before.
+     *
+     *  @return The FrameCodec of the frame payloads.
+     */
+    uint32_t getCodec();
+    
+    /**
+     *  Blocks until the next complete frame has been read into the given buffer.
+     *  Command messages received in between are passed to the command handler.
+     *  Malformed headers (wrong magic, unknown pixel format, an image larger than
+     *  announced in the handshake, a payload that does not match the image size
+     *  or exceeds the maximum length) are treated as a
+     *  protocol error, as the stream can not be resynchronized afterwards.
+     *
+     *  @param  frame The buffer the header and the payload are written to.
+     *  @param  error The socket error in case reading failed.
+     *  @return True if a complete frame was received and false otherwise.
+     */
+    bool receive(FrameBuffer &frame, boost::system::error_code &error);
+    
+    /**
+     *  Returns the largest payload in bytes accepted for a single frame.
+     *
+     *  @return The largest payload in bytes accepted for a single frame.
+     */
+    size_t getMaxPayloadLength();
+    
+    /**
+     *  Sets a function that is called by the receiving thread for every
+     *  command message received from the client.
+     *
+     *  @param  handler The function to be called.
+     */
+    void setCommandHandler(std::function<void(const CommandMessage&)> handler);
+
+private:
+    boost::asio::ip::tcp::socket &socket;
+    
+    size_t maxPayloadLength;
+    
+    // the frame size announced in the handshake, larger frames are rejected
+    uint32_t maxWidth;
+    uint32_t maxHeight;
+    
+    uint32_t codec;
+    
+    std::function<void(const CommandMessage&)> commandHandler;
+};
+
+#endif /* FRAME_RECEIVER_H */
@@ -0,0 +1,219 @@
+#include "frame_ring.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+FrameRing::FrameRing(int numSlots, size_t maxPayloadLength) : slots(max(numSlots, 3))
+{
+    for(int i = 0; i < slots.size(); i++)
+    {
+        slots[i].frame.payload.resize(maxPayloadLength);
+        slots[i].state = FREE;
+        slots[i].sequence = 0;
+    }
+    
+    numPublished = 0;
+    numDropped = 0;
+    
+    closed = false;
+    
+    wakeSequence = 0;
+}
+
+FrameRing::~FrameRing()
+{
+    
+}
+
+int FrameRing::beginWrite()
+{
+    while(true)
+    {
+        // prefer a free slot
+        for(int i = 0; i < slots.size(); i++)
+        {
+            int expected = FREE;
+            if(slots[i].state.compare_exchange_strong(expected, WRITING, memory_order_acquire))
+                return i;
+        }
+        
+        // otherwise overwrite the oldest frame the consumer has not taken yet
+        int oldest = -1;
+        uint64_t oldestSequence = UINT64_MAX;
+        for(int i = 0; i < slots.size(); i++)
+        {
+            if(slots[i].state.load(memory_order_acquire) == READY)
+            {
+                uint64_t sequence = slots[i].sequence.load(memory_order_relaxed);
+                if(sequence < oldestSequence)
+                {
+                    oldestSequence = sequence;
+                    oldest = i;
+                }
+            }
+        }
+        
+        if(oldest >= 0)
+        {
+            int expected = READY;
+            if(slots[oldest].state.compare_exchange_strong(expected, WRITING, memory_order_acquire))
+            {
+                numDropped++;
+                return oldest;
+            }
+        }
+        
+        // the consumer took or released a slot in the meantime, try again
+        this_thread::yield();
+    }
+}
+
+void FrameRing::commitWrite(int slot)
+{
+    slots[slot].sequence.store(++numPublished, memory_order_relaxed);
+    slots[slot].state.store(READY, memory_order_release);
+    
+    {
+        lock_guard<mutex> lock(waitMutex);
+        wakeSequence++;
+    }
+    frameAvailable.notify_one();
+    
+    if(listener)
+        listener();
+}
+
+void FrameRing::abortWrite(int slot)
+{
+    slots[slot].state.store(FREE, memory_order_release);
+}
+
+int FrameRing::acquireNewest()
+{
+    while(true)
+    {
+        int newest = -1;
+        uint64_t newestSequence = 0;
+        for(int i = 0; i < slots.size(); i++)
+        {
+            if(slots[i].state.load(memory_order_acquire) == READY)
+            {
+                uint64_t sequence = slots[i].sequence.load(memory_order_relaxed);
+                if(sequence > newestSequence)
+                {
+                    newestSequence = sequence;
+                    newest = i;
+                }
+            }
+        }
+        
+        if(newest < 0)
+            return -1;
+        
+        int expected = READY;
+        if(!slots[newest].state.compare_exchange_strong(expected, READING, memory_order_acquire))
+            continue; // overwritten by the producer in the meantime
+        
+        // all older frames are stale now
+        for(int i = 0; i < slots.size(); i++)
+        {
+            if(i == newest)
+                continue;
+            
+            // take the slot before looking at its sequence, such that the producer can not republish it in between
+            expected = READY;
+            if(!slots[i].state.compare_exchange_strong(expected, READING, memory_order_acquire))
+                continue;
+            
+            if(slots[i].sequence.load(memory_order_relaxed) < newestSequence)
+            {
+                slots[i].state.store(FREE, memory_order_release);
+                numDropped++;
+            }
+            else
+                slots[i].state.store(READY, memory_order_release);
+        }
+        
+        return newest;
+    }
+}
+
+int FrameRing::waitForNewest(int timeout)
+{
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout);
+    
+    // every frame published after reading the sequence wakes the consumer up
+    unique_lock<mutex> lock(waitMutex);
+    uint64_t sequence = wakeSequence;
+    lock.unlock();
+    
+    while(true)
+    {
+        int slot = acquireNewest();
+        if(slot >= 0 || closed)
+            return slot;
+        
+        lock.lock();
+        if(!frameAvailable.wait_until(lock, deadline, [&]{ return wakeSequence != sequence || closed; }))
+            return -1;
+        
+        sequence = wakeSequence;
+        lock.unlock();
+        
+        // another consumer may have taken the frame in the meantime, then wait for the next one
+    }
+}
+
+void FrameRing::release(int slot)
+{
+    slots[slot].state.store(FREE, memory_order_release);
+}
+
+FrameBuffer& FrameRing::getFrame(int slot)
+{
+    return slots[slot].frame;
+}
+
+void FrameRing::close()
+{
+    {
+        lock_guard<mutex> lock(waitMutex);
+        closed = true;
+    }
+    frameAvailable.notify_all();
+    
+    if(listener)
+        listener();
+}
+
+bool FrameRing::isClosed()
+{
+    return closed;
+}
+
+bool FrameRing::hasNewest()
+{
+    for(int i = 0; i < slots.size(); i++)
+    {
+        if(slots[i].state.load(memory_order_acquire) == READY)
+            return true;
+    }
+    return false;
+}
+
+void FrameRing::setListener(std::function<void()> listener)
+{
+    this->listener = listener;
+}
+
+uint64_t FrameRing::getNumPublished()
+{
+    return numPublished;
+}
+
+uint64_t FrameRing::getNumDropped()
+{
+    return numDropped;
+}
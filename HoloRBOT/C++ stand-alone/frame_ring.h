@@ -0,0 +1,166 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "frame_receiver.h"
+
+/**
+ *  A lock-free ring of preallocated frame slots handing received frames
+ *  from a producer thread (e.g. the socket receiver) to the tracking thread.
+ *  The producer never blocks: if no slot is free it overwrites the oldest
+ *  frame that has not been consumed yet. The consumer always takes the
+ *  newest complete frame and releases all older ones. Every frame that is
+ *  overwritten or skipped that way is counted as dropped.
+ *
+ *  Each slot is owned by exactly one side at a time, which is tracked by an
+ *  atomic state per slot, such that the payload buffers are never copied.
+ */
+class FrameRing
+{
+public:
+    /**
+     *  Constructor of the frame ring allocating all slots upfront.
+     *
+     *  @param  numSlots The number of frame slots, at least 3 (one being written, one ready and one being processed).
+     *  @param  maxPayloadLength The largest payload in bytes a slot has to hold.
+     */
+    FrameRing(int numSlots, size_t maxPayloadLength);
+    
+    ~FrameRing();
+    
+    /**
+     *  Reserves a slot for writing the next frame into. If no slot is free,
+     *  the oldest frame not yet taken by the consumer is dropped.
+     *
+     *  @return The index of the reserved slot.
+     */
+    int beginWrite();
+    
+    /**
+     *  Publishes a completely written slot, making it the newest frame.
+     *
+     *  @param  slot The index of the slot as returned by beginWrite.
+     */
+    void commitWrite(int slot);
+    
+    /**
+     *  Returns a reserved slot without publishing it, e.g. if receiving the
+     *  frame failed.
+     *
+     *  @param  slot The index of the slot as returned by beginWrite.
+     */
+    void abortWrite(int slot);
+    
+    /**
+     *  Takes the newest published frame for processing, if there is one.
+     *  All older published frames are dropped.
+     *
+     *  @return The index of the taken slot or -1 if no new frame is available.
+     */
+    int acquireNewest();
+    
+    /**
+     *  Same as acquireNewest but waits up to the given time for a frame to
+     *  be published if none is available.
+     *
+     *  @param  timeout The maximum waiting time in milliseconds.
+     *  @return The index of the taken slot or -1 if no new frame arrived in time or the ring was closed.
+     */
+    int waitForNewest(int timeout);
+    
+    /**
+     *  Hands a processed slot back to the producer.
+     *
+     *  @param  slot The index of the slot as returned by acquireNewest or waitForNewest.
+     */
+    void release(int slot);
+    
+    /**
+     *  Returns the frame stored in a slot. Only valid for slots currently
+     *  owned by the caller.
+     *
+     *  @param  slot The index of the slot.
+     *  @return The frame buffer of the slot.
+     */
+    FrameBuffer& getFrame(int slot);
+    
+    /**
+     *  Marks the ring as closed, i.e. that the producer will not publish any
+     *  further frames, and wakes up a waiting consumer.
+     */
+    void close();
+    
+    bool isClosed();
+    
+    /**
+     *  Returns whether a published frame is waiting to be taken.
+     *
+     *  @return True if acquireNewest would return a slot and false otherwise.
+     */
+    bool hasNewest();
+    
+    /**
+     *  Sets a function that is called by the producer thread whenever a frame
+     *  has been published or the ring has been closed, e.g. for scheduling the
+     *  consumer. Must be set before the producer starts.
+     *
+     *  @param  listener The function to be called.
+     */
+    void setListener(std::function<void()> listener);
+    
+    /**
+     *  Returns the number of frames published by the producer so far.
+     *
+     *  @return The number of published frames.
+     */
+    uint64_t getNumPublished();
+    
+    /**
+     *  Returns the number of published frames that were never processed,
+     *  because a newer frame was available.
+     *
+     *  @return The number of dropped frames.
+     */
+    uint64_t getNumDropped();
+
+private:
+    enum SlotState
+    {
+        FREE,
+        WRITING,
+        READY,
+        READING
+    };
+    
+    struct Slot
+    {
+        FrameBuffer frame;
+        
+        std::atomic<int> state;
+        
+        std::atomic<uint64_t> sequence;
+    };
+    
+    std::vector<Slot> slots;
+    
+    std::atomic<uint64_t> numPublished;
+    std::atomic<uint64_t> numDropped;
+    
+    std::atomic<bool> closed;
+    
+    // only used to put the consumer to sleep while the ring is empty
+    std::mutex waitMutex;
+    std::condition_variable frameAvailable;
+    
+    // counts the publications under waitMutex, such that a waiting consumer can not miss one
+    uint64_t wakeSequence;
+    
+    std::function<void()> listener;
+};
+
+#endif /* FRAME_RING_H */
@@ -0,0 +1,195 @@
+/**
+ *  Load generator for the tracking server (main.cpp --server): simulates a
+ *  number of HoloLens clients, each sending synthetic camera frames at a
+ *  fixed rate while a second thread receives the replies. At the end the
+ *  reply rate and latency of every client and of all clients together is
+ *  reported, which tells how many sessions a machine can serve at the
+ *  desired frame rate.
+ *
+ *  usage: load_generator [host] [port] [clients] [fps] [seconds] [raw|jpeg|png] [image] [display offset ms]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "tracking_client.h"
+
+using namespace std;
+using namespace cv;
+
+struct ClientStats
+{
+    ClientStats()
+    {
+        connected = false;
+        numSent = 0;
+        numReplies = 0;
+    }
+    
+    bool connected;
+    
+    std::atomic<uint64_t> numSent;
+    std::atomic<uint64_t> numReplies;
+    
+    // reply latencies and the time the frames spent in the server in milliseconds, only accessed by the receiving thread
+    std::vector<double> latencies;
+    std::vector<double> serverTimes;
+};
+
+static int64_t now()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void receiveReplies(TrackingClient *client, ClientStats *stats)
+{
+    boost::system::error_code error;
+    CropRequest request;
+    PoseReply reply;
+    vector<ObjectPose> poses;
+    while(client->receiveReply(request, reply, poses, error))
+    {
+        // the server echoes the capture timestamp, which is taken from the local clock
+        stats->latencies.push_back((now() - (int64_t)reply.captureTimestamp)/1000.0);
+        stats->serverTimes.push_back((reply.sendTimestamp - reply.receiveTimestamp)/1000.0);
+        stats->numReplies++;
+    }
+}
+
+static void runClient(int id, const string &host, int port, uint32_t codecs, double fps, double seconds, int64_t displayOffset, const Mat &image, ClientStats *stats)
+{
+    TrackingClient client;
+    boost::system::error_code error;
+    if(!client.connect(host, port, codecs, error))
+    {
+        cout << "client " << id << ": connecting failed: " << error.message() << endl;
+        return;
+    }
+    stats->connected = true;
+    
+    // tracking starts with the first frame
+    if(!client.sendCommand(COMMAND_START_TRACKING, -1, error))
+    {
+        cout << "client " << id << ": sending the start command failed: " << error.message() << endl;
+        return;
+    }
+    
+    thread receiver(receiveReplies, &client, stats);
+    
+    // send at a fixed rate, independent of the replies, like the camera of the HoloLens does
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::duration period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0/fps));
+    uint32_t frameID = 0;
+    while(chrono::steady_clock::now() - start < chrono::duration<double>(seconds))
+    {
+        int64_t timestamp = now();
+        if(!client.sendFrame(image, frameID, timestamp, (displayOffset > 0) ? timestamp + displayOffset : 0, error))
+        {
+            cout << "client " << id << ": sending failed: " << error.message() << endl;
+            break;
+        }
+        stats->numSent++;
+        frameID++;
+        
+        this_thread::sleep_until(start + period*frameID);
+    }
+    
+    // give the server the chance to answer the last frame
+    this_thread::sleep_for(chrono::milliseconds(500));
+    client.close();
+    receiver.join();
+}
+
+static double percentile(vector<double> &values, double p)
+{
+    if(values.empty())
+        return 0;
+    
+    sort(values.begin(), values.end());
+    return values[min((size_t)(p*values.size()), values.size() - 1)];
+}
+
+int main(int argc, char *argv[])
+{
+    string host = (argc > 1) ? argv[1] : "127.0.0.1";
+    int port = (argc > 2) ? atoi(argv[2]) : 27015;
+    int numClients = (argc > 3) ? atoi(argv[3]) : 4;
+    double fps = (argc > 4) ? atof(argv[4]) : 30.0;
+    double seconds = (argc > 5) ? atof(argv[5]) : 30.0;
+    string codecName = (argc > 6) ? argv[6] : "jpeg";
+    
+    // the poses are requested this many milliseconds after the capture, i.e. extrapolated by the server
+    int64_t displayOffset = (argc > 8) ? atoi(argv[8])*1000 : 0;
+    
+    uint32_t codecs = 1 << FRAME_CODEC_RAW;
+    if(codecName == "jpeg")
+        codecs = 1 << FRAME_CODEC_JPEG;
+    else if(codecName == "png")
+        codecs = 1 << FRAME_CODEC_PNG;
+    
+    // a recorded camera image or a synthetic one of the HoloLens camera resolution
+    Mat image;
+    if(argc > 7)
+        image = imread(argv[7]);
+    if(image.empty())
+    {
+        image = Mat(792, 1408, CV_8UC3);
+        randu(image, Scalar::all(0), Scalar::all(255));
+        GaussianBlur(image, image, Size(15, 15), 0);
+        rectangle(image, Rect(600, 300, 200, 200), Scalar(40, 120, 220), FILLED);
+    }
+    
+    cout << "starting " << numClients << " clients sending " << image.cols << "x" << image.rows << " frames at " << fps << " fps (" << codecName << ") for " << seconds << " s" << endl;
+    
+    vector<ClientStats*> stats;
+    vector<thread> clients;
+    for(int i = 0; i < numClients; i++)
+    {
+        stats.push_back(new ClientStats());
+        clients.push_back(thread(runClient, i, host, port, codecs, fps, seconds, displayOffset, ref(image), stats[i]));
+    }
+    for(int i = 0; i < numClients; i++)
+    {
+        clients[i].join();
+    }
+    
+    // a client keeps up if the server answers at least 90% of the frames it sends
+    uint64_t totalReplies = 0;
+    int numKeepingUp = 0;
+    vector<double> allLatencies;
+    vector<double> allServerTimes;
+    for(int i = 0; i < numClients; i++)
+    {
+        ClientStats *s = stats[i];
+        if(!s->connected)
+            continue;
+        
+        double replyRate = s->numReplies/seconds;
+        bool keepingUp = s->numReplies >= 0.9*s->numSent;
+        totalReplies += s->numReplies;
+        numKeepingUp += keepingUp ? 1 : 0;
+        allLatencies.insert(allLatencies.end(), s->latencies.begin(), s->latencies.end());
+        allServerTimes.insert(allServerTimes.end(), s->serverTimes.begin(), s->serverTimes.end());
+        
+        cout << "client " << i << ": sent " << s->numSent << ", replies " << s->numReplies << " (" << replyRate << " fps), latency p50 " << percentile(s->latencies, 0.5) << " ms, p95 " << percentile(s->latencies, 0.95) << " ms" << (keepingUp ? "" : ", falling behind") << endl;
+    }
+    
+    cout << "total: " << totalReplies/seconds << " fps, latency p50 " << percentile(allLatencies, 0.5) << " ms, p95 " << percentile(allLatencies, 0.95) << " ms, in server p50 " << percentile(allServerTimes, 0.5) << " ms, p95 " << percentile(allServerTimes, 0.95) << " ms" << endl;
+    cout << numKeepingUp << " of " << numClients << " sessions served at " << fps << " fps" << endl;
+    
+    for(int i = 0; i < numClients; i++)
+    {
+        delete stats[i];
+    }
+    
+    return 0;
+}
@@ -0,0 +1,276 @@
+/**
+ *  Stand-in for a camera capture process on the same host as the tracker,
+ *  writing frames into the shared memory of a tracker started with
+ *  --shm <name>. The frames are an image sequence or video (anything
+ *  cv::VideoCapture can open) or synthetic ones, always sent in full
+ *  resolution, i.e. crop requests are ignored.
+ *
+ *  Besides the frame-to-pose latency it reports the handoff time, i.e. the
+ *  time between publishing a frame and the tracker taking it, which does
+ *  not include copying the pixels into the slot.
+ *
+ *  usage: local_producer [--shm name] [--fps n] [--frames n] [--bgra | --nv12 | --yuyv] [source]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "shared_memory_transport.h"
+
+using namespace std;
+using namespace cv;
+
+static double percentile(vector<double> &values, double p)
+{
+    if(values.empty())
+        return 0;
+    
+    sort(values.begin(), values.end());
+    return values[min((size_t)(p*values.size()), values.size() - 1)];
+}
+
+
+static bool loadFrames(const string &source, int maxFrames, vector<Mat> &frames)
+{
+    VideoCapture capture(source);
+    if(!capture.isOpened())
+    {
+        cout << "Could not open the image sequence: \"" << source << "\"" << endl;
+        return false;
+    }
+    
+    Mat frame;
+    while(frames.size() < maxFrames && capture.read(frame))
+    {
+        frames.push_back(frame.clone());
+    }
+    return !frames.empty();
+}
+
+
+// an object moving in front of a textured background, at the HoloLens camera resolution
+static void createFrames(int numFrames, vector<Mat> &frames)
+{
+    Mat background = Mat(792, 1408, CV_8UC3);
+    randu(background, Scalar::all(0), Scalar::all(255));
+    GaussianBlur(background, background, Size(15, 15), 0);
+    
+    for(int i = 0; i < numFrames; i++)
+    {
+        Mat frame = background.clone();
+        int x = 500 + (int)(200*sin(i*0.05));
+        rectangle(frame, Rect(x, 300, 200, 200), Scalar(40, 120, 220), FILLED);
+        frames.push_back(frame);
+    }
+}
+
+
+// converts a BGR image of even size into NV12 or YUYV as delivered by many camera pipelines
+static Mat convertToYUV(const Mat &frame, uint32_t pixelFormat)
+{
+    Mat yuv;
+    cvtColor(frame, yuv, COLOR_BGR2YUV);
+    
+    int width = frame.cols;
+    int height = frame.rows;
+    
+    Mat result;
+    if(pixelFormat == PIXEL_FORMAT_NV12)
+    {
+        result.create(height*3/2, width, CV_8UC1);
+        uchar *uv = result.data + height*result.step;
+        for(int y = 0; y < height; y++)
+        {
+            const uchar *src = yuv.data + y*yuv.step;
+            uchar *luma = result.data + y*result.step;
+            for(int x = 0; x < width; x++)
+            {
+                luma[x] = src[3*x];
+            }
+            
+            // the chroma of every 2x2 block is taken from its top left pixel
+            if(y % 2 == 0)
+            {
+                uchar *uvRow = uv + (y/2)*result.step;
+                for(int x = 0; x < width; x += 2)
+                {
+                    uvRow[x] = src[3*x + 1];
+                    uvRow[x + 1] = src[3*x + 2];
+                }
+            }
+        }
+    }
+    else
+    {
+        result.create(height, width, CV_8UC2);
+        for(int y = 0; y < height; y++)
+        {
+            const uchar *src = yuv.data + y*yuv.step;
+            uchar *dst = result.data + y*result.step;
+            for(int x = 0; x < width; x += 2, dst += 4)
+            {
+                dst[0] = src[3*x];
+                dst[1] = (src[3*x + 1] + src[3*x + 4] + 1)/2;
+                dst[2] = src[3*x + 3];
+                dst[3] = (src[3*x + 2] + src[3*x + 5] + 1)/2;
+            }
+        }
+    }
+    return result;
+}
+
+
+int main(int argc, char *argv[])
+{
+    string name = "/rbot";
+    double fps = 30.0;
+    int maxFrames = 300;
+    uint32_t pixelFormat = PIXEL_FORMAT_BGR;
+    string source;
+    
+    for(int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        
+        if(option == "--bgra")
+            pixelFormat = PIXEL_FORMAT_BGRA;
+        else if(option == "--nv12")
+            pixelFormat = PIXEL_FORMAT_NV12;
+        else if(option == "--yuyv")
+            pixelFormat = PIXEL_FORMAT_YUYV;
+        else if(option == "--shm" && hasValue)
+            name = argv[++i];
+        else if(option == "--fps" && hasValue)
+            fps = atof(argv[++i]);
+        else if(option == "--frames" && hasValue)
+            maxFrames = atoi(argv[++i]);
+        else if(option.compare(0, 2, "--") != 0)
+            source = option;
+        else
+        {
+            cout << "unknown option or missing value: " << option << endl;
+            return -1;
+        }
+    }
+    
+    vector<Mat> frames;
+    if(source.empty())
+        createFrames(maxFrames, frames);
+    else if(!loadFrames(source, maxFrames, frames))
+        return -1;
+    
+    // the camera delivers 4 channel or YUV images on many platforms
+    int width = frames[0].cols;
+    int height = frames[0].rows;
+    for(int i = 0; i < frames.size() && pixelFormat != PIXEL_FORMAT_BGR; i++)
+    {
+        if(pixelFormat == PIXEL_FORMAT_BGRA)
+            cvtColor(frames[i], frames[i], COLOR_BGR2BGRA);
+        else
+            frames[i] = convertToYUV(frames[i](Rect(0, 0, width & ~1, height & ~1)), pixelFormat);
+    }
+    if(pixelFormat == PIXEL_FORMAT_NV12 || pixelFormat == PIXEL_FORMAT_YUYV)
+    {
+        width &= ~1;
+        height &= ~1;
+    }
+    size_t payloadLength = FrameProtocol::payloadLength(pixelFormat, width, height);
+    
+    SharedMemoryTransport *transport = SharedMemoryTransport::open(name);
+    if(!transport)
+        return -1;
+    
+    if(payloadLength > transport->getMaxPayloadLength())
+    {
+        cout << "the frames are larger than the slots of the shared memory" << endl;
+        delete transport;
+        return -1;
+    }
+    
+    CommandMessage start = {COMMAND_MAGIC, COMMAND_START_TRACKING, -1};
+    transport->sendCommand(start);
+    
+    // replies are read by a separate thread, such that frames are published at a constant rate
+    vector<double> handoffs;
+    vector<double> latencies;
+    atomic<bool> running(true);
+    
+    thread receiver([&]()
+    {
+        CropRequest request;
+        PoseReply reply;
+        vector<ObjectPose> poses;
+        while(running)
+        {
+            if(!transport->waitForReply(request, reply, poses, 100))
+                continue;
+            
+            handoffs.push_back((double)(reply.receiveTimestamp - reply.captureTimestamp));
+            latencies.push_back((FrameProtocol::timestamp() - reply.captureTimestamp)/1000.0);
+        }
+    });
+    
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    chrono::steady_clock::duration period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>((fps > 0) ? 1.0/fps : 0.0));
+    uint32_t numSent = 0;
+    for(uint32_t frameID = 0; frameID < frames.size(); frameID++)
+    {
+        int slot = transport->beginWrite();
+        if(slot < 0)
+        {
+            cout << "no free slot for frame " << frameID << endl;
+            continue;
+        }
+        
+        Mat &frame = frames[frameID];
+        
+        // a real capture process would let the camera write into the slot directly
+        memcpy(transport->getPayload(slot), frame.data, payloadLength);
+        
+        FrameHeader &header = transport->getHeader(slot);
+        header.magic = FRAME_MAGIC;
+        header.frameID = frameID;
+        header.width = width;
+        header.height = height;
+        header.pixelFormat = pixelFormat;
+        header.payloadLength = (uint32_t)payloadLength;
+        header.cropX = 0;
+        header.cropY = 0;
+        header.scaleShift = 0;
+        header.displayTimestamp = 0;
+        header.captureTimestamp = FrameProtocol::timestamp();
+        
+        transport->commitWrite(slot);
+        numSent++;
+        
+        if(fps > 0)
+            this_thread::sleep_until(begin + period*(frameID + 1));
+    }
+    
+    // give the tracker time for the last frame
+    this_thread::sleep_for(chrono::milliseconds(500));
+    running = false;
+    receiver.join();
+    
+    transport->close();
+    delete transport;
+    
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    cout << "sent " << numSent << " frames, received " << latencies.size() << " poses (" << latencies.size()/seconds << " fps)" << endl;
+    cout << "handoff p50 " << percentile(handoffs, 0.5) << " us, p99 " << percentile(handoffs, 0.99) << " us" << endl;
+    cout << "latency p50 " << percentile(latencies, 0.5) << " ms, p95 " << percentile(latencies, 0.95) << " ms, p99 " << percentile(latencies, 0.99) << " ms" << endl;
+    
+    return 0;
+}
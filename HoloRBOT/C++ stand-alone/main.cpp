@@ -53,73 +53,66 @@
 #include <sstream>
 #include <iostream>
 #include <cstring>
+#include <thread>
 
 #include "glad/glad.h"
 
 #include <opencv2/core.hpp>
 #include <opencv2/videoio.hpp>
 #include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
 
 #include "camera_calibration.hpp"
 #include "shader.h"
 #include "object3d.h"
 #include "pose_estimator6d.h"
+#include "tracking_config.h"
+#include "tracking_session.h"
+#include "tracking_server.h"
 //#include "server.h"
 
 using namespace std;
 using namespace cv;
 
-cv::Mat drawResultOverlay(const vector<Object3D*>& objects, const cv::Mat& frame)
+cv::Mat drawResultOverlay(RenderingEngine *renderingEngine, const cv::Matx33f &K, const vector<Object3D*>& objects, const cv::Mat& frame, FrameFormat format)
 {
-    // render the models with phong shading
-    RenderingEngine::Instance()->setLevel(0);
+    // YUV frames are converted for display only, BGR and RGB frames are reordered when uploaded
+    Mat image = frame;
+    if(format == FRAME_FORMAT_NV12)
+    {
+        cvtColor(frame, image, COLOR_YUV2BGR_NV12);
+        format = FRAME_FORMAT_BGR;
+    }
+    else if(format == FRAME_FORMAT_YUYV)
+    {
+        cvtColor(frame, image, COLOR_YUV2BGR_YUYV);
+        format = FRAME_FORMAT_BGR;
+    }
+    
+    renderingEngine->setCalibration(K, image.cols, image.rows);
+    renderingEngine->setLevel(0);
     
     vector<Point3f> colors;
     colors.push_back(Point3f(1.0, 0.5, 0.0));
     //colors.push_back(Point3f(0.2, 0.3, 1.0));
-//    RenderingEngine::Instance()->renderShaded(vector<Model*>(objects.begin(), objects.end()), GL_FILL, colors, true);
-    RenderingEngine::Instance()->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), true, GL_FILL, colors, true);
-    
-    // download the rendering to the CPU
-    Mat rendering = RenderingEngine::Instance()->downloadFrame(RenderingEngine::RGB);
     
-    // download the depth buffer to the CPU
-    Mat depth = RenderingEngine::Instance()->downloadFrame(RenderingEngine::DEPTH);
+    // render the models with phong shading ontop of the camera image, only the composed result is downloaded
+    renderingEngine->renderOverlay(vector<Model*>(objects.begin(), objects.end()), image, format, colors, 1.0f, true);
     
-    // compose the rendering with the current camera image for demo purposes (can be done more efficiently directly in OpenGL)
-    Mat result = frame.clone();
-    for(int y = 0; y < frame.rows; y++)
-    {
-        for(int x = 0; x < frame.cols; x++)
-        {
-            Vec3b color = rendering.at<Vec3b>(y,x);
-            if(depth.at<float>(y,x) != 0.0f)
-            {
-                result.at<Vec3b>(y,x)[0] = color[2];
-                result.at<Vec3b>(y,x)[1] = color[1];
-                result.at<Vec3b>(y,x)[2] = color[0];
-            }
-        }
-    }
-    return result;
+    return renderingEngine->downloadFrame(RenderingEngine::BGR);
 }
 
 int main(int argc, char *argv[])
 {
-    // camera image size
-    int width = 1408;
-    int height = 792;
-    
-    // near and far plane of the OpenGL view frustum
-    float zNear = 10.0;
-    float zFar = 10000.0;
+    // camera image size, intrinsics, objects and streaming parameters, see TrackingConfig::parse for the options
+    TrackingConfig config;
+    if(!config.parse(argc, argv))
+        return -1;
     
     bool found = false;
-    Matx33f K;
-    Matx14f distCoeffs;
     
     if (found) {
-        if (!calib_mat_coeff("in_VID5.xml", width, 0.f)) {
+        if (!calib_mat_coeff("in_VID5.xml", config.width, 0.f)) {
             FileStorage fs("out_camera_data.xml", FileStorage::READ); // Read the settings
             if (!fs.isOpened())
             {
@@ -127,93 +120,99 @@ int main(int argc, char *argv[])
         //        parser.printMessage();
                 return -1;
             }
-            fs["camera_matrix"] >> K;
-            fs["distortion_coefficients"] >> distCoeffs;
+            fs["camera_matrix"] >> config.K;
+            fs["distortion_coefficients"] >> config.distCoeffs;
             fs.release();
         } else {
             cout << "No calib no file";
             return -1;
         }
-    } else {
-        // camera instrinsics
-        K = Matx33f(1031.328, 0, 679.696, 0, 1034.549, 394.479, 0, 0, 1);
-        distCoeffs =  Matx14f(0.231, -0.367, -0.0016, -0.0013);
     }
     
-    // distances for the pose detection template generation
-    vector<float> distances = {200.0f, 400.0f, 600.0f}; // 2 4 6 for templates sake
-    
-    RenderingEngine::Instance();
-    // load 3D objects
-    vector<Object3D*> objects;
-    //objects.push_back(new Object3D("data/tetrahedron.obj", 15, -35, 515, 55, -20, 205, 1.0, 0.55f, distances));
-    objects.push_back(new Object3D("data/eggbox.obj", 15, -0, 500, 195, -10, -20, 1.0, 0.55f, distances));
-    //objects.push_back(new Object3D("data/a_second_model.obj", -50, 0, 600, 30, 0, 180, 1.0, 0.55f, distances2));
-    
-    // create the pose estimator
-    PoseEstimator6D* poseEstimator = new PoseEstimator6D(width, height, zNear, zFar, K, distCoeffs, objects);
+    // NETWORKING
+    int port = config.port;
     
-    // active the OpenGL context for the offscreen rendering engine during pose estimation
-    RenderingEngine::Instance()->makeCurrent();
+    // serve any number of clients without windows, tracking is controlled by the clients' commands
+    if(config.headless && config.sharedMemoryName.empty())
+    {
+        TrackingServer *server = new TrackingServer(config);
+        server->run();
+        delete server;
+        
+        RenderingEngine::terminate();
+        return 0;
+    }
     
     int timeout = 0;
     
     bool showHelp = true;
     
-    // NETWORKING
-    boost::system::error_code error;
-    boost::asio::streambuf receive_buffer;
-    int port = 27015;
-    
     boost::asio::io_context io_cont;
-    boost::asio::ip::tcp::acceptor acceptor(io_cont, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port));
-        
-    std::cout << "Accept connection at " << port << std::endl;
-    const string msg = "Hello From Server!\n";
     
-    Matx44f oldPose = objects[0]->getPose(); // to normalize
-    boost::asio::ip::tcp::socket sock(io_cont);
-    try {
-        acceptor.accept(sock);
+    // the session renders with the context of this engine, which is destroyed together with the session
+    RenderingEngine *renderingEngine = new RenderingEngine();
+    if(!renderingEngine->isValid())
+    {
+        delete renderingEngine;
+        return 1;
+    }
+    
+    TrackingSession *session;
+    if(!config.sharedMemoryName.empty())
+    {
+        // a producer on the same host writes its frames directly into the shared memory, without any windows if headless
+        SharedMemoryTransport *transport = SharedMemoryTransport::create(config.sharedMemoryName, 3, (size_t)config.width*config.height*4, (int)config.objects.size());
+        if(!transport)
+            return 1;
         
-        // RECEIVE frameBytesLength
-        boost::asio::read(sock, receive_buffer, boost::asio::transfer_all(), error);
-        const int* dataLen = boost::asio::buffer_cast<const int*>(receive_buffer.data());
+        std::cout << "Waiting for frames in shared memory " << config.sharedMemoryName << std::endl;
         
-        // SEND 64 bytes (transform mat)
-//        std::vector<float> data(oldPose.val);
-//        std::vector<float> data(16 * sizeof(float));
-//        data = oldPose.val;
-//        //boost::asio::buffer buf(data);
-//        const size_t bytes = boost::asio::write(sock, boost::asio::buffer(data));
-//        boost::asio::write(sock, boost::asio::buffer(msg), error);
-//
-    } catch (std::exception& e) {
-        std::cerr << e.what() << std::endl;
-        return 1;
+        session = new TrackingSession(0, transport, config, renderingEngine);
+        if(config.headless)
+            config.overlayInterval = 0;
     }
+    else
+    {
+        boost::asio::ip::tcp::acceptor acceptor(io_cont, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port));
+        
+        std::cout << "Accept connection at " << port << std::endl;
+        
+        boost::asio::ip::tcp::socket sock(io_cont);
+        try {
+            acceptor.accept(sock);
+        } catch (std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        
+        // the session receives and decodes the frames in the background while the templates are generated
+        session = new TrackingSession(0, std::move(sock), config, renderingEngine);
+    }
+    session->start();
+    
+    // load 3D objects and create the pose estimator, this leaves the offscreen rendering OpenGL context active
+    session->initialize();
+    
+    vector<Object3D*> &objects = session->getObjects();
+    PoseEstimator6D* poseEstimator = session->getPoseEstimator();
+    
+    // the overlay is rendered without changing the pyramid level of the pose estimator
+    RenderingEngine *overlayRenderingEngine = new RenderingEngine(renderingEngine);
+    overlayRenderingEngine->init(config.K, config.width, config.height, config.zNear, config.zFar, 1);
+    renderingEngine->makeCurrent();
     
     Mat frame;
-    bool sel = false;
-    int i = 3;
-    while(!glfwWindowShouldClose(RenderingEngine::Instance()->getContext()))
+    int frameCount = 0;
+    bool quit = false;
+    while(!quit)
     {
-        //boost::asio::read(sock, receive_buffer, boost::asio::transfer_exactly(4), error);
-        // int?
-        if (i++==3) {
-            i = 1;
-            boost::asio::read(sock, receive_buffer, boost::asio::transfer_all(), error);
-            if( error && error != boost::asio::error::eof ) {
-                cout << "receive failed: " << error.message() << endl;
-    //            frame = stableFrame.clone();
-            } else {
-                const uchar* mid = boost::asio::buffer_cast<const uchar*>(receive_buffer.data());
-                uchar* data = const_cast<uchar*>(mid);
-                //delete frame;
-                frame = Mat(1408, 792, CV_8UC4, data);
-                flip(frame, frame, 1);
-                cout << "Check inbox" << endl;
-            }
+        // always continue with the newest frame, older ones are dropped
+        int slot = session->acquireFrame(frame, 100);
+        if(slot < 0)
+        {
+            if(session->isFinished())
+                break;
+            continue;
         }
         
         // obtain an input image
@@ -221,69 +220,65 @@ int main(int argc, char *argv[])
         //Mat framefull = imread("data/frame.jpg");
         //resize(framefull, frame, Size(), scale_f, scale_f, INTER_LINEAR);
         
-        if (sel) {
-            // the main pose uodate call
-            poseEstimator->estimatePoses(frame, false, true);
-        }
+        // tracking can also be started and reset by the client
+        session->applyCommands(frame);
         
-        Matx44f deltaPose = objects[0]->getPose()*oldPose.inv();
+        // the main pose uodate call
+        session->estimatePoses(frame);
         
-        std::vector<float> poseVec(deltaPose.val, deltaPose.val +16*sizeof(float));
-        //boost::asio::streambuf buf(poseVec);
-        boost::asio::write( sock, boost::asio::buffer(poseVec) );
-        cout << "Server sent Hello message to Client!" << endl;
+        // request the region for the next frame and send the pose
+        session->sendReply(slot);
         
         cout << "Pose:\n" << objects[0]->getPose() << endl;
         
-        // render the models with the resulting pose estimates ontop of the input image
-        Mat result = drawResultOverlay(objects, frame);
-        imshow("result", result);
-        
-        //stableFrame = frame.clone();
-        
-        int key = waitKey(timeout);
-        
-        // start/stop tracking the first object
-        if(key == (int)'1')
-        {
-            poseEstimator->toggleTracking(frame, 0, false);
-            poseEstimator->estimatePoses(frame, false, false);
-            timeout = 1;
-            showHelp = !showHelp;
-        }
-        if(key == (int)'2') // the same for a second object
+        // the overlay takes longer than tracking itself, so it is only drawn for every overlayInterval-th frame
+        if(config.overlayInterval > 0 && frameCount++ % config.overlayInterval == 0)
         {
-            //poseEstimator->toggleTracking(frame, 1, false);
-            //poseEstimator->estimatePoses(frame, false, false);
-        }
-        // reset the system to the initial state
-        if(key == (int)'r')
-            poseEstimator->reset();
-        // stop the demo
-        if(key == (int)'c')
-        {
-            glfwSetWindowShouldClose(RenderingEngine::Instance()->getContext(), true);
-//            break;
+            // render the models with the resulting pose estimates ontop of the input image
+            Mat result = drawResultOverlay(overlayRenderingEngine, poseEstimator->getFrameCalibration(), objects, frame, poseEstimator->getFrameFormat());
+            imshow("result", result);
+            
+            //stableFrame = frame.clone();
+            
+            int key = waitKey(timeout);
+            
+            // start/stop tracking the first object
+            if(key == (int)'1')
+            {
+                session->toggleTracking(frame, 0);
+                session->estimatePoses(frame, false);
+                timeout = 1;
+                showHelp = !showHelp;
+            }
+            if(key == (int)'2') // the same for a second object
+            {
+                //poseEstimator->toggleTracking(frame, 1, false);
+                //poseEstimator->estimatePoses(frame, false, false);
+            }
+            // reset the system to the initial state
+            if(key == (int)'r')
+                session->reset();
+            // stop the demo
+            if(key == (int)'c')
+            {
+                quit = true;
+//                break;
+            }
         }
-        glfwSwapBuffers(RenderingEngine::Instance()->getContext());
-        glfwPollEvents();
+        // the slot can be refilled by the receiver from now on
+        session->releaseFrame(slot);
     }
     
-    // After chatting close the socket
-    sock.close();
+    cout << "processed " << session->getNumProcessed() << " frames, dropped " << session->getNumDropped() << endl;
     
-    // deactivate the offscreen rendering OpenGL context
-    RenderingEngine::Instance()->doneCurrent();
+    PredictionStatistics prediction = session->getPredictionStatistics();
+    if(prediction.count > 0)
+        cout << "prediction error " << prediction.sumTranslationError/prediction.count << " (max " << prediction.maxTranslationError << "), " << prediction.sumRotationError/prediction.count << " deg (max " << prediction.maxRotationError << " deg)" << endl;
     
-    // clean up
-    RenderingEngine::Instance()->destroy();
+    delete overlayRenderingEngine;
     
-    for(int i = 0; i < objects.size(); i++)
-    {
-        delete objects[i];
-    }
-    objects.clear();
+    // close the socket and clean up the objects, the pose estimator and the rendering engine
+    delete session;
     
-    glfwTerminate();
-    delete poseEstimator;
+    RenderingEngine::terminate();
 }
@@ -68,22 +68,63 @@ Model::Model(const string modelFilename, float tx, float ty, float tz, float alp
     
     hasNormals = false;
     
+    vertexArrayID = 0;
+    vertexBufferID = 0;
+    normalBufferID = 0;
+    indexBufferID = 0;
+    
     loadModel(modelFilename);
 }
 
 
 Model::~Model()
 {
+    if(buffersInitialsed)
+    {
+        glDeleteVertexArrays(1, &vertexArrayID);
+        glDeleteBuffers(1, &vertexBufferID);
+        glDeleteBuffers(1, &normalBufferID);
+        glDeleteBuffers(1, &indexBufferID);
+    }
+    
     vertices.clear();
     normals.clear();
     
     indices.clear();
-    offsets.clear();
 }
 
 void Model::initBuffers()
 {
-    meshes->setupMesh();
+    if(buffersInitialsed)
+        return;
+    
+    glGenVertexArrays(1, &vertexArrayID);
+    glBindVertexArray(vertexArrayID);
+    
+    // the positions are a stream of their own, so the silhouette and depth passes only fetch 12 bytes per vertex
+    glGenBuffers(1, &vertexBufferID);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(Vec3f), vertices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(Shader::POSITION_LOCATION);
+    glVertexAttribPointer(Shader::POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3f), (void*)0);
+    
+    if(hasNormals)
+    {
+        glGenBuffers(1, &normalBufferID);
+        glBindBuffer(GL_ARRAY_BUFFER, normalBufferID);
+        glBufferData(GL_ARRAY_BUFFER, normals.size()*sizeof(Vec3f), normals.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(Shader::NORMAL_LOCATION);
+        glVertexAttribPointer(Shader::NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3f), (void*)0);
+    }
+    
+    glGenBuffers(1, &indexBufferID);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    buffersInitialsed = true;
 }
 
 
@@ -101,7 +142,9 @@ bool Model::isInitialized()
 
 void Model::draw(Shader *program, GLint primitives)
 {
-    meshes->Draw();
+    glBindVertexArray(vertexArrayID);
+    glDrawElements(primitives, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
 }
 
 
@@ -142,7 +185,7 @@ float Model::getScaling() {
 }
 
 
-vector<Vec3f> Model::getVertices()
+const vector<Vec3f> &Model::getVertices()
 {
     return vertices;
 }
@@ -152,6 +195,11 @@ int Model::getNumVertices()
     return (int)vertices.size();
 }
 
+const vector<GLuint> &Model::getIndices()
+{
+    return indices;
+}
+
 
 int Model::getModelID()
 {
@@ -179,57 +227,23 @@ void Model::loadModel(const string modelFilename)
     
     const aiScene* scene = importer.ReadFile(modelFilename, aiProcessPreset_TargetRealtime_Fast);
     
-    aiMesh *mesh = scene->mMeshes[0];
-    
-    // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
-    
-    hasNormals = mesh->HasNormals();
+    if(scene == NULL || scene->mRootNode == NULL)
+    {
+        cout << "Could not load the model " << modelFilename << ": " << importer.GetErrorString() << endl;
+        return;
+    }
     
     float inf = numeric_limits<float>::infinity();
     lbn = Vec3f(inf, inf, inf);
     rtf = Vec3f(-inf, -inf, -inf);
     
-    for(int i = 0; i < mesh->mNumFaces; i++)
-    {
-        aiFace f = mesh->mFaces[i];
-        
-        indices.push_back(f.mIndices[0]);
-        indices.push_back(f.mIndices[1]);
-        indices.push_back(f.mIndices[2]);
-    }
-    
-    for(int i = 0; i < mesh->mNumVertices; i++)
+    for(int i = 0; i < scene->mNumMeshes; i++)
     {
-        aiVector3D v = mesh->mVertices[i];
-        
-        Vec3f p(v.x, v.y, v.z);
-        
-        // compute the 3D bounding box of the model
-        if (p[0] < lbn[0]) lbn[0] = p[0];
-        if (p[1] < lbn[1]) lbn[1] = p[1];
-        if (p[2] < lbn[2]) lbn[2] = p[2];
-        if (p[0] > rtf[0]) rtf[0] = p[0];
-        if (p[1] > rtf[1]) rtf[1] = p[1];
-        if (p[2] > rtf[2]) rtf[2] = p[2];
-        
-        vertices.push_back(p);
+        hasNormals |= scene->mMeshes[i]->HasNormals();
     }
     
-    if(hasNormals)
-    {
-        for(int i = 0; i < mesh->mNumVertices; i++)
-        {
-            aiVector3D n = mesh->mNormals[i];
-            
-            Vec3f vn = Vec3f(n.x, n.y, n.z);
-            
-            normals.push_back(vn);
-        }
-    }
-    
-    offsets.push_back(0);
-    offsets.push_back(mesh->mNumFaces*3);
+    // process ASSIMP's root node recursively
+    processNode(scene->mRootNode, scene, aiMatrix4x4());
     
     // the center of the 3d bounding box
     Vec3f bbCenter = (rtf + lbn)/2;
@@ -242,8 +256,11 @@ void Model::loadModel(const string modelFilename)
 
 
 // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-void Model::processNode(aiNode* node, const aiScene* scene)
+void Model::processNode(aiNode* node, const aiScene* scene, const aiMatrix4x4 &parentTransform)
 {
+    // the meshes are placed in the model by the transforms of all nodes above them
+    aiMatrix4x4 transform = parentTransform*node->mTransformation;
+    
     // process each mesh located at the current node
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
@@ -251,104 +268,65 @@ void Model::processNode(aiNode* node, const aiScene* scene)
         // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
         
-        for(int i = 0; i < mesh->mNumVertices; i++)
-        {
-            aiVector3D v = mesh->mVertices[i];
-            
-            Vec3f p(v.x, v.y, v.z);
-            
-            // compute the 3D bounding box of the model
-            if (p[0] < lbn[0]) lbn[0] = p[0];
-            if (p[1] < lbn[1]) lbn[1] = p[1];
-            if (p[2] < lbn[2]) lbn[2] = p[2];
-            if (p[0] > rtf[0]) rtf[0] = p[0];
-            if (p[1] > rtf[1]) rtf[1] = p[1];
-            if (p[2] > rtf[2]) rtf[2] = p[2];
-            
-            vertices.push_back(p);
-        }
-        
-        if(hasNormals)
-        {
-            for(int i = 0; i < mesh->mNumVertices; i++)
-            {
-                aiVector3D n = mesh->mNormals[i];
-                
-                Vec3f vn = Vec3f(n.x, n.y, n.z);
-            }
-        }
-        
-        meshes = processMesh(mesh, scene);
+        processMesh(mesh, transform);
     }
     // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, transform);
     }
-    cout << "Node" << endl;
 }
 
-Mesh* Model::processMesh(aiMesh* mesh, const aiScene* scene)
+// appends the vertices and triangles of a mesh, transformed into model coordinates, to those of the model
+void Model::processMesh(aiMesh* mesh, const aiMatrix4x4 &transform)
 {
-    // data to fill
-    vector<Vertex> vertexes; // CHANGE
-    vector<unsigned int> indices;
-
-    // walk through each of the mesh's vertices
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+    GLuint baseVertex = (GLuint)vertices.size();
+    
+    // normals are transformed by the inverse transpose, which keeps them perpendicular under non-uniform scaling
+    aiMatrix3x3 normalTransform = aiMatrix3x3(transform).Inverse().Transpose();
+    
+    for(int i = 0; i < mesh->mNumVertices; i++)
     {
-        Vertex vertex;
-        glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-        // positions
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.Position = vector;
-        // normals
-        if (mesh->HasNormals())
-        {
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.Normal = vector;
-        }
-        // texture coordinates
-        if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+        aiVector3D v = transform*mesh->mVertices[i];
+        
+        Vec3f p(v.x, v.y, v.z);
+        
+        // compute the 3D bounding box of the model
+        if (p[0] < lbn[0]) lbn[0] = p[0];
+        if (p[1] < lbn[1]) lbn[1] = p[1];
+        if (p[2] < lbn[2]) lbn[2] = p[2];
+        if (p[0] > rtf[0]) rtf[0] = p[0];
+        if (p[1] > rtf[1]) rtf[1] = p[1];
+        if (p[2] > rtf[2]) rtf[2] = p[2];
+        
+        vertices.push_back(p);
+    }
+    
+    // the normal stream has to stay aligned with the positions, even for meshes without normals
+    if(hasNormals)
+    {
+        for(int i = 0; i < mesh->mNumVertices; i++)
         {
-            glm::vec2 vec;
-            // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
-            // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.TexCoords = vec;
-            // tangent
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.Tangent = vector;
-            // bitangent
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.Bitangent = vector;
+            Vec3f vn(0, 0, 0);
+            if(mesh->HasNormals())
+            {
+                aiVector3D n = normalTransform*mesh->mNormals[i];
+                n.Normalize();
+                vn = Vec3f(n.x, n.y, n.z);
+            }
+            normals.push_back(vn);
         }
-        else
-            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-        vertexes.push_back(vertex);
     }
-    // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    
+    // points and lines left after triangulation are not drawn
+    for(int i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
-        // retrieve all indices of the face and store them in the indices vector
-        for (unsigned int j = 0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
+        aiFace f = mesh->mFaces[i];
+        if(f.mNumIndices != 3)
+            continue;
+        
+        indices.push_back(baseVertex + f.mIndices[0]);
+        indices.push_back(baseVertex + f.mIndices[1]);
+        indices.push_back(baseVertex + f.mIndices[2]);
     }
-    // process materials
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-    // return a mesh object created from the extracted mesh data
-    return new Mesh(vertexes, indices);
-    cout << "Model" << endl;
 }
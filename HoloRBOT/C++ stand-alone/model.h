@@ -48,7 +48,6 @@
 
 #include "transformations.h"
 #include "shader.h"
-#include "mesh.h"
 
 /**
  *  A 3d model class based on the ASSIMP library mostly implemented
@@ -56,16 +55,15 @@
  *  model data from a specified file, drawing the model with OpenGL
  *  as well as calculating the bounding box of the model and setting
  *  individual vertex colors. The model data is uploaded to the GPU in
- *  form of VertexBufferObjects.
+ *  form of VertexBufferObjects. All meshes of the file are merged into one
+ *  tightly packed stream of vertex positions, a separate stream of normals
+ *  that is only read by the shaders using them and a single index buffer,
+ *  such that the model is drawn in one call.
  */
 class Model
 {
     
 public:
-    Mesh *meshes;
-    std::string directory;
-    bool gammaCorrection;
-    
     /**
      *  Constructor loading the 3d model data from a given OBJ/PLY file.
      *  The initial pose is computed from 3 translation parameters tx, ty, tz
@@ -84,6 +82,10 @@ public:
      */
     Model(const std::string modelFilename, float tx, float ty, float tz, float alpha, float beta, float gamma, float scale);
     
+    /**
+     *  Deletes the vertex buffer objects of the model if they have been created,
+     *  in which case the OpenGL context must be current.
+     */
     ~Model();
     
     /**
@@ -203,7 +205,7 @@ public:
      *
      *  @return  A vector containing all unnormalized 3D model verticies.
      */
-    std::vector<cv::Vec3f> getVertices();
+    const std::vector<cv::Vec3f> &getVertices();
     
     /**
      *  Returns the total number of 3D model verticies.
@@ -212,6 +214,14 @@ public:
      */
     int getNumVertices();
     
+    /**
+     *  Returns the vertex indices of all triangles of the model, three per
+     *  triangle, in the order they are drawn.
+     *
+     *  @return  The vertex indices of all triangles of the model.
+     */
+    const std::vector<GLuint> &getIndices();
+    
     /**
      *  Returns the index of the model. These indices should be
      *  unique and within [1,255] as they also define the rendering
@@ -252,10 +262,14 @@ private:
     std::vector<cv::Vec3f> vertices;
     std::vector<cv::Vec3f> normals;
     std::vector<GLuint> indices;
-    std::vector<GLuint> offsets;
     
     bool buffersInitialsed;
     
+    GLuint vertexArrayID;
+    GLuint vertexBufferID;
+    GLuint normalBufferID;
+    GLuint indexBufferID;
+    
     cv::Vec3f lbn;
     cv::Vec3f rtf;
     float scaling;
@@ -268,11 +282,11 @@ private:
      */
     void loadModel(const std::string modelFilename);
     
-    void processNode(aiNode* node, const aiScene* scene);
+    void processNode(aiNode* node, const aiScene* scene, const aiMatrix4x4 &parentTransform);
     
     void initNode(aiNode* node, const aiScene* scene);
     
-    Mesh* processMesh(aiMesh* mesh, const aiScene* scene);
+    void processMesh(aiMesh* mesh, const aiMatrix4x4 &transform);
 };
 
 #endif /* MODEL_H */
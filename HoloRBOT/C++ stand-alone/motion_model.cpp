@@ -0,0 +1,113 @@
+#include "motion_model.h"
+#include "transformations.h"
+
+using namespace std;
+using namespace cv;
+
+PredictionStatistics::PredictionStatistics()
+{
+    count = 0;
+    sumTranslationError = 0;
+    sumRotationError = 0;
+    maxTranslationError = 0;
+    maxRotationError = 0;
+}
+
+
+void PredictionStatistics::add(float translationError, float rotationError)
+{
+    count++;
+    sumTranslationError += translationError;
+    sumRotationError += rotationError;
+    maxTranslationError = max(maxTranslationError, translationError);
+    maxRotationError = max(maxRotationError, rotationError);
+}
+
+
+void PredictionStatistics::add(const PredictionStatistics &other)
+{
+    count += other.count;
+    sumTranslationError += other.sumTranslationError;
+    sumRotationError += other.sumRotationError;
+    maxTranslationError = max(maxTranslationError, other.maxTranslationError);
+    maxRotationError = max(maxRotationError, other.maxRotationError);
+}
+
+
+MotionModel::MotionModel(float smoothing, float maxExtrapolation)
+{
+    this->smoothing = smoothing;
+    this->maxExtrapolation = maxExtrapolation;
+    
+    reset();
+}
+
+
+void MotionModel::update(const cv::Matx44f &pose, uint64_t timestamp)
+{
+    if(numUpdates == 0 || timestamp <= lastTimestamp)
+    {
+        lastPose = pose;
+        lastTimestamp = timestamp;
+        numUpdates = max(numUpdates, 1);
+        return;
+    }
+    
+    // measure how well the previous motion predicted the new estimate
+    if(numUpdates >= 2)
+    {
+        Matx44f predicted = predict(timestamp);
+        
+        Vec3f dTranslation = Vec3f(predicted(0, 3) - pose(0, 3), predicted(1, 3) - pose(1, 3), predicted(2, 3) - pose(2, 3));
+        
+        Matx33f dR = predicted.get_minor<3, 3>(0, 0).t()*pose.get_minor<3, 3>(0, 0);
+        float cosAngle = min(max((dR(0, 0) + dR(1, 1) + dR(2, 2) - 1.0f)*0.5f, -1.0f), 1.0f);
+        
+        statistics.add(norm(dTranslation), acos(cosAngle)*180.0f/float(CV_PI));
+    }
+    
+    // the relative motion since the last estimate, such that pose = exp(xi)*lastPose
+    float seconds = (timestamp - lastTimestamp)*1e-6f;
+    Matx61f measured = Transformations::log(pose*lastPose.inv())*(1.0f/seconds);
+    
+    if(numUpdates == 1)
+        velocity = measured;
+    else
+        velocity = velocity*smoothing + measured*(1.0f - smoothing);
+    
+    lastPose = pose;
+    lastTimestamp = timestamp;
+    numUpdates++;
+}
+
+
+void MotionModel::reset()
+{
+    numUpdates = 0;
+    lastPose = Matx44f::eye();
+    lastTimestamp = 0;
+    velocity = Matx61f::zeros();
+}
+
+
+bool MotionModel::isValid()
+{
+    return numUpdates > 0;
+}
+
+
+Matx44f MotionModel::predict(uint64_t timestamp)
+{
+    if(numUpdates < 2 || timestamp <= lastTimestamp)
+        return lastPose;
+    
+    float seconds = min((timestamp - lastTimestamp)*1e-6f, maxExtrapolation);
+    
+    return Transformations::exp(velocity*seconds)*lastPose;
+}
+
+
+const PredictionStatistics& MotionModel::getStatistics()
+{
+    return statistics;
+}
@@ -0,0 +1,112 @@
+#ifndef MOTION_MODEL_H
+#define MOTION_MODEL_H
+
+#include <stdint.h>
+
+#include <opencv2/core.hpp>
+
+/**
+ *  Running statistics of the error between predicted and estimated poses.
+ */
+struct PredictionStatistics
+{
+    PredictionStatistics();
+    
+    /**
+     *  Adds the error of a single prediction.
+     *
+     *  @param  translationError The distance between the predicted and the estimated translation.
+     *  @param  rotationError The angle in degrees between the predicted and the estimated rotation.
+     */
+    void add(float translationError, float rotationError);
+    
+    /**
+     *  Adds all predictions of another set of statistics.
+     *
+     *  @param  other The statistics to be merged.
+     */
+    void add(const PredictionStatistics &other);
+    
+    uint64_t count;
+    
+    double sumTranslationError;
+    double sumRotationError;
+    
+    float maxTranslationError;
+    float maxRotationError;
+};
+
+/**
+ *  A constant velocity motion model of a rigid object. The velocity is kept
+ *  in twist coordinates per second, computed from the relative motion
+ *  between consecutive pose estimates with Transformations::log, and poses
+ *  are extrapolated with Transformations::exp. Every new estimate is also
+ *  compared to the pose predicted for its timestamp, which yields running
+ *  statistics of the prediction error.
+ */
+class MotionModel
+{
+public:
+    /**
+     *  Constructor of a motion model without any pose estimate.
+     *
+     *  @param  smoothing The weight of the previous velocity when a new one is measured, within [0, 1) (0 = no smoothing).
+     *  @param  maxExtrapolation The longest time in seconds a pose is extrapolated into the future.
+     */
+    MotionModel(float smoothing = 0.5f, float maxExtrapolation = 0.1f);
+    
+    /**
+     *  Adds a new pose estimate and updates the velocity.
+     *
+     *  @param  pose The estimated pose T_cm of the object.
+     *  @param  timestamp The capture time of the frame the pose was estimated from in microseconds.
+     */
+    void update(const cv::Matx44f &pose, uint64_t timestamp);
+    
+    /**
+     *  Forgets the motion, e.g. after the object has been lost.
+     */
+    void reset();
+    
+    /**
+     *  Tells whether the model has seen a pose estimate since the last reset.
+     *
+     *  @return True if poses can be predicted and false otherwise.
+     */
+    bool isValid();
+    
+    /**
+     *  Extrapolates the last pose estimate to the given time, assuming the
+     *  object keeps moving with its current velocity. Times before the last
+     *  estimate return the last estimate.
+     *
+     *  @param  timestamp The time to predict the pose for in microseconds (same clock as in update).
+     *  @return The predicted pose T_cm of the object.
+     */
+    cv::Matx44f predict(uint64_t timestamp);
+    
+    /**
+     *  Returns the errors of predicting every pose estimate from the previous
+     *  ones since the model has been created.
+     *
+     *  @return The prediction error statistics.
+     */
+    const PredictionStatistics& getStatistics();
+
+private:
+    float smoothing;
+    float maxExtrapolation;
+    
+    // number of estimates since the last reset
+    int numUpdates;
+    
+    cv::Matx44f lastPose;
+    uint64_t lastTimestamp;
+    
+    // twist coordinates per second
+    cv::Matx61f velocity;
+    
+    PredictionStatistics statistics;
+};
+
+#endif /* MOTION_MODEL_H */
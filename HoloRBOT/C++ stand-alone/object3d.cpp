@@ -51,6 +51,8 @@ Object3D::Object3D(const string objFilename, float tx, float ty, float tz, float
     
     this->qualityThreshold = qualityThreshold;
     
+    this->energy = 0.0f;
+    
     this->templateDistances = templateDistances;
     
     this->numDistances = (int)templateDistances.size();
@@ -150,6 +152,16 @@ float Object3D::getQualityThreshold()
     return qualityThreshold;
 }
 
+float Object3D::getEnergy()
+{
+    return energy;
+}
+
+void Object3D::setEnergy(float val)
+{
+    energy = val;
+}
+
 
 TCLCHistograms *Object3D::getTCLCHistograms()
 {
@@ -157,7 +169,7 @@ TCLCHistograms *Object3D::getTCLCHistograms()
 }
 
 
-void Object3D::generateTemplates()
+void Object3D::generateTemplates(RenderingEngine *renderingEngine)
 {
     int numLevels = 4;
     
@@ -178,21 +190,16 @@ void Object3D::generateTemplates()
         {
             for(int d = 0; d < numDistances; d++)
             {
-                baseTemplates.push_back(new TemplateView(this, alpha, beta, gamma, templateDistances[d], numLevels, true));
+                baseTemplates.push_back(new TemplateView(alpha, beta, gamma, templateDistances[d], numLevels, true));
             }
         }
-        cout << "Base, i: " << i << endl;
     }
         
     int gamma2Precision = 30;
     
-    cout << subdivIcosahedron.size() << endl; // n<20?
-    
     // create all neighboring templates
     for(int i = 0; i < subdivIcosahedron.size(); i++)
     {
-        if (i > 10)
-            cout << 42-i << endl;
         Vec3f v = subdivIcosahedron[i];
         
         float r = norm(v);
@@ -203,11 +210,15 @@ void Object3D::generateTemplates()
         {
             for(int d = 0; d < numDistances; d++)
             {
-                neighboringTemplates.push_back(new TemplateView(this, alpha, beta, gamma, templateDistances[d], numLevels, true));
+                neighboringTemplates.push_back(new TemplateView(alpha, beta, gamma, templateDistances[d], numLevels, true));
             }
         }
     }
-    cout << "Neighbors" << endl;
+    
+    vector<TemplateView*> templates(baseTemplates);
+    templates.insert(templates.end(), neighboringTemplates.begin(), neighboringTemplates.end());
+    
+    renderTemplates(renderingEngine, templates, numLevels);
     
     int gamma2Steps = 360/gamma2Precision;
     
@@ -256,6 +267,75 @@ void Object3D::generateTemplates()
 }
 
 
+void Object3D::renderTemplates(RenderingEngine *renderingEngine, vector<TemplateView*> &templates, int numLevels)
+{
+    vector<Matx44f> poses(templates.size());
+    vector<Rect> regions(templates.size());
+    vector<Rect> tiles;
+    
+    renderingEngine->setLevel(0);
+    
+    Size imageSize = renderingEngine->getROI().size();
+    Matx33f K = renderingEngine->getCalibrationMatrix().get_minor<3, 3>(0, 0);
+    
+    // the silhouette lies within the projected bounding box, the margin keeps the
+    // neighborhood of the contour tested for the histogram centers inside the region
+    int margin = 8;
+    for(int i = 0; i < templates.size(); i++)
+    {
+        poses[i] = templates[i]->getPose();
+        
+        setPose(poses[i]);
+        
+        vector<Point2f> projections;
+        Rect boundingRect;
+        renderingEngine->projectBoundingBox(this, projections, boundingRect);
+        
+        regions[i] = Rect(boundingRect.x - margin, boundingRect.y - margin, boundingRect.width + 2*margin, boundingRect.height + 2*margin) & Rect(Point(0, 0), imageSize);
+    }
+    
+    for(int first = 0; first < templates.size();)
+    {
+        int count = renderingEngine->renderSilhouetteAtlas(this, poses, regions, first, tiles);
+        
+        Mat masks = renderingEngine->downloadAtlas(RenderingEngine::MASK);
+        Mat depths = renderingEngine->downloadAtlas(RenderingEngine::LINEAR_DEPTH);
+        
+        for(int t = 0; t < count; t++)
+        {
+            templates[first + t]->computeHistogramCenters(this, masks(tiles[t]), depths(tiles[t]), regions[first + t].tl(), K, imageSize);
+        }
+        
+        first += count;
+    }
+    
+    // the higher levels only need the region of interest of each template
+    for(int level = 2; level < numLevels; level++)
+    {
+        renderingEngine->setLevel(level);
+        
+        for(int i = 0; i < templates.size(); i++)
+        {
+            regions[i] = templates[i]->getROI(level);
+        }
+        
+        for(int first = 0; first < templates.size();)
+        {
+            int count = renderingEngine->renderSilhouetteAtlas(this, poses, regions, first, tiles);
+            
+            Mat masks = renderingEngine->downloadAtlas(RenderingEngine::MASK);
+            
+            for(int t = 0; t < count; t++)
+            {
+                templates[first + t]->computeTemplate(this, level, masks(tiles[t]));
+            }
+            
+            first += count;
+        }
+    }
+}
+
+
 vector<TemplateView*> Object3D::getTemplateViews()
 {
     return baseTemplates;
@@ -275,4 +355,6 @@ void Object3D::reset()
     tclcHistograms->clear();
     
     trackingLost = false;
+    
+    energy = 0.0f;
 }
@@ -40,6 +40,7 @@
 
 class TCLCHistograms;
 class TemplateView;
+class RenderingEngine;
 
 /**
  *  A representation of a 3D object that provides all nessecary information
@@ -94,6 +95,22 @@ public:
      *  @return  The tracking quality threshold.
      */
     float getQualityThreshold();
+    
+    /**
+     *  Returns the value of the energy function evaluated for the last pose
+     *  estimate, which is compared to the quality threshold to detect a
+     *  tracking loss.
+     *
+     *  @return  The energy of the last pose estimate or 0 if it has not been evaluated yet.
+     */
+    float getEnergy();
+    
+    /**
+     *  Sets the value of the energy function of the last pose estimate.
+     *
+     *  @param val The energy of the last pose estimate.
+     */
+    void setEnergy(float val);
 
     /**
      *  Returns the set of tclc-histograms associated with this object.
@@ -108,8 +125,10 @@ public:
      *  Must be called after the rendering buffers of the
      *  corresponding 3D model have been initialized and while
      *  the offscreen rendering OpenGL context is active.
+     *
+     *  @param renderingEngine The initialized rendering engine used for rendering the templates.
      */
-    void generateTemplates();
+    void generateTemplates(RenderingEngine *renderingEngine);
     
     /**
      *  Returns the set of all pre-generated base and neighboring template views
@@ -138,6 +157,8 @@ private:
     
     float qualityThreshold;
     
+    float energy;
+    
     int numDistances;
     
     std::vector<float> templateDistances;
@@ -150,6 +171,8 @@ private:
     std::vector<TemplateView*> baseTemplates;
     std::vector<TemplateView*> neighboringTemplates;
     
+    void renderTemplates(RenderingEngine *renderingEngine, std::vector<TemplateView*> &templates, int numLevels);
+    
 };
 
 
@@ -39,22 +39,41 @@ using namespace std;
 using namespace cv;
 
 
-OptimizationEngine::OptimizationEngine(int width, int height)
+OptimizationEngine::OptimizationEngine(int width, int height, RenderingEngine *renderingEngine)
 {
-    renderingEngine = RenderingEngine::Instance();
+    this->renderingEngine = renderingEngine;
     
     SDT2D = new SignedDistanceTransform2D(8.0f);
     
     this->width = width;
     this->height = height;
+    
+    frameFormat = FRAME_FORMAT_BGR;
 }
 
 OptimizationEngine::~OptimizationEngine()
 {
+    delete renderingEngine;
+    
     delete SDT2D;
 }
 
 
+void OptimizationEngine::setCalibration(const Matx33f &K, int width, int height)
+{
+    renderingEngine->setCalibration(K, width, height);
+    
+    this->width = width;
+    this->height = height;
+}
+
+
+void OptimizationEngine::setFrameFormat(FrameFormat format)
+{
+    frameFormat = format;
+}
+
+
 void OptimizationEngine::minimize(vector<Mat>& imagePyramid, vector<Object3D*>& objects, int runs)
 {
     // OPTIMIZATION ITERATIONS
@@ -83,7 +102,7 @@ void OptimizationEngine::minimize(vector<Mat>& imagePyramid, vector<Object3D*>&
 void OptimizationEngine::runIteration(vector<Object3D*>& objects, const vector<Mat>& imagePyramid, int level)
 {
     Rect roi;
-    Mat mask, depth, depthInv, sdt, xyPos;
+    Mat depths, mask, depth, depthInv, sdt, xyPos;
     Mat croppedMask, croppedDepth, croppedDepthInv;
     
     renderingEngine->setLevel(level);
@@ -111,69 +130,114 @@ void OptimizationEngine::runIteration(vector<Object3D*>& objects, const vector<M
         }
     }
     
-    // render the common silhouette mask
+    // the objects to be processed and their 2D regions of interest, only the
+    // region enclosing all of them is rendered and downloaded
+    vector<int> tracked;
+    vector<Rect> rois;
+    Rect commonROI;
+    for(int o = 0; o < objects.size(); o++)
+    {
+        if(objects[o]->isInitialized())
+        {
+            // compute the 2D region of interest containing the silhouette of the current object
+            roi = compute2DROI(objects[o], Size(width/pow(2, level), height/pow(2, level)), 8);
+            
+            if(roi.area() != 0)
+            {
+                tracked.push_back(o);
+                rois.push_back(roi);
+                commonROI = (tracked.size() == 1) ? roi : (commonROI | roi);
+            }
+        }
+    }
+    
+    if(tracked.empty())
+    {
+        return;
+    }
+    
+    // render the common silhouette mask together with the front and back depth buffers
     renderingEngine->setLevel(level);
-    renderingEngine->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), GL_FILL);
+    renderingEngine->setROI(commonROI);
+    renderingEngine->renderDepths(vector<Model*>(objects.begin(), objects.end()));
     
-    // download the depth buffer
-    depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
+    int depthsRequest = renderingEngine->requestFrame(RenderingEngine::FRONT_BACK_DEPTH);
     
-    // if more than one object is initialized, download the common silhouette
-    // mask required for occlusion detection
-    if(numInitialized > 1)
+    // where the roi of an object overlaps that of another, the common back depth
+    // may belong to the other one, so the object's own inverse depth buffer is
+    // rendered, all of them are downloaded while the others are processed on the CPU
+    vector<int> depthInvRequests(tracked.size(), -1);
+    for(int i = 0; i < tracked.size(); i++)
     {
-        mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
+        for(int j = 0; j < tracked.size(); j++)
+        {
+            if(j != i && (rois[i] & rois[j]).area() > 0)
+            {
+                depthInvRequests[i] = requestInverseDepth(objects[tracked[i]], rois[i]);
+                break;
+            }
+        }
     }
-    else // otherwise for a single object the mask is equal to the depth buffer
+    
+    renderingEngine->fetchFrame(depthsRequest, depths);
+    renderingEngine->splitDepths(depths, mask, depth, depthInv);
+    
+    // for a single object the mask is equal to the depth buffer
+    if(numInitialized <= 1)
     {
         mask = depth;
     }
     
-    for(int o = 0; o < objects.size(); o++)
+    for(int i = 0; i < tracked.size(); i++)
     {
-        if(objects[o]->isInitialized())
+        int o = tracked[i];
+        roi = rois[i];
+        
+        // crop the common images wrt to the 2D roi
+        Rect commonCrop = Rect(roi.tl() - commonROI.tl(), roi.size());
+        croppedMask = mask(commonCrop).clone();
+        croppedDepth = depth(commonCrop).clone();
+        
+        // the own inverse depth buffer is only rendered within the roi
+        if(depthInvRequests[i] >= 0)
         {
-            // compute the 2D region of interest containing the silhouette of the current object
-            roi = compute2DROI(objects[o], Size(width/pow(2, level), height/pow(2, level)), 8);
-            
-            if(roi.area() == 0)
-            {
-                continue;
-            }
-            
-            // render the individual inverse depth buffer per object
-            renderingEngine->renderSilhouette(objects[o], GL_FILL, true);
-            depthInv = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
-            
-            // crop the images wrt to the 2D roi
-            croppedMask = mask(roi).clone();
-            croppedDepth = depth(roi).clone();
-            croppedDepthInv = depthInv(roi).clone();
-            
-            int m_id = (numInitialized <= 1) ? -1 : objects[o]->getModelID();
-            
-            // compute the 2D signed distance transform of the silhouette
-            SDT2D->computeTransform(croppedMask, sdt, xyPos, 8, m_id);
-            
-            // the hessian approximation
-            Matx66f wJTJ;
-            // the gradient
-            Matx61f JT;
-            
-            // compute the Jacobian terms (i.e. the gradient and the hessian approx.) needed for the Gauss-Newton step
-            parallel_computeJacobians(objects[o], imagePyramid[level], croppedDepth, croppedDepthInv, sdt, xyPos, roi, croppedMask, m_id, level, wJTJ, JT, roi.height);
-            
-            // update the pose by computing the Gauss-Newton step
-            applyStepGaussNewton(objects[o], wJTJ, JT);
+            renderingEngine->fetchFrame(depthInvRequests[i], croppedDepthInv);
         }
+        else
+        {
+            croppedDepthInv = depthInv(commonCrop).clone();
+        }
+        
+        int m_id = (numInitialized <= 1) ? -1 : objects[o]->getModelID();
+        
+        // compute the 2D signed distance transform of the silhouette
+        SDT2D->computeTransform(croppedMask, sdt, xyPos, 8, m_id);
+        
+        // the hessian approximation
+        Matx66f wJTJ;
+        // the gradient
+        Matx61f JT;
+        
+        // compute the Jacobian terms (i.e. the gradient and the hessian approx.) needed for the Gauss-Newton step
+        parallel_computeJacobians(objects[o], imagePyramid[level], croppedDepth, croppedDepthInv, sdt, xyPos, roi, croppedMask, m_id, level, wJTJ, JT, roi.height);
+        
+        // update the pose by computing the Gauss-Newton step
+        applyStepGaussNewton(objects[o], wJTJ, JT);
     }
 }
 
 
+int OptimizationEngine::requestInverseDepth(Object3D* object, const Rect& roi)
+{
+    // render the individual inverse depth buffer per object
+    renderingEngine->setROI(roi);
+    renderingEngine->renderSilhouette(object, GL_FILL, true);
+    return renderingEngine->requestFrame(RenderingEngine::LINEAR_DEPTH);
+}
+
+
 void OptimizationEngine::parallel_computeJacobians(Object3D* object, const Mat& frame, const Mat& depth, const Mat& depthInv, const Mat& sdt, const Mat& xyPos, const Rect& roi, const cv::Mat& mask, int m_id, int level, Matx66f& wJTJ, Matx61f &JT, int threads)
 {
-    float zNear = renderingEngine->getZNear();
-    float zFar = renderingEngine->getZFar();
     Matx33f K = renderingEngine->getCalibrationMatrix().get_minor<3, 3>(0, 0);
     
     JT = Matx61f::zeros();
@@ -182,7 +246,7 @@ void OptimizationEngine::parallel_computeJacobians(Object3D* object, const Mat&
     vector<Matx61f> JTCollection(threads);
     vector<Matx66f> wJTJCollection(threads);
     
-    parallel_for_(cv::Range(0, threads), Parallel_For_computeJacobiansGN(object->getTCLCHistograms(), frame, sdt, xyPos, depth, depthInv, K, zNear, zFar, roi, mask, m_id, level, wJTJCollection, JTCollection, threads));
+    parallel_for_(cv::Range(0, threads), Parallel_For_computeJacobiansGN(object->getTCLCHistograms(), frame, sdt, xyPos, depth, depthInv, K, roi, mask, m_id, level, wJTJCollection, JTCollection, threads, frameFormat));
     
     for(int i = 0; i < threads; i++)
     {
@@ -60,8 +60,9 @@ public:
      *
      *  @param width  The width in pixels of the camera frame at full resolution.
      *  @param height  The height in pixels of the camera frame at full resolution.
+     *  @param renderingEngine  An initialized rendering engine used only by the optimization, it is deleted together with it.
      */
-    OptimizationEngine(int width, int height);
+    OptimizationEngine(int width, int height, RenderingEngine *renderingEngine);
     
     ~OptimizationEngine();
     
@@ -80,6 +81,26 @@ public:
      */
     void minimize(std::vector<cv::Mat> &imagePyramid, std::vector<Object3D*> &objects, int runs = 1);
     
+    /**
+     *  Sets the intrinsics and the resolution of the camera frames passed to
+     *  minimize, in case they differ from the ones given to the constructor
+     *  (e.g. for cropped frames).
+     *
+     *  @param K  The intrinsic camera matrix of the camera frames.
+     *  @param width  The width in pixels of the camera frame at level 0.
+     *  @param height  The height in pixels of the camera frame at level 0.
+     */
+    void setCalibration(const cv::Matx33f &K, int width, int height);
+    
+    /**
+     *  Sets the format of the camera frames passed to minimize. The first
+     *  pyramid level has this format, the others are 3 channel images in
+     *  the same color space.
+     *
+     *  @param format The format of the frames.
+     */
+    void setFrameFormat(FrameFormat format);
+    
 private:
     static OptimizationEngine *instance;
     
@@ -90,8 +111,13 @@ private:
     int width;
     int height;
     
+    FrameFormat frameFormat;
+    
     void runIteration(std::vector<Object3D*> &objects, const std::vector<cv::Mat> &imagePyramid, int level);
     
+    // renders the inverse depth buffer of an object within its roi and starts downloading it
+    int requestInverseDepth(Object3D *object, const cv::Rect &roi);
+    
     void parallel_computeJacobians(Object3D *object, const cv::Mat &frame, const cv::Mat &depth, const cv::Mat &depthInv, const cv::Mat &sdt, const cv::Mat &xyPos, const cv::Rect &roi, const cv::Mat &mask, int m_id, int level, cv::Matx66f &wJTJ, cv::Matx61f &JT, int threads);
     
     cv::Rect compute2DROI(Object3D *object, const cv::Size &maxSize, int offset);
@@ -120,7 +146,11 @@ private:
     
     int numHistograms, radius2, upscale, numBins, binShift, fullWidth, fullHeight, _m_id;
     
-    float _fx, _fy, _zNear, _zFar;
+    size_t frameStep;
+    
+    PixelLayout layout;
+    
+    float _fx, _fy;
     
     bool maskAvailable;
     
@@ -134,7 +164,7 @@ private:
     int _threads;
     
 public:
-    Parallel_For_computeJacobiansGN(TCLCHistograms *tclcHistograms, const cv::Mat &frame, const cv::Mat &sdt, const cv::Mat &xyPos, const cv::Mat &depth, const cv::Mat &depthInv, const cv::Matx33f &K, float zNear, float zFar, const cv::Rect &roi, const cv::Mat &mask, int m_id, int level, std::vector<cv::Matx66f> &wJTJCollection, std::vector<cv::Matx61f> &JTCollection, int threads)
+    Parallel_For_computeJacobiansGN(TCLCHistograms *tclcHistograms, const cv::Mat &frame, const cv::Mat &sdt, const cv::Mat &xyPos, const cv::Mat &depth, const cv::Mat &depthInv, const cv::Matx33f &K, const cv::Rect &roi, const cv::Mat &mask, int m_id, int level, std::vector<cv::Matx66f> &wJTJCollection, std::vector<cv::Matx61f> &JTCollection, int threads, FrameFormat format = FRAME_FORMAT_BGR)
     {
         frameData = frame.data;
         
@@ -163,6 +193,12 @@ public:
         fullWidth = frame.cols;
         fullHeight = frame.rows;
         
+        // the rows of the frame may be padded, e.g. when tracking directly on the memory of a camera buffer
+        frameStep = frame.step;
+        
+        // 4 channel frames are read directly, without converting them first
+        layout = PixelLayout(frame, format);
+        
         sdtData = (float*)sdt.ptr<float>();
         xyPosData = (int*)xyPos.ptr<int>();
         
@@ -183,9 +219,6 @@ public:
         _fx = K(0, 0);
         _fy = K(1, 1);
         
-        _zNear = zNear;
-        _zFar = zFar;
-        
         _roi = roi;
         
         _wJTJCollection = wJTJCollection.data();
@@ -201,7 +234,7 @@ public:
             uchar mVal = maskData[idx];
             if(mVal != 0 && mVal != _m_id)
             {
-                float d2 = 1.0f - depthData[idx];
+                float d2 = depthData[idx];
                 if(d2 < d)
                 {
                     return true;
@@ -230,7 +263,7 @@ public:
                 uchar mVal = maskData[idx2 + xoffset];
                 if(mVal != 0 && mVal != _m_id)
                 {
-                    float d2 = 1.0f - depthData[idx2 + xoffset];
+                    float d2 = depthData[idx2 + xoffset];
                     if(d2 < d)
                     {
                         return true;
@@ -240,7 +273,7 @@ public:
                 mVal = maskData[idx2 + yoffset];
                 if(mVal != 0 && mVal != _m_id)
                 {
-                    float d2 = 1.0f - depthData[idx2 + yoffset];
+                    float d2 = depthData[idx2 + yoffset];
                     if(d2 < d)
                     {
                         return true;
@@ -250,7 +283,7 @@ public:
                 mVal = maskData[idx2 + yoffset + xoffset];
                 if(mVal != 0 && mVal != _m_id)
                 {
-                    float d2 = 1.0f - depthData[idx2 + yoffset + xoffset];
+                    float d2 = depthData[idx2 + yoffset + xoffset];
                     if(d2 < d)
                     {
                         return true;
@@ -302,14 +335,10 @@ public:
                     
                     // compute the average foreground and background posterior
                     // probablities from the given set of tclc-histograms
-                    int pIdx = (j+_roi.y) * fullWidth + i+_roi.x;
+                    uchar *frameRow = frameData + (j+_roi.y) * frameStep;
                     
                     // compute the histogram bin index from the pixel's color
-                    int ru = (frameData[3*pIdx] >> binShift);
-                    int gu = (frameData[3*pIdx+1] >> binShift);
-                    int bu = (frameData[3*pIdx+2] >> binShift);
-                    
-                    int binIdx = (ru * numBins + gu) * numBins + bu;
+                    int binIdx = layout.bin(frameRow, i+_roi.x, j+_roi.y, binShift, numBins);
                     
                     float pYFVal = 0;
                     float pYBVal = 0;
@@ -385,16 +414,13 @@ public:
                         zIdx = idx;
                     }
                     
-                    // get the depth buffer value for this pixel
-                    float depth = 1.0f - depthData[zIdx];
+                    // the Z-distance to the camera of this pixel
+                    D = depthData[zIdx];
                     
                     // check for occlusions in case of multiple objects
-                    if(maskAvailable && isOccluded(idx, dist, depth))
+                    if(maskAvailable && isOccluded(idx, dist, D))
                         continue;
                     
-                    // compute the Z-distance to the camera from the depth buffer value
-                    D = 2.0f * _zNear * _zFar / (_zFar + _zNear - (2.0f*depth - 1.0) * (_zFar - _zNear));
-                    
                     // back-project to camera coordinates
                     float X_c = D*(K_invData[0]*x+K_invData[2]);
                     float Y_c = D*(K_invData[4]*y+K_invData[5]);
@@ -435,10 +461,8 @@ public:
                         }
                     }
                     
-                    // do the same for the inverse depth buffer
-                    depth = 1.0f - depthInvData[zIdx];
-                    
-                    D = 2.0f * _zNear * _zFar / (_zFar + _zNear - (2.0f*depth - 1.0) * (_zFar - _zNear));
+                    // do the same for the inverse depth map
+                    D = depthInvData[zIdx];
                     
                     X_c = D*(K_invData[0]*x+K_invData[2]);
                     Y_c = D*(K_invData[4]*y+K_invData[5]);
@@ -0,0 +1,189 @@
+#ifndef PIXEL_LAYOUT_H
+#define PIXEL_LAYOUT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <opencv2/core.hpp>
+
+#include "frame_protocol.h"
+
+/**
+ *  The formats of the camera frames the tracker reads directly.
+ */
+enum FrameFormat
+{
+    // blue first, as produced by OpenCV (BGR, BGRA)
+    FRAME_FORMAT_BGR = 0,
+    
+    // red first (RGB, RGBA)
+    FRAME_FORMAT_RGB = 1,
+    
+    // packed 4:2:2 YUV, i.e. Y0 U Y1 V for every two pixels of a row (a 2 channel image)
+    FRAME_FORMAT_YUYV = 2,
+    
+    // a full resolution Y plane followed by an interleaved UV plane with half the resolution in both directions
+    FRAME_FORMAT_NV12 = 3
+};
+
+/**
+ *  Returns whether frames of a format are binned in YUV instead of BGR.
+ *
+ *  @param  format The format of the frames.
+ *  @return True for YUYV and NV12 and false otherwise.
+ */
+inline bool isYUV(FrameFormat format)
+{
+    return format == FRAME_FORMAT_YUYV || format == FRAME_FORMAT_NV12;
+}
+
+/**
+ *  Returns the format the frames of a PixelFormat of the streaming protocol
+ *  are read in.
+ *
+ *  @param  pixelFormat One of PixelFormat.
+ *  @return The corresponding format.
+ */
+inline FrameFormat frameFormat(uint32_t pixelFormat)
+{
+    switch(pixelFormat)
+    {
+        case PIXEL_FORMAT_RGBA:
+            return FRAME_FORMAT_RGB;
+        case PIXEL_FORMAT_NV12:
+            return FRAME_FORMAT_NV12;
+        case PIXEL_FORMAT_YUYV:
+            return FRAME_FORMAT_YUYV;
+        default:
+            return FRAME_FORMAT_BGR;
+    }
+}
+
+/**
+ *  Describes how the pixels of a camera frame are stored, such that the
+ *  pixel kernels can read the frames directly, without converting them
+ *  first. 3 and 4 channel frames are binned in BGR order regardless of their
+ *  channel order. YUV frames are binned in YUV, with every pixel using the
+ *  chroma of the pixels it has been subsampled with.
+ *
+ *  The coarser pyramid levels of YUV frames are 3 channel YUV images, so the
+ *  layout of a level is determined by both the format and the number of
+ *  channels of the image.
+ */
+struct PixelLayout
+{
+    /**
+     *  Constructor of the layout of a 3 channel BGR image.
+     */
+    PixelLayout()
+    {
+        packing = PACKED_3;
+        swapRB = false;
+        
+        chroma = NULL;
+        chromaStep = 0;
+    }
+    
+    /**
+     *  Constructor of the layout of a frame or pyramid level.
+     *
+     *  @param  frame The image, which is only the Y plane for NV12 frames, directly followed by the UV plane with the same stride.
+     *  @param  format The format of the frames.
+     */
+    PixelLayout(const cv::Mat &frame, FrameFormat format)
+    {
+        int channels = frame.channels();
+        
+        if(format == FRAME_FORMAT_NV12 && channels == 1)
+            packing = NV12;
+        else if(format == FRAME_FORMAT_YUYV && channels == 2)
+            packing = YUYV;
+        else
+            packing = (channels == 4) ? PACKED_4 : PACKED_3;
+        
+        swapRB = format == FRAME_FORMAT_RGB;
+        
+        chroma = (packing == NV12) ? frame.data + frame.rows*frame.step : NULL;
+        chromaStep = frame.step;
+    }
+    
+    /**
+     *  Computes the histogram bin index of a pixel. 4 channel pixels are read
+     *  with a single 32-bit load, which does not need the rows of the frame to
+     *  be aligned.
+     *
+     *  @param  row The first byte of the row of the pixel (of the Y plane for NV12 frames).
+     *  @param  x The column of the pixel.
+     *  @param  y The row of the pixel, only used for finding the chroma of NV12 frames.
+     *  @param  binShift The number of low bits dropped per channel, i.e. 8 - log2(numBins).
+     *  @param  numBins The number of bins per channel.
+     *  @return The bin index within [0, numBins^3).
+     */
+    inline int bin(const uchar *row, int x, int y, int binShift, int numBins) const
+    {
+        int c0, c1, c2;
+        switch(packing)
+        {
+            case PACKED_4:
+            {
+                // little endian, i.e. the first channel is the lowest byte
+                uint32_t value;
+                memcpy(&value, row + 4*x, 4);
+                c0 = value & 0xff;
+                c1 = (value >> 8) & 0xff;
+                c2 = (value >> 16) & 0xff;
+                break;
+            }
+            case YUYV:
+            {
+                // both pixels of a pair share U and V
+                const uchar *pair = row + 4*(x >> 1);
+                c0 = row[2*x];
+                c1 = pair[1];
+                c2 = pair[3];
+                break;
+            }
+            case NV12:
+            {
+                const uchar *uv = chroma + (y >> 1)*chromaStep + (x & ~1);
+                c0 = row[x];
+                c1 = uv[0];
+                c2 = uv[1];
+                break;
+            }
+            default:
+            {
+                const uchar *pixel = row + 3*x;
+                c0 = pixel[0];
+                c1 = pixel[1];
+                c2 = pixel[2];
+                break;
+            }
+        }
+        
+        if(swapRB)
+            std::swap(c0, c2);
+        
+        return ((c0 >> binShift)*numBins + (c1 >> binShift))*numBins + (c2 >> binShift);
+    }
+    
+    enum Packing
+    {
+        PACKED_3,
+        PACKED_4,
+        YUYV,
+        NV12
+    };
+    
+    Packing packing;
+    
+    bool swapRB;
+    
+    // the UV plane of NV12 frames
+    const uchar *chroma;
+    size_t chromaStep;
+};
+
+#endif /* PIXEL_LAYOUT_H */
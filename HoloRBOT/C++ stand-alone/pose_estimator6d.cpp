@@ -44,10 +44,9 @@ bool sortTemplateView(std::pair<float, TemplateView*> a, std::pair<float, Templa
 }
 
 
-PoseEstimator6D::PoseEstimator6D(int width, int height, float zNear, float zFar, const cv::Matx33f &K, const cv::Matx14f &distCoeffs, vector<Object3D*> &objects)
+PoseEstimator6D::PoseEstimator6D(int width, int height, float zNear, float zFar, const cv::Matx33f &K, const cv::Matx14f &distCoeffs, vector<Object3D*> &objects, RenderingEngine *sharedEngine)
 {
-    renderingEngine = RenderingEngine::Instance();
-    optimizationEngine = new OptimizationEngine(width, height);
+    renderingEngine = sharedEngine ? new RenderingEngine(sharedEngine) : new RenderingEngine();
     
     SDT2D = new SignedDistanceTransform2D(8.0f);
     
@@ -57,13 +56,38 @@ PoseEstimator6D::PoseEstimator6D(int width, int height, float zNear, float zFar,
     this->K = K;
     this->distCoeffs = distCoeffs;
     
+    frameK = K;
+    frameCrop = Rect(0, 0, width, height);
+    frameScaleShift = 0;
+    
+    frameFormat = FRAME_FORMAT_BGR;
+    
     initUndistortRectifyMap(K, distCoeffs, cv::noArray(), K, Size(width, height), CV_16SC2, map1, map2);
     
+    // the chroma samples of NV12 frames are centered between two pixels in both directions
+    Matx33f chromaK(K(0, 0)/2, 0, (K(0, 2) - 0.5f)/2, 0, K(1, 1)/2, (K(1, 2) - 0.5f)/2, 0, 0, 1);
+    initUndistortRectifyMap(chromaK, distCoeffs, cv::noArray(), chromaK, Size(width/2, height/2), CV_16SC2, chromaMap1, chromaMap2);
+    
+    // allocate the downsampled pyramid levels once, they are only rewritten per frame
+    imagePyramid.resize(4);
+    for(int l = 1; l < 4; l++)
+    {
+        imagePyramid[l].create(height/pow(2, l), width/pow(2, l), CV_8UC3);
+    }
+    
     initialized = false;
     
     //start initialization
     renderingEngine->init(K, width, height, zNear, zFar, 4);
     
+    // the optimization switches between pyramid levels and regions of interest independently
+    RenderingEngine *optimizationRenderingEngine = new RenderingEngine(renderingEngine);
+    optimizationRenderingEngine->init(K, width, height, zNear, zFar, 4);
+    optimizationEngine = new OptimizationEngine(width, height, optimizationRenderingEngine);
+    
+    RenderingEngine *templateRenderingEngine = new RenderingEngine(renderingEngine);
+    templateRenderingEngine->init(K, width, height, zNear, zFar, 4);
+    
     renderingEngine->makeCurrent();
     
     for(int i = 0; i < objects.size(); i++)
@@ -72,10 +96,12 @@ PoseEstimator6D::PoseEstimator6D(int width, int height, float zNear, float zFar,
         this->objects.push_back(objects[i]);
         this->objects[i]->initBuffers();
         cout << "Templates" << endl;
-        this->objects[i]->generateTemplates();
+        this->objects[i]->generateTemplates(templateRenderingEngine);
         this->objects[i]->reset();
     }
     
+    delete templateRenderingEngine;
+    
     cout << "After templates" << endl;
     
 //    renderingEngine->doneCurrent();
@@ -86,10 +112,11 @@ PoseEstimator6D::PoseEstimator6D(int width, int height, float zNear, float zFar,
 
 PoseEstimator6D::~PoseEstimator6D()
 {
-    renderingEngine->destroy();
-    
+    // the engine of the optimization renders with the context of this one
     delete optimizationEngine;
     
+    delete renderingEngine;
+    
     delete SDT2D;
 }
 
@@ -99,8 +126,7 @@ void PoseEstimator6D::toggleTracking(cv::Mat &frame, int objectIndex, bool undis
     if(objectIndex >= objects.size())
         return;
     
-    if(undistortFrame)
-        remap(frame, frame, map1, map2, INTER_LINEAR);
+    Mat image = firstLevel(frame, undistortFrame);
     
     if(!objects[objectIndex]->isInitialized())
     {
@@ -111,12 +137,9 @@ void PoseEstimator6D::toggleTracking(cv::Mat &frame, int objectIndex, bool undis
         renderingEngine->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), GL_FILL);
         
         Mat mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
-        Mat depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
-        
-        float zNear = renderingEngine->getZNear();
-        float zFar = renderingEngine->getZFar();
+        Mat depth = renderingEngine->downloadFrame(RenderingEngine::LINEAR_DEPTH);
         
-        objects[objectIndex]->getTCLCHistograms()->update(frame, mask, depth, K, zNear, zFar);
+        objects[objectIndex]->getTCLCHistograms()->update(image, mask, depth, frameK, frameFormat);
         
         initialized = true;
     }
@@ -135,18 +158,27 @@ void PoseEstimator6D::toggleTracking(cv::Mat &frame, int objectIndex, bool undis
 
 void PoseEstimator6D::estimatePoses(cv::Mat &frame, bool undistortFrame, bool checkForLoss)
 {
-    if(undistortFrame)
-        remap(frame, frame, map1, map2, INTER_LINEAR);
-
-    vector<Mat> imagePyramid;
+    Mat image = firstLevel(frame, undistortFrame);
     
-    Mat frameCpy = frame.clone();
-    imagePyramid.push_back(frameCpy);
+    // the frame itself is the first level, resize only reallocates the other levels if the frame size changes
+    imagePyramid[0] = image;
     
-    for(int l = 1; l < 4; l++)
+    if(isYUV(frameFormat))
     {
-        resize(frame, frameCpy, Size(frame.cols/pow(2, l), frame.rows/pow(2, l)));
-        imagePyramid.push_back(frameCpy);
+        // the other levels are 3 channel YUV images, only the second one is built from the subsampled frame
+        parallel_for_(cv::Range(0, 8), Parallel_For_downsampleYUV(image, frameFormat, imagePyramid[1], 8));
+        
+        for(int l = 2; l < 4; l++)
+        {
+            resize(imagePyramid[1], imagePyramid[l], Size(image.cols/pow(2, l), image.rows/pow(2, l)));
+        }
+    }
+    else
+    {
+        for(int l = 1; l < 4; l++)
+        {
+            resize(image, imagePyramid[l], Size(image.cols/pow(2, l), image.rows/pow(2, l)));
+        }
     }
     
     if(initialized)
@@ -158,13 +190,10 @@ void PoseEstimator6D::estimatePoses(cv::Mat &frame, bool undistortFrame, bool ch
         renderingEngine->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), GL_FILL);
         
         Mat mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
-        Mat depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
-        
-        float zNear = renderingEngine->getZNear();
-        float zFar = renderingEngine->getZFar();
+        Mat depth = renderingEngine->downloadFrame(RenderingEngine::LINEAR_DEPTH);
         
         Mat binned;
-        parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(frame, binned, objects[0]->getTCLCHistograms()->getNumBins(), 8));
+        parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(image, binned, objects[0]->getTCLCHistograms()->getNumBins(), 8, frameFormat));
         
         for(int i = 0; i < objects.size(); i++)
         {
@@ -173,6 +202,7 @@ void PoseEstimator6D::estimatePoses(cv::Mat &frame, bool undistortFrame, bool ch
                 if(!objects[i]->isTrackingLost())
                 {
                     float e = evaluateEnergyFunction(objects[i], mask, depth, binned, 0, 8);
+                    objects[i]->setEnergy(e);
                     
                     if(checkForLoss && (e > objects[i]->getQualityThreshold() || e == 0.0f))
                     {
@@ -181,19 +211,20 @@ void PoseEstimator6D::estimatePoses(cv::Mat &frame, bool undistortFrame, bool ch
                     }
                     else
                     {
-                        objects[i]->getTCLCHistograms()->update(frame, mask, depth, K, zNear, zFar);
+                        objects[i]->getTCLCHistograms()->update(image, mask, depth, frameK, frameFormat);
                     }
                 }
-                else
+                else if(isFullFrame() && frameScaleShift <= 2)
                 {
-                    relocalize(objects[i], imagePyramid);
+                    // the templates were created for the full image, a downscaled frame provides the coarser pyramid levels
+                    relocalize(objects[i], imagePyramid, frameScaleShift);
                 }
             }
         }
     }
 }
 
-void PoseEstimator6D::relocalize(Object3D *object, vector<Mat> &imagePyramid)
+void PoseEstimator6D::relocalize(Object3D *object, vector<Mat> &imagePyramid, int levelShift)
 {
     vector<TemplateView*> templateViews = object->getTemplateViews();
     
@@ -203,7 +234,7 @@ void PoseEstimator6D::relocalize(Object3D *object, vector<Mat> &imagePyramid)
     
     // PREPARE FRAME FOR LOWEST LEVEL
     Mat binned;
-    parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(imagePyramid[level], binned, object->getTCLCHistograms()->getNumBins(), 8));
+    parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(imagePyramid[level - levelShift], binned, object->getTCLCHistograms()->getNumBins(), 8, frameFormat));
     
     Mat prMap;
     parallel_for_(cv::Range(0, 8), Parallel_For_createPosteriorResponseMap(object->getTCLCHistograms(), binned, prMap, 8));
@@ -242,7 +273,7 @@ void PoseEstimator6D::relocalize(Object3D *object, vector<Mat> &imagePyramid)
     level = 2;
     
     // PREPARE FRAME FOR 2ND LOWEST LEVEL
-    parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(imagePyramid[level], binned, object->getTCLCHistograms()->getNumBins(), 8));
+    parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(imagePyramid[level - levelShift], binned, object->getTCLCHistograms()->getNumBins(), 8, frameFormat));
     
     vector<pair<float, TemplateView*> > errorKVMap;
     
@@ -269,7 +300,7 @@ void PoseEstimator6D::relocalize(Object3D *object, vector<Mat> &imagePyramid)
     
     sort(errorKVMap.begin(), errorKVMap.end(), sortTemplateView);
     
-    parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(imagePyramid[0], binned, object->getTCLCHistograms()->getNumBins(), 8));
+    parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(imagePyramid[0], binned, object->getTCLCHistograms()->getNumBins(), 8, frameFormat));
     
     float minE = FLT_MAX;
     int finalIdx = -1;
@@ -290,7 +321,8 @@ void PoseEstimator6D::relocalize(Object3D *object, vector<Mat> &imagePyramid)
         {
             Rect roi = templateView->getROI(level);
             
-            Vec3f offsetVec((-roi.x+offsetX)*pow(2, level)+imagePyramid[0].cols/2, (-roi.y+offsetY)*pow(2, level)+imagePyramid[0].rows/2, 1);
+            // the template offsets refer to the full resolution image
+            Vec3f offsetVec((-roi.x+offsetX)*pow(2, level)+width/2, (-roi.y+offsetY)*pow(2, level)+height/2, 1);
             
             Matx44f pose = templateView->getPose();
             
@@ -304,12 +336,9 @@ void PoseEstimator6D::relocalize(Object3D *object, vector<Mat> &imagePyramid)
             renderingEngine->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), GL_FILL);
             
             Mat mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
-            Mat depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
-            
-            float zNear = renderingEngine->getZNear();
-            float zFar = renderingEngine->getZFar();
+            Mat depth = renderingEngine->downloadFrame(RenderingEngine::LINEAR_DEPTH);
             
-            object->getTCLCHistograms()->updateCentersAndIds(mask, depth, K, zNear, zFar, 0);
+            object->getTCLCHistograms()->updateCentersAndIds(mask, depth, frameK, 0);
             
             vector<Object3D*> tmp;
             tmp.push_back(object);
@@ -340,12 +369,9 @@ void PoseEstimator6D::relocalize(Object3D *object, vector<Mat> &imagePyramid)
         renderingEngine->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), GL_FILL);
         
         Mat mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
-        Mat depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
+        Mat depth = renderingEngine->downloadFrame(RenderingEngine::LINEAR_DEPTH);
         
-        float zNear = renderingEngine->getZNear();
-        float zFar = renderingEngine->getZFar();
-        
-        object->getTCLCHistograms()->updateCentersAndIds(mask, depth, K, zNear, zFar, 0);
+        object->getTCLCHistograms()->updateCentersAndIds(mask, depth, frameK, 0);
         
     }
     else
@@ -355,6 +381,135 @@ void PoseEstimator6D::relocalize(Object3D *object, vector<Mat> &imagePyramid)
 }
 
 
+bool PoseEstimator6D::setFrameGeometry(const cv::Rect &crop, int scaleShift)
+{
+    if(crop == frameCrop && scaleShift == frameScaleShift)
+        return true;
+    
+    if(crop.x < 0 || crop.y < 0 || crop.width <= 0 || crop.height <= 0 || crop.x + crop.width > width || crop.y + crop.height > height || scaleShift < 0 || scaleShift > 3)
+        return false;
+    
+    float s = pow(2, scaleShift);
+    
+    frameK = Matx33f(K(0, 0)/s, 0, (K(0, 2) - crop.x)/s,
+                     0, K(1, 1)/s, (K(1, 2) - crop.y)/s,
+                     0, 0, 1);
+    frameCrop = crop;
+    frameScaleShift = scaleShift;
+    
+    int frameWidth = crop.width/s;
+    int frameHeight = crop.height/s;
+    
+    renderingEngine->setCalibration(frameK, frameWidth, frameHeight);
+    optimizationEngine->setCalibration(frameK, frameWidth, frameHeight);
+    
+    return true;
+}
+
+
+void PoseEstimator6D::setFrameFormat(FrameFormat format)
+{
+    // the histograms of tracked objects are meaningless in the other color space
+    if(isYUV(format) != isYUV(frameFormat) && initialized)
+        reset();
+    
+    frameFormat = format;
+    optimizationEngine->setFrameFormat(format);
+}
+
+
+FrameFormat PoseEstimator6D::getFrameFormat()
+{
+    return frameFormat;
+}
+
+
+Mat PoseEstimator6D::firstLevel(Mat &frame, bool undistortFrame)
+{
+    // NV12 frames are passed as a whole, i.e. with the UV plane as additional rows below the Y plane
+    Mat image = (frameFormat == FRAME_FORMAT_NV12) ? frame.rowRange(0, frame.rows*2/3) : frame;
+    
+    // the rectification maps are only valid for the uncropped full resolution image, YUYV frames are
+    // not undistorted at all, since both pixels of a pair share their chroma and cannot be moved individually
+    if(!undistortFrame || !isFullFrame() || frameScaleShift != 0 || frameFormat == FRAME_FORMAT_YUYV)
+        return image;
+    
+    if(frameFormat == FRAME_FORMAT_NV12)
+    {
+        Mat chroma(image.rows/2, image.cols/2, CV_8UC2, image.data + image.rows*image.step, image.step);
+        remap(image, image, map1, map2, INTER_LINEAR);
+        remap(chroma, chroma, chromaMap1, chromaMap2, INTER_LINEAR);
+    }
+    else
+    {
+        remap(image, image, map1, map2, INTER_LINEAR);
+    }
+    
+    return image;
+}
+
+
+bool PoseEstimator6D::isFullFrame()
+{
+    return frameCrop == Rect(0, 0, width, height);
+}
+
+
+cv::Matx33f PoseEstimator6D::getFrameCalibration()
+{
+    return frameK;
+}
+
+
+cv::Rect PoseEstimator6D::predictCrop(int margin, int alignment)
+{
+    renderingEngine->setLevel(0);
+    
+    float s = pow(2, frameScaleShift);
+    
+    Rect region;
+    for(int i = 0; i < objects.size(); i++)
+    {
+        if(!objects[i]->isInitialized())
+            continue;
+        
+        if(objects[i]->isTrackingLost())
+            return Rect();
+        
+        // project into the current frame and map back to the full resolution image
+        Rect boundingRect;
+        vector<Point2f> projections;
+        renderingEngine->projectBoundingBox(objects[i], projections, boundingRect);
+        
+        Rect fullRect(boundingRect.x*s + frameCrop.x, boundingRect.y*s + frameCrop.y, boundingRect.width*s, boundingRect.height*s);
+        
+        region = (region.area() == 0) ? fullRect : (region | fullRect);
+    }
+    
+    if(region.area() == 0)
+        return Rect();
+    
+    int minX = region.x - margin;
+    int minY = region.y - margin;
+    int maxX = region.x + region.width + margin;
+    int maxY = region.y + region.height + margin;
+    
+    // align outwards
+    minX = (max(minX, 0)/alignment)*alignment;
+    minY = (max(minY, 0)/alignment)*alignment;
+    maxX = ((maxX + alignment - 1)/alignment)*alignment;
+    maxY = ((maxY + alignment - 1)/alignment)*alignment;
+    
+    if(maxX > width) maxX = width;
+    if(maxY > height) maxY = height;
+    
+    if(minX >= maxX || minY >= maxY)
+        return Rect();
+    
+    return Rect(minX, minY, maxX - minX, maxY - minY);
+}
+
+
 cv::Rect PoseEstimator6D::computeBoundingBox(const std::vector<cv::Point3i> &centersIDs, int offset, int level, const cv::Size& maxSize)
 {
     int minX = INT_MAX, minY = INT_MAX;
@@ -392,7 +547,7 @@ float PoseEstimator6D::evaluateEnergyFunction(Object3D *object, const Mat &binne
     renderingEngine->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), GL_FILL);
     
     Mat mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
-    Mat depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
+    Mat depth = renderingEngine->downloadFrame(RenderingEngine::LINEAR_DEPTH);
     
     return evaluateEnergyFunction(object, mask, depth, binned, level, 8);
 }
@@ -400,11 +555,8 @@ float PoseEstimator6D::evaluateEnergyFunction(Object3D *object, const Mat &binne
 
 float PoseEstimator6D::evaluateEnergyFunction(Object3D *object, const Mat &mask, const Mat &depth, const Mat &binned, int level, int threads)
 {
-    float zNear = renderingEngine->getZNear();
-    float zFar = renderingEngine->getZFar();
-    
     TCLCHistograms *tclcHistograms = object->getTCLCHistograms();
-    tclcHistograms->updateCentersAndIds(mask, depth, K, zNear, zFar, 0);
+    tclcHistograms->updateCentersAndIds(mask, depth, frameK, 0);
     
     vector<Point3i> centersIDs = tclcHistograms->getCentersAndIDs();
     
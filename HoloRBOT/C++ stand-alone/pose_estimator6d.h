@@ -65,6 +65,11 @@ public:
      *  and distortion coefficients (as needed by OpenCV).
      *  It also initializes the OpenGL rendering buffers for all
      *  provided 3D objects using the OpenGL context of the engine.
+     *  The pose estimator, its optimization engine and the template
+     *  generation each render with a rendering engine of their own,
+     *  all of them on the same OpenGL context. That context is either
+     *  created by the pose estimator or the one of a given engine,
+     *  e.g. one created on the main thread for a worker thread.
      *
      *  @param  width The width in pixels of the camera frame at full resolution.
      *  @param  height The height in pixels of the camera frame at full resolution.
@@ -73,8 +78,9 @@ public:
      *  @param  K The intrinsic camera matrix.
      *  @param  distCoeffs The cameras lens distortion coefficients.
      *  @param  objects A collection of all 3D objects to be tracked.
+     *  @param  sharedEngine The engine whose OpenGL context is used, it must outlive the pose estimator (default = NULL, i.e. a context of its own).
      */
-    PoseEstimator6D(int width, int height, float zNear, float zFar, const cv::Matx33f &K, const cv::Matx14f &distCoeffs, std::vector<Object3D*> &objects);
+    PoseEstimator6D(int width, int height, float zNear, float zFar, const cv::Matx33f &K, const cv::Matx14f &distCoeffs, std::vector<Object3D*> &objects, RenderingEngine *sharedEngine = NULL);
     
     ~PoseEstimator6D();
     
@@ -85,7 +91,7 @@ public:
      *  initialized this method will reset/stop tracking for it
      *  instead.
      *
-     *  @param  frame The current camera frame  (RGB, uchar).
+     *  @param  frame The current camera frame in the format set by setFrameFormat (uchar).
      *  @param  objectIndex The index of the object to be initialized.
      *  @param  undistortFrame A flag indicating whether the image should first be undistorted for initialization (default = true).
      */
@@ -103,12 +109,80 @@ public:
      *  new estimated poses which can be obtained by calling getPose()
      *  on each object afterwards.
      *
-     *  @param frame  The current camera frame (RGB, uchar).
+     *  The frame is used directly as the first level of the image pyramid
+     *  without being copied, so it must stay unchanged during the call.
+     *
+     *  @param frame  The current camera frame in the format set by setFrameFormat (uchar).
      *  @param undistortFrame A flag indicating whether the image should first be undistorted for initialization (default = true).
      *  @param undistortFrame A flag indicating whether it should be checked for a tracking loss after pose estimation (default = true).
      */
     void estimatePoses(cv::Mat &frame, bool undistortFrame = true, bool checkForLoss = true);
     
+    /**
+     *  Describes which part of the full resolution camera image the following
+     *  frames show, such that the tracker can work directly on partial and
+     *  downscaled frames. The intrinsics used for rendering and optimization
+     *  are adjusted accordingly, i.e. the principal point is shifted by the
+     *  crop offset and all parameters are scaled by 1/2^scaleShift. Nothing
+     *  is recomputed if the geometry did not change.
+     *  Undistortion is only supported for uncropped frames at full resolution
+     *  and relocalization after a tracking loss only for uncropped frames.
+     *
+     *  @param  crop The region of the full resolution image covered by the frames (in full resolution pixels).
+     *  @param  scaleShift The frames are downscaled by a factor of 2^scaleShift with respect to the crop.
+     *  @return False if the crop does not lie within the full resolution image and true otherwise.
+     */
+    bool setFrameGeometry(const cv::Rect &crop, int scaleShift);
+    
+    /**
+     *  Returns whether the frames currently cover the whole camera image,
+     *  regardless of their scale.
+     *
+     *  @return True if the frames are not cropped and false otherwise.
+     */
+    bool isFullFrame();
+    
+    /**
+     *  Returns the intrinsics of the current frames, i.e. those of the full
+     *  resolution camera image adjusted to the frame geometry.
+     *
+     *  @return The intrinsic camera matrix of the current frames.
+     */
+    cv::Matx33f getFrameCalibration();
+    
+    /**
+     *  Sets the format of the following frames, which are all processed
+     *  directly without converting them beforehand. BGR and RGB frames have
+     *  3 or 4 channels, YUYV frames 2 channels and NV12 frames are single
+     *  channel images of 3/2 times the height, with the UV plane below the Y
+     *  plane. The histograms are built in YUV for YUV frames, so tracking is
+     *  reset when switching between YUV and the other formats.
+     *
+     *  @param  format The format of the frames.
+     */
+    void setFrameFormat(FrameFormat format);
+    
+    /**
+     *  Returns the format of the current frames.
+     *
+     *  @return  The format set by setFrameFormat.
+     */
+    FrameFormat getFrameFormat();
+    
+    /**
+     *  Predicts the region of the full resolution camera image the next frame
+     *  has to cover for tracking all objects, based on the projected bounding
+     *  boxes of the objects wrt their current poses. The region is extended by
+     *  a margin accounting for the motion until the next frame and aligned
+     *  to a multiple of the given number of pixels, such that all pyramid
+     *  levels of the cropped frame have integer sizes.
+     *
+     *  @param  margin The number of pixels the region is extended by on each side at full resolution.
+     *  @param  alignment The offset and size of the region are multiples of this value (default = 32).
+     *  @return The predicted region or an empty rect if the whole image is required, i.e. if no object is tracked or tracking was lost for an object.
+     */
+    cv::Rect predictCrop(int margin, int alignment = 32);
+    
     /**
      *  Resets/stops pose tracking for all objects by clearing the
      *  respective sets of tclc-histograms.
@@ -125,6 +199,17 @@ private:
     cv::Mat map1;
     cv::Mat map2;
     
+    // the rectification maps of the UV plane of NV12 frames
+    cv::Mat chromaMap1;
+    cv::Mat chromaMap2;
+    
+    // the intrinsics and the region of the full image covered by the current frames
+    cv::Matx33f frameK;
+    cv::Rect frameCrop;
+    int frameScaleShift;
+    
+    FrameFormat frameFormat;
+    
     std::vector<Object3D*> objects;
     
     RenderingEngine *renderingEngine;
@@ -134,11 +219,23 @@ private:
     
     cv::Mat lastFrame;
     
+    // preallocated buffers of the image pyramid, level 0 refers to the current frame
+    std::vector<cv::Mat> imagePyramid;
+    
     bool initialized;
     
     int tmp;
     
-    void relocalize(Object3D *object, std::vector<cv::Mat> &imagePyramid);
+    /**
+     *  Undistorts a frame if requested and possible for its format.
+     *
+     *  @param  frame The current camera frame.
+     *  @param  undistortFrame A flag indicating whether the frame should be undistorted.
+     *  @return The first level of the image pyramid, i.e. the frame itself or the Y plane of NV12 frames.
+     */
+    cv::Mat firstLevel(cv::Mat &frame, bool undistortFrame);
+    
+    void relocalize(Object3D *object, std::vector<cv::Mat> &imagePyramid, int levelShift);
     
     cv::Rect computeBoundingBox(const std::vector<cv::Point3i> &centersIDs, int offset, int level, const cv::Size &maxSize);
     
@@ -309,7 +406,82 @@ public:
 
 /**
  *  This class extends the OpenCV ParallelLoopBody for efficiently parallelized
- *  computations. Within the corresponding for loop, the RGB values per pixel
+ *  computations. Within the corresponding for loop, a YUYV or NV12 frame is
+ *  downsampled to a 3 channel YUV image of half its size. Every pixel of the
+ *  result covers exactly one chroma sample of the frame, so only the Y values
+ *  (and the two rows of YUYV chroma) are averaged.
+ */
+class Parallel_For_downsampleYUV: public cv::ParallelLoopBody
+{
+private:
+    cv::Mat _frame;
+    cv::Mat _downsampled;
+    
+    PixelLayout _layout;
+    
+    int _threads;
+    
+public:
+    Parallel_For_downsampleYUV(const cv::Mat &frame, FrameFormat format, cv::Mat &downsampled, int threads)
+    {
+        _frame = frame;
+        
+        _layout = PixelLayout(frame, format);
+        
+        downsampled.create(frame.rows/2, frame.cols/2, CV_8UC3);
+        _downsampled = downsampled;
+        
+        _threads = threads;
+    }
+    
+    virtual void operator()( const cv::Range &r ) const
+    {
+        int range = _downsampled.rows/_threads;
+        
+        int yEnd = r.end*range;
+        if(r.end == _threads)
+        {
+            yEnd = _downsampled.rows;
+        }
+        
+        for(int y = r.start*range; y < yEnd; y++)
+        {
+            const uchar *row0 = _frame.data + 2*y*_frame.step;
+            const uchar *row1 = row0 + _frame.step;
+            
+            uchar *dst = _downsampled.data + y*_downsampled.step;
+            
+            if(_layout.packing == PixelLayout::NV12)
+            {
+                const uchar *uv = _layout.chroma + y*_layout.chromaStep;
+                
+                for(int x = 0; x < _downsampled.cols; x++, dst+=3)
+                {
+                    dst[0] = (row0[2*x] + row0[2*x+1] + row1[2*x] + row1[2*x+1] + 2) >> 2;
+                    dst[1] = uv[2*x];
+                    dst[2] = uv[2*x+1];
+                }
+            }
+            else
+            {
+                // one pixel per pair Y0 U Y1 V
+                for(int x = 0; x < _downsampled.cols; x++, dst+=3)
+                {
+                    const uchar *pair0 = row0 + 4*x;
+                    const uchar *pair1 = row1 + 4*x;
+                    
+                    dst[0] = (pair0[0] + pair0[2] + pair1[0] + pair1[2] + 2) >> 2;
+                    dst[1] = (pair0[1] + pair1[1] + 1) >> 1;
+                    dst[2] = (pair0[3] + pair1[3] + 1) >> 1;
+                }
+            }
+        }
+    }
+};
+
+/**
+ *  This class extends the OpenCV ParallelLoopBody for efficiently parallelized
+ *  computations. Within the corresponding for loop, the color values per pixel
  *  of a color input image are converted to their corresponding histogram bin
  *  index.
  */
@@ -322,6 +494,8 @@ private:
     uchar *frameData;
     int *binnedData;
     
+    PixelLayout _layout;
+    
     int _numBins;
     
     int _binShift;
@@ -329,10 +503,12 @@ private:
     int _threads;
     
 public:
-    Parallel_For_convertToBins(const cv::Mat &frame, cv::Mat &binned, int numBins, int threads)
+    Parallel_For_convertToBins(const cv::Mat &frame, cv::Mat &binned, int numBins, int threads, FrameFormat format = FRAME_FORMAT_BGR)
     {
         _frame = frame;
         
+        _layout = PixelLayout(frame, format);
+        
         binned.create(_frame.rows, _frame.cols, CV_32SC1);
         _binned = binned;
         
@@ -358,19 +534,12 @@ public:
         
         for(int y = r.start*range; y < yEnd; y++)
         {
-            uchar *frameRow = frameData + y*_frame.cols*3;
+            uchar *frameRow = frameData + y*_frame.step;
             int *binnedRow = binnedData + y*_binned.cols;
             
-            int idx = 0;
-            for(int x = 0; x < _frame.cols; x++, idx+=3)
+            for(int x = 0; x < _frame.cols; x++)
             {
-                int ru = (frameRow[idx] >> _binShift);
-                int gu = (frameRow[idx + 1] >> _binShift);
-                int bu = (frameRow[idx + 2] >> _binShift);
-                
-                int binIdx = (ru * _numBins + gu) * _numBins + bu;
-                
-                binnedRow[x] = binIdx;
+                binnedRow[x] = _layout.bin(frameRow, x, y, _binShift, _numBins);
             }
         }
     }
@@ -0,0 +1,249 @@
+/**
+ *  Benchmark of the SoftwareRasterizer against the RenderingEngine: renders
+ *  the configured models in random poses at every pyramid level with both,
+ *  reports the time per rendering including getting the mask, the depth
+ *  buffer and the linear depth map onto the CPU, and how much the results
+ *  of both differ. Afterwards the software rasterizer is run by a number of
+ *  threads at once, each with its own instance, like the template generation
+ *  or several tracking sessions would do, which the single OpenGL context
+ *  of the rendering engine cannot.
+ *
+ *  usage: rasterizer_benchmark [--renders n] [--threads n] [options of the tracking server]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "object3d.h"
+#include "rendering_engine.h"
+#include "software_rasterizer.h"
+#include "tracking_config.h"
+
+using namespace std;
+using namespace cv;
+
+static int64_t now()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the rendered images of one rendering
+struct Rendering
+{
+    Mat mask;
+    Mat depth;
+    Mat linearDepth;
+};
+
+// the differences accumulated over all renderings of a level
+struct Differences
+{
+    Differences()
+    {
+        numPixels = 0;
+        numMaskPixels = 0;
+        maxDepth = 0;
+        maxLinearDepth = 0;
+    }
+    
+    int64_t numPixels;
+    int64_t numMaskPixels;
+    
+    // in steps of the 24 bit depth buffer
+    double maxDepth;
+    
+    // relative to the linear depth
+    double maxLinearDepth;
+};
+
+static void setPoses(vector<Object3D*> &objects, const vector<Matx44f> &poses)
+{
+    for(int i = 0; i < objects.size(); i++)
+    {
+        objects[i]->setPose(poses[i]);
+    }
+}
+
+static void compareRenderings(const Rendering &a, const Rendering &b, Differences &differences)
+{
+    Mat maskDifference;
+    compare(a.mask, b.mask, maskDifference, CMP_NE);
+    differences.numPixels += a.mask.total();
+    differences.numMaskPixels += countNonZero(maskDifference);
+    
+    for(int y = 0; y < a.mask.rows; y++)
+    {
+        for(int x = 0; x < a.mask.cols; x++)
+        {
+            // the depths are only compared where both have rendered the same model
+            uchar id = a.mask.at<uchar>(y, x);
+            if(id == 0 || id != b.mask.at<uchar>(y, x))
+                continue;
+            
+            double depth = fabs(a.depth.at<float>(y, x) - b.depth.at<float>(y, x))*16777215.0;
+            double linearDepth = fabs(a.linearDepth.at<float>(y, x) - b.linearDepth.at<float>(y, x))/a.linearDepth.at<float>(y, x);
+            differences.maxDepth = max(differences.maxDepth, depth);
+            differences.maxLinearDepth = max(differences.maxLinearDepth, linearDepth);
+        }
+    }
+}
+
+static void renderConcurrently(const TrackingConfig &config, vector<Object3D*> *objects, int renders, int64_t *time)
+{
+    SoftwareRasterizer rasterizer;
+    rasterizer.init(config.K, config.width, config.height, config.zNear, config.zFar, 4);
+    
+    int64_t start = now();
+    for(int r = 0; r < renders; r++)
+    {
+        rasterizer.renderSilhouette(vector<Model*>(objects->begin(), objects->end()));
+        rasterizer.downloadFrame(RenderingEngine::MASK);
+        rasterizer.downloadFrame(RenderingEngine::LINEAR_DEPTH);
+    }
+    *time = now() - start;
+}
+
+
+int main(int argc, char *argv[])
+{
+    int numRenders = 100;
+    int numThreads = (int)max(thread::hardware_concurrency(), 1u);
+    
+    // the remaining arguments are options of the tracking server
+    vector<char*> options;
+    options.push_back(argv[0]);
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--renders") == 0 && i + 1 < argc)
+            numRenders = max(atoi(argv[++i]), 1);
+        else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            numThreads = max(atoi(argv[++i]), 1);
+        else
+            options.push_back(argv[i]);
+    }
+    
+    TrackingConfig config;
+    if(!config.parse((int)options.size(), options.data()))
+    {
+        cout << "usage: rasterizer_benchmark [--renders n] [--threads n] [options of the tracking server]" << endl;
+        return 1;
+    }
+    
+    RenderingEngine *renderingEngine = new RenderingEngine();
+    if(!renderingEngine->isValid())
+    {
+        delete renderingEngine;
+        return 1;
+    }
+    renderingEngine->setHalfFloatDepth(config.halfFloatDepth);
+    renderingEngine->init(config.K, config.width, config.height, config.zNear, config.zFar, 4);
+    renderingEngine->makeCurrent();
+    
+    SoftwareRasterizer rasterizer;
+    rasterizer.init(config.K, config.width, config.height, config.zNear, config.zFar, 4);
+    
+    vector<Object3D*> objects;
+    for(int i = 0; i < config.objects.size(); i++)
+    {
+        ObjectConfig &o = config.objects[i];
+        Object3D *object = new Object3D(o.filename, o.tx, o.ty, o.tz, o.alpha, o.beta, o.gamma, o.scale, o.qualityThreshold, config.templateDistances);
+        object->setModelID(i + 1);
+        object->initBuffers();
+        object->initialize();
+        objects.push_back(object);
+    }
+    vector<Model*> models(objects.begin(), objects.end());
+    
+    // random orientations at the configured positions, so the models overlap like during tracking
+    RNG rng(0);
+    vector<vector<Matx44f> > poses(numRenders);
+    for(int r = 0; r < numRenders; r++)
+    {
+        for(int i = 0; i < config.objects.size(); i++)
+        {
+            ObjectConfig &o = config.objects[i];
+            Matx44f pose = Transformations::translationMatrix(o.tx, o.ty, o.tz)
+            *Transformations::rotationMatrix(rng.uniform(0.0f, 360.0f), Vec3f(1, 0, 0))
+            *Transformations::rotationMatrix(rng.uniform(0.0f, 360.0f), Vec3f(0, 1, 0))
+            *Transformations::rotationMatrix(rng.uniform(0.0f, 360.0f), Vec3f(0, 0, 1));
+            poses[r].push_back(pose);
+        }
+    }
+    
+    for(int level = 0; level < renderingEngine->getNumLevels(); level++)
+    {
+        renderingEngine->setLevel(level);
+        rasterizer.setLevel(level);
+        
+        int64_t timeGL = 0;
+        int64_t timeCPU = 0;
+        Differences differences;
+        
+        for(int r = 0; r < numRenders; r++)
+        {
+            setPoses(objects, poses[r]);
+            
+            Rendering gl;
+            int64_t start = now();
+            renderingEngine->renderSilhouette(models, GL_FILL);
+            gl.mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
+            gl.depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
+            gl.linearDepth = renderingEngine->downloadFrame(RenderingEngine::LINEAR_DEPTH);
+            timeGL += now() - start;
+            
+            Rendering cpu;
+            start = now();
+            rasterizer.renderSilhouette(models);
+            cpu.mask = rasterizer.downloadFrame(RenderingEngine::MASK);
+            cpu.depth = rasterizer.downloadFrame(RenderingEngine::DEPTH);
+            cpu.linearDepth = rasterizer.downloadFrame(RenderingEngine::LINEAR_DEPTH);
+            timeCPU += now() - start;
+            
+            compareRenderings(gl, cpu, differences);
+        }
+        
+        Rect roi = rasterizer.getROI();
+        cout << "level " << level << " (" << roi.width << "x" << roi.height << "): "
+             << "OpenGL " << timeGL/1000.0/numRenders << " ms, "
+             << "software " << timeCPU/1000.0/numRenders << " ms per rendering" << endl;
+        cout << "  differing mask pixels: " << differences.numMaskPixels << " (" << 100.0*differences.numMaskPixels/differences.numPixels << "%), "
+             << "max depth difference: " << differences.maxDepth << " steps, "
+             << "max linear depth difference: " << 100.0*differences.maxLinearDepth << "%" << endl;
+    }
+    
+    // every thread renders the last poses with its own rasterizer at full resolution
+    vector<int64_t> times(numThreads);
+    vector<thread> threads;
+    int64_t start = now();
+    for(int t = 0; t < numThreads; t++)
+    {
+        threads.push_back(thread(renderConcurrently, cref(config), &objects, numRenders, &times[t]));
+    }
+    for(int t = 0; t < numThreads; t++)
+    {
+        threads[t].join();
+    }
+    double seconds = (now() - start)/1e6;
+    
+    cout << numThreads << " threads: " << numThreads*numRenders/seconds << " renderings/s, "
+         << *max_element(times.begin(), times.end())/1000.0/numRenders << " ms per rendering and thread" << endl;
+    
+    for(int i = 0; i < objects.size(); i++)
+    {
+        delete objects[i];
+    }
+    objects.clear();
+    
+    delete renderingEngine;
+    RenderingEngine::terminate();
+    
+    return 0;
+}
@@ -0,0 +1,339 @@
+#include "rbot_tracker.h"
+
+#include <iostream>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "tracking_config.h"
+#include "frame_protocol.h"
+#include "object3d.h"
+#include "pose_estimator6d.h"
+#include "rendering_engine.h"
+#include "motion_model.h"
+
+using namespace std;
+using namespace cv;
+
+struct RBOTTracker
+{
+    TrackingConfig config;
+    
+    RenderingEngine *renderingEngine;
+    
+    vector<Object3D*> objects;
+    
+    PoseEstimator6D *poseEstimator;
+    
+    vector<MotionModel> motionModels;
+    
+    // start, stop and reset are applied with the next frame
+    vector<CommandMessage> pendingCommands;
+};
+
+
+/**
+ *  Makes the OpenGL context of the tracker's rendering engine current on the
+ *  calling thread for the lifetime of the scope.
+ */
+class ContextScope
+{
+public:
+    ContextScope(RBOTTracker *tracker)
+    {
+        tracker->renderingEngine->makeCurrent();
+        this->tracker = tracker;
+    }
+    
+    ~ContextScope()
+    {
+        // the engine is deleted when the tracker is destroyed
+        if(tracker->renderingEngine)
+            tracker->renderingEngine->doneCurrent();
+    }
+
+private:
+    RBOTTracker *tracker;
+};
+
+
+static bool initialize(RBOTTracker *tracker)
+{
+    TrackingConfig &config = tracker->config;
+    if(config.objects.empty())
+    {
+        cout << "rbot: no models have been added" << endl;
+        return false;
+    }
+    
+    for(int i = 0; i < config.objects.size(); i++)
+    {
+        ObjectConfig &o = config.objects[i];
+        tracker->objects.push_back(new Object3D(o.filename, o.tx, o.ty, o.tz, o.alpha, o.beta, o.gamma, o.scale, o.qualityThreshold, config.templateDistances));
+    }
+    
+    tracker->renderingEngine->setHalfFloatDepth(config.halfFloatDepth);
+    
+    tracker->poseEstimator = new PoseEstimator6D(config.width, config.height, config.zNear, config.zFar, config.K, config.distCoeffs, tracker->objects, tracker->renderingEngine);
+    
+    tracker->motionModels.resize(tracker->objects.size(), MotionModel(config.motionSmoothing, config.maxExtrapolation));
+    
+    return true;
+}
+
+
+static void applyCommands(RBOTTracker *tracker, Mat &frame)
+{
+    for(int c = 0; c < tracker->pendingCommands.size(); c++)
+    {
+        CommandMessage &command = tracker->pendingCommands[c];
+        if(command.command == COMMAND_RESET)
+        {
+            tracker->poseEstimator->reset();
+            continue;
+        }
+        
+        for(int i = 0; i < tracker->objects.size(); i++)
+        {
+            if(command.objectIndex >= 0 && command.objectIndex != i)
+                continue;
+            
+            bool start = command.command == COMMAND_START_TRACKING;
+            if(tracker->objects[i]->isInitialized() != start)
+                tracker->poseEstimator->toggleTracking(frame, i, false);
+        }
+    }
+    tracker->pendingCommands.clear();
+}
+
+
+static bool isValidObject(RBOTTracker *tracker, int objectIndex)
+{
+    if(tracker == NULL || tracker->poseEstimator == NULL || objectIndex < 0 || objectIndex >= tracker->objects.size())
+        return false;
+    return true;
+}
+
+
+RBOTTracker* rbot_tracker_create(const char *configFilename)
+{
+    RBOTTracker *tracker = new RBOTTracker();
+    
+    // without a configuration file all models have to be added explicitly
+    if(configFilename == NULL)
+        tracker->config.objects.clear();
+    else if(!tracker->config.load(configFilename))
+    {
+        delete tracker;
+        return NULL;
+    }
+    
+    tracker->renderingEngine = new RenderingEngine();
+    tracker->renderingEngine->doneCurrent();
+    
+    // without a context every later call would fail inside the library
+    if(!tracker->renderingEngine->isValid())
+    {
+        delete tracker->renderingEngine;
+        delete tracker;
+        return NULL;
+    }
+    
+    tracker->poseEstimator = NULL;
+    
+    return tracker;
+}
+
+
+void rbot_tracker_destroy(RBOTTracker *tracker)
+{
+    if(tracker == NULL)
+        return;
+    
+    {
+        ContextScope scope(tracker);
+        
+        for(int i = 0; i < tracker->objects.size(); i++)
+        {
+            delete tracker->objects[i];
+        }
+        
+        // the engines of the pose estimator render with the tracker's context
+        delete tracker->poseEstimator;
+        delete tracker->renderingEngine;
+        tracker->renderingEngine = NULL;
+    }
+    
+    delete tracker;
+}
+
+
+int rbot_tracker_set_camera(RBOTTracker *tracker, int width, int height, float fx, float fy, float cx, float cy, const float *distCoeffs)
+{
+    if(tracker == NULL || tracker->poseEstimator != NULL || width <= 0 || height <= 0)
+        return -1;
+    
+    TrackingConfig &config = tracker->config;
+    config.width = width;
+    config.height = height;
+    config.K = Matx33f(fx, 0, cx, 0, fy, cy, 0, 0, 1);
+    config.distCoeffs = distCoeffs ? Matx14f(distCoeffs[0], distCoeffs[1], distCoeffs[2], distCoeffs[3]) : Matx14f::zeros();
+    
+    return 0;
+}
+
+
+int rbot_tracker_add_model(RBOTTracker *tracker, const char *filename, const float initialPose[6], float scale, float qualityThreshold)
+{
+    if(tracker == NULL || tracker->poseEstimator != NULL || filename == NULL || initialPose == NULL)
+        return -1;
+    
+    ObjectConfig object = {filename, initialPose[0], initialPose[1], initialPose[2], initialPose[3], initialPose[4], initialPose[5], scale, qualityThreshold};
+    tracker->config.objects.push_back(object);
+    
+    return (int)tracker->config.objects.size() - 1;
+}
+
+
+int rbot_tracker_set_tracking(RBOTTracker *tracker, int objectIndex, int start)
+{
+    if(tracker == NULL || objectIndex >= (int)tracker->config.objects.size())
+        return -1;
+    
+    CommandMessage command = {COMMAND_MAGIC, (uint32_t)(start ? COMMAND_START_TRACKING : COMMAND_STOP_TRACKING), objectIndex};
+    tracker->pendingCommands.push_back(command);
+    
+    return 0;
+}
+
+
+int rbot_tracker_reset(RBOTTracker *tracker)
+{
+    if(tracker == NULL)
+        return -1;
+    
+    CommandMessage command = {COMMAND_MAGIC, COMMAND_RESET, -1};
+    tracker->pendingCommands.push_back(command);
+    
+    return 0;
+}
+
+
+int rbot_tracker_submit_frame(RBOTTracker *tracker, const void *data, int width, int height, size_t stride, int pixelFormat, uint64_t timestamp)
+{
+    if(tracker == NULL || data == NULL)
+        return -1;
+    
+    if(width != tracker->config.width || height != tracker->config.height)
+    {
+        cout << "rbot: the frame size " << width << "x" << height << " does not match the camera" << endl;
+        return -1;
+    }
+    
+    // NV12 frames are wrapped as a single channel image of both planes
+    int channels = 4;
+    int rows = height;
+    FrameFormat format = FRAME_FORMAT_BGR;
+    switch (pixelFormat)
+    {
+        case RBOT_PIXEL_FORMAT_BGR:
+            channels = 3;
+            break;
+        case RBOT_PIXEL_FORMAT_RGB:
+            channels = 3;
+            format = FRAME_FORMAT_RGB;
+            break;
+        case RBOT_PIXEL_FORMAT_RGBA:
+            format = FRAME_FORMAT_RGB;
+            break;
+        case RBOT_PIXEL_FORMAT_NV12:
+            channels = 1;
+            rows = height*3/2;
+            format = FRAME_FORMAT_NV12;
+            break;
+        case RBOT_PIXEL_FORMAT_YUYV:
+            channels = 2;
+            format = FRAME_FORMAT_YUYV;
+            break;
+    }
+    
+    if(pixelFormat < RBOT_PIXEL_FORMAT_BGRA || pixelFormat > RBOT_PIXEL_FORMAT_YUYV || stride < (size_t)width*channels)
+        return -1;
+    
+    if(isYUV(format) && (width % 2 != 0 || height % 2 != 0))
+        return -1;
+    
+    ContextScope scope(tracker);
+    
+    // exceptions must not cross the C interface
+    try
+    {
+        if(tracker->poseEstimator == NULL && !initialize(tracker))
+            return -1;
+        
+        // the frame is tracked in place, the pose estimator only reads it without undistortion
+        Mat frame(rows, width, CV_8UC(channels), const_cast<void*>(data), stride);
+        tracker->poseEstimator->setFrameFormat(format);
+        
+        applyCommands(tracker, frame);
+        
+        tracker->poseEstimator->estimatePoses(frame, false, true);
+        
+        for(int i = 0; i < tracker->objects.size(); i++)
+        {
+            Object3D *object = tracker->objects[i];
+            if(object->isInitialized() && !object->isTrackingLost())
+                tracker->motionModels[i].update(object->getPose(), timestamp);
+            else
+                tracker->motionModels[i].reset();
+        }
+    }
+    catch(exception &e)
+    {
+        cout << "rbot: " << e.what() << endl;
+        return -1;
+    }
+    
+    return 0;
+}
+
+
+int rbot_tracker_get_num_objects(RBOTTracker *tracker)
+{
+    if(tracker == NULL)
+        return -1;
+    
+    return (int)tracker->config.objects.size();
+}
+
+
+int rbot_tracker_get_pose(RBOTTracker *tracker, int objectIndex, float pose[16], uint32_t *flags, float *energy)
+{
+    if(!isValidObject(tracker, objectIndex) || pose == NULL)
+        return -1;
+    
+    Object3D *object = tracker->objects[objectIndex];
+    
+    Matx44f T_cm = object->getPose();
+    copy(T_cm.val, T_cm.val + 16, pose);
+    
+    if(flags)
+        *flags = (object->isInitialized() ? RBOT_POSE_INITIALIZED : 0) | (object->isTrackingLost() ? RBOT_POSE_LOST : 0);
+    if(energy)
+        *energy = object->getEnergy();
+    
+    return 0;
+}
+
+
+int rbot_tracker_predict_pose(RBOTTracker *tracker, int objectIndex, uint64_t timestamp, float pose[16])
+{
+    if(!isValidObject(tracker, objectIndex) || pose == NULL)
+        return -1;
+    
+    // objects which are not tracked stay where they are
+    Matx44f T_cm = tracker->motionModels[objectIndex].isValid() ? tracker->motionModels[objectIndex].predict(timestamp) : tracker->objects[objectIndex]->getPose();
+    copy(T_cm.val, T_cm.val + 16, pose);
+    
+    return 0;
+}
@@ -0,0 +1,188 @@
+#ifndef RBOT_TRACKER_H
+#define RBOT_TRACKER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ *  C interface of the tracker for applications running in the same process
+ *  as the camera, e.g. a capture process or a game engine plugin. It avoids
+ *  the TCP connection of the server and all frame copies: frames are
+ *  submitted as a pointer to the caller's memory, which is tracked on
+ *  directly and not retained after the call returns.
+ *
+ *  The library is built from all tracker sources (without main.cpp) with
+ *  RBOT_BUILD_LIBRARY defined, e.g.
+ *
+ *      g++ -shared -fPIC -fvisibility=hidden -DRBOT_BUILD_LIBRARY rbot_tracker.cpp pose_estimator6d.cpp ... -o librbot.so
+ *
+ *  A tracker must only be used by one thread at a time. Every call makes its
+ *  OpenGL context current on the calling thread and releases it again, so
+ *  consecutive calls may come from different threads. Since GLFW windows
+ *  can only be created on the main thread on some platforms, trackers
+ *  should be created there.
+ *
+ *  All functions returning int return a negative value on failure.
+ */
+
+#if defined(_WIN32)
+    #if defined(RBOT_BUILD_LIBRARY)
+        #define RBOT_API __declspec(dllexport)
+    #else
+        #define RBOT_API __declspec(dllimport)
+    #endif
+#else
+    #define RBOT_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct RBOTTracker RBOTTracker;
+
+/**
+ *  The memory layouts of submitted frames, the values match PixelFormat of
+ *  the streaming protocol. Frames of all formats are tracked in place, YUV
+ *  frames in YUV. Switching between YUV and the other formats stops
+ *  tracking all objects.
+ */
+enum RBOTPixelFormat
+{
+    RBOT_PIXEL_FORMAT_BGRA = 0,
+    RBOT_PIXEL_FORMAT_BGR = 1,
+    RBOT_PIXEL_FORMAT_RGBA = 2,
+    RBOT_PIXEL_FORMAT_RGB = 3,
+    
+    // the Y plane directly followed by the interleaved UV plane, both with the given stride
+    RBOT_PIXEL_FORMAT_NV12 = 4,
+    
+    // packed 4:2:2, Y0 U Y1 V for every two pixels
+    RBOT_PIXEL_FORMAT_YUYV = 5
+};
+
+/**
+ *  State of an object as returned by rbot_tracker_get_pose, the values
+ *  match ObjectPoseFlags of the streaming protocol.
+ */
+enum RBOTPoseFlags
+{
+    RBOT_POSE_INITIALIZED = 1,
+    RBOT_POSE_LOST = 2
+};
+
+/**
+ *  Creates a tracker with its own rendering engine.
+ *
+ *  @param  configFilename A configuration file as read by TrackingConfig::load, whose camera and objects are used, or NULL for the default camera and no objects.
+ *  @return The tracker or NULL if the configuration file could not be read or no OpenGL context could be created.
+ */
+RBOT_API RBOTTracker* rbot_tracker_create(const char *configFilename);
+
+/**
+ *  Destroys a tracker and all of its objects.
+ *
+ *  @param  tracker The tracker, may be NULL.
+ */
+RBOT_API void rbot_tracker_destroy(RBOTTracker *tracker);
+
+/**
+ *  Sets the camera the frames are captured with. This is only possible
+ *  before the first frame has been submitted.
+ *
+ *  @param  tracker The tracker.
+ *  @param  width The width of the frames in pixels.
+ *  @param  height The height of the frames in pixels.
+ *  @param  fx, fy, cx, cy The intrinsics of the camera in pixels.
+ *  @param  distCoeffs The distortion coefficients k1, k2, p1, p2 (as used by OpenCV) or NULL for none.
+ *  @return 0 on success.
+ */
+RBOT_API int rbot_tracker_set_camera(RBOTTracker *tracker, int width, int height, float fx, float fy, float cx, float cy, const float *distCoeffs);
+
+/**
+ *  Adds a 3D model to be tracked. This is only possible before the first
+ *  frame has been submitted, since the templates for pose detection of all
+ *  objects are generated with it.
+ *
+ *  @param  tracker The tracker.
+ *  @param  filename The path of the model file (.obj).
+ *  @param  initialPose The initial translation tx, ty, tz and Euler angles alpha, beta, gamma in degrees.
+ *  @param  scale The scale of the model.
+ *  @param  qualityThreshold The tracking quality threshold within [0.5, 0.6].
+ *  @return The index of the object or a negative value on failure.
+ */
+RBOT_API int rbot_tracker_add_model(RBOTTracker *tracker, const char *filename, const float initialPose[6], float scale, float qualityThreshold);
+
+/**
+ *  Starts or stops tracking an object in its initial pose. Since the
+ *  histograms are initialized from a camera frame, the change is applied
+ *  with the next submitted frame.
+ *
+ *  @param  tracker The tracker.
+ *  @param  objectIndex The index of the object or -1 for all of them.
+ *  @param  start Non-zero to start and zero to stop tracking.
+ *  @return 0 on success.
+ */
+RBOT_API int rbot_tracker_set_tracking(RBOTTracker *tracker, int objectIndex, int start);
+
+/**
+ *  Stops tracking all objects and moves them back to their initial poses,
+ *  applied with the next submitted frame.
+ *
+ *  @param  tracker The tracker.
+ *  @return 0 on success.
+ */
+RBOT_API int rbot_tracker_reset(RBOTTracker *tracker);
+
+/**
+ *  Estimates the poses of all objects in a frame. The first call loads the
+ *  models and generates the templates, which takes a while. The memory is
+ *  only read and not accessed anymore once the function has returned.
+ *
+ *  @param  tracker The tracker.
+ *  @param  data The first pixel of the frame.
+ *  @param  width The width of the frame, which must match the camera (and be even for YUV frames).
+ *  @param  height The height of the frame, which must match the camera (and be even for YUV frames).
+ *  @param  stride The distance between two rows in bytes.
+ *  @param  pixelFormat One of RBOTPixelFormat.
+ *  @param  timestamp The capture time of the frame in microseconds, used for predicting poses.
+ *  @return 0 on success.
+ */
+RBOT_API int rbot_tracker_submit_frame(RBOTTracker *tracker, const void *data, int width, int height, size_t stride, int pixelFormat, uint64_t timestamp);
+
+/**
+ *  @param  tracker The tracker.
+ *  @return The number of objects added to the tracker.
+ */
+RBOT_API int rbot_tracker_get_num_objects(RBOTTracker *tracker);
+
+/**
+ *  Returns the pose of an object estimated from the last submitted frame.
+ *
+ *  @param  tracker The tracker.
+ *  @param  objectIndex The index of the object.
+ *  @param  pose Receives the pose T_cm as a 4x4 matrix in row-major order.
+ *  @param  flags Receives a combination of RBOTPoseFlags, may be NULL.
+ *  @param  energy Receives the value of the energy function of the last pose estimation, may be NULL.
+ *  @return 0 on success.
+ */
+RBOT_API int rbot_tracker_get_pose(RBOTTracker *tracker, int objectIndex, float pose[16], uint32_t *flags, float *energy);
+
+/**
+ *  Extrapolates the pose of a tracked object to the given time, e.g. the
+ *  time the next rendered image will be displayed, assuming it keeps
+ *  moving with the velocity observed in the last frames.
+ *
+ *  @param  tracker The tracker.
+ *  @param  objectIndex The index of the object.
+ *  @param  timestamp The time in microseconds, on the clock of the frame timestamps.
+ *  @param  pose Receives the predicted pose T_cm as a 4x4 matrix in row-major order.
+ *  @return 0 on success.
+ */
+RBOT_API int rbot_tracker_predict_pose(RBOTTracker *tracker, int objectIndex, uint64_t timestamp, float pose[16]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RBOT_TRACKER_H */
@@ -39,36 +39,327 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+#include <cstring>
 #include <iostream>
 
+#if defined(RBOT_GL_BACKEND_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(RBOT_GL_BACKEND_OSMESA)
+#include <GL/osmesa.h>
+#else
+#include <GLFW/glfw3.h>
+#endif
+
 using namespace std;
 using namespace cv;
 
+// the width and height of the atlas used by renderSilhouetteAtlas, unless the driver supports less
+static const int ATLAS_SIZE = 4096;
 
-RenderingEngine* RenderingEngine::instance;
 
-RenderingEngine::RenderingEngine(void)
+#if defined(RBOT_GL_BACKEND_EGL)
+
+struct OffscreenContext
+{
+    EGLContext context;
+    
+    // EGL_NO_SURFACE if the display supports surfaceless contexts
+    EGLSurface surface;
+};
+
+static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+
+static bool hasExtension(const char *extensions, const char *name)
+{
+    if(extensions == NULL)
+        return false;
+    
+    size_t length = strlen(name);
+    for(const char *s = strstr(extensions, name); s != NULL; s = strstr(s + length, name))
+    {
+        if((s == extensions || s[-1] == ' ') && (s[length] == ' ' || s[length] == '\0'))
+            return true;
+    }
+    return false;
+}
+
+// all engines share one display, which is preferably the surfaceless platform of Mesa, so no display server is needed
+static EGLDisplay getDisplay()
+{
+    if(eglDisplay != EGL_NO_DISPLAY)
+        return eglDisplay;
+    
+    const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if(hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if(eglGetPlatformDisplayEXT)
+            eglDisplay = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if(eglDisplay == EGL_NO_DISPLAY)
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    
+    if(eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, NULL, NULL))
+    {
+        cout << "Failed to initialize EGL" << endl;
+        eglDisplay = EGL_NO_DISPLAY;
+    }
+    return eglDisplay;
+}
+
+static OffscreenContext* createContext()
+{
+    EGLDisplay display = getDisplay();
+    if(display == EGL_NO_DISPLAY)
+        return NULL;
+    
+    bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+    
+    EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if(!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) || numConfigs == 0 || !eglBindAPI(EGL_OPENGL_API))
+    {
+        cout << "Failed to find an EGL configuration for OpenGL" << endl;
+        return NULL;
+    }
+    
+    EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    OffscreenContext *context = new OffscreenContext();
+    context->context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    context->surface = EGL_NO_SURFACE;
+    
+    // everything is rendered into frame buffer objects, so the pbuffer is never drawn to
+    if(context->context != EGL_NO_CONTEXT && !surfaceless)
+    {
+        EGLint surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        context->surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    }
+    
+    if(context->context == EGL_NO_CONTEXT || (!surfaceless && context->surface == EGL_NO_SURFACE))
+    {
+        cout << "Failed to create an EGL context (error 0x" << hex << eglGetError() << dec << ")" << endl;
+        if(context->context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context->context);
+        delete context;
+        return NULL;
+    }
+    return context;
+}
+
+static void destroyContext(OffscreenContext *context)
+{
+    if(context->surface != EGL_NO_SURFACE)
+        eglDestroySurface(eglDisplay, context->surface);
+    eglDestroyContext(eglDisplay, context->context);
+    delete context;
+}
+
+static void makeContextCurrent(OffscreenContext *context)
+{
+    if(context)
+        eglMakeCurrent(eglDisplay, context->surface, context->surface, context->context);
+    else if(eglDisplay != EGL_NO_DISPLAY)
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+static void* getProcAddress(const char *name)
+{
+    return (void*)eglGetProcAddress(name);
+}
+
+void RenderingEngine::terminate()
+{
+    if(eglDisplay != EGL_NO_DISPLAY)
+        eglTerminate(eglDisplay);
+    eglDisplay = EGL_NO_DISPLAY;
+}
+
+#elif defined(RBOT_GL_BACKEND_OSMESA)
+
+struct OffscreenContext
+{
+    OSMesaContext context;
+    
+    // OSMesa always needs a color buffer to be made current, but everything is rendered into frame buffer objects
+    uchar buffer[4];
+};
+
+static OffscreenContext* createContext()
+{
+    int attributes[] = {
+        OSMESA_FORMAT, OSMESA_RGBA,
+        OSMESA_DEPTH_BITS, 24,
+        OSMESA_STENCIL_BITS, 0,
+        OSMESA_ACCUM_BITS, 0,
+        OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, 3,
+        OSMESA_CONTEXT_MINOR_VERSION, 3,
+        0
+    };
+    OSMesaContext osmesaContext = OSMesaCreateContextAttribs(attributes, NULL);
+    if(osmesaContext == NULL)
+    {
+        cout << "Failed to create an OSMesa context" << endl;
+        return NULL;
+    }
+    
+    OffscreenContext *context = new OffscreenContext();
+    context->context = osmesaContext;
+    return context;
+}
+
+static void destroyContext(OffscreenContext *context)
+{
+    OSMesaDestroyContext(context->context);
+    delete context;
+}
+
+static void makeContextCurrent(OffscreenContext *context)
+{
+    if(context)
+        OSMesaMakeCurrent(context->context, context->buffer, GL_UNSIGNED_BYTE, 1, 1);
+    else
+        OSMesaMakeCurrent(NULL, NULL, 0, 0, 0);
+}
+
+static void* getProcAddress(const char *name)
+{
+    return (void*)OSMesaGetProcAddress(name);
+}
+
+void RenderingEngine::terminate()
+{
+    // OSMesa keeps no state besides the contexts
+}
+
+#else
+
+struct OffscreenContext
+{
+    GLFWwindow *window;
+};
+
+static OffscreenContext* createContext()
 {
     glfwInit();
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-        offscreen_context = glfwCreateWindow(1440, 960, "", NULL, NULL);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    // everything is rendered into frame buffer objects, so the window is never drawn to
+    GLFWwindow *window = glfwCreateWindow(1, 1, "", NULL, NULL);
+    if(window == NULL)
+    {
+        cout << "Failed to create a GLFW window, use the EGL or OSMesa backend without a display" << endl;
+        return NULL;
+    }
+    
+    OffscreenContext *context = new OffscreenContext();
+    context->window = window;
+    return context;
+}
+
+static void destroyContext(OffscreenContext *context)
+{
+    glfwDestroyWindow(context->window);
+    delete context;
+}
+
+static void makeContextCurrent(OffscreenContext *context)
+{
+    glfwMakeContextCurrent(context ? context->window : NULL);
+}
+
+static void* getProcAddress(const char *name)
+{
+    return (void*)glfwGetProcAddress(name);
+}
+
+void RenderingEngine::terminate()
+{
+    glfwTerminate();
+}
+
+#endif
+
+
+RenderingEngine::RenderingEngine(void)
+{
+    initMembers();
+    
+    offscreen_context = createContext();
+    ownsContext = true;
+    
+    halfFloatDepth = false;
     
     makeCurrent();
     
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    if (!offscreen_context || !gladLoadGLLoader((GLADloadproc)getProcAddress))
+    {
+        cout << "Failed to initialize GLAD" << endl;
+        
+        if(offscreen_context)
         {
-            cout << "Failed to initialize GLAD" << endl;
-            return;
+            makeContextCurrent(NULL);
+            destroyContext(offscreen_context);
+            offscreen_context = NULL;
         }
-        cout << "GL Version " << glGetString(GL_VERSION) << endl << "GLSL Version " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
+        return;
+    }
+    cout << "GL Version " << glGetString(GL_VERSION) << endl << "GLSL Version " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
+}
+
+RenderingEngine::RenderingEngine(RenderingEngine *sharedEngine)
+{
+    initMembers();
+    
+    // GLAD has already been loaded for the context
+    offscreen_context = sharedEngine->offscreen_context;
+    ownsContext = false;
+    
+    halfFloatDepth = sharedEngine->halfFloatDepth;
+}
+
+void RenderingEngine::initMembers()
+{
+    // shaders are cheap to compile, so every engine has its own and none depends on another one's lifetime
+    silhouetteShaderProgram = NULL;
+    phongblinnShaderProgram = NULL;
+    normalsShaderProgram = NULL;
+    depthsShaderProgram = NULL;
+    overlayShaderProgram = NULL;
+    
+    frameTextureID = 0;
+    overlayVertexArrayID = 0;
     
-//    silhouetteShaderProgram = new Shader();
-//    phongblinnShaderProgram = new Shader();
-//    normalsShaderProgram = new Shader();
+    atlas = RenderTarget();
+    
+    width = 0;
+    height = 0;
+    fullWidth = 0;
+    fullHeight = 0;
+    
+    zNear = 0.1f;
+    zFar = 1000.0f;
+    
+    numLevels = 1;
     
     calibrationMatrices.push_back(Matx44f::eye());
     
@@ -76,63 +367,87 @@ RenderingEngine::RenderingEngine(void)
     
     lookAtMatrix = Transformations::lookAtMatrix(0, 0, 0, 0, 0, 1, 0, -1, 0);
     
+    roiProjectionMatrix = projectionMatrix;
+    
     currentLevel = 0;
+    
+    angle = 0;
+    
+    lightPosition = cv::Vec3f(0, 0, 0);
 }
 
 RenderingEngine::~RenderingEngine(void)
 {
-    glDeleteTextures(1, &colorTextureID);
-    glDeleteTextures(1, &depthTextureID);
-    glDeleteFramebuffers(1, &frameBufferID);
+    // nothing has been created without a context
+    if(!isValid())
+        return;
+    
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+    for(int i = 0; i < renderTargets.size(); i++)
+    {
+        deleteRenderTarget(renderTargets[i]);
+    }
+    deleteRenderTarget(atlas);
+    
+    for(int i = 0; i < readbackBuffers.size(); i++)
+    {
+        if(readbackBuffers[i].pending)
+            glDeleteSync(readbackBuffers[i].fence);
+        glDeleteBuffers(1, &readbackBuffers[i].bufferID);
+    }
     
     delete phongblinnShaderProgram;
     delete normalsShaderProgram;
     delete silhouetteShaderProgram;
+    delete depthsShaderProgram;
+    delete overlayShaderProgram;
+    
+    glDeleteTextures(1, &frameTextureID);
+    glDeleteVertexArrays(1, &overlayVertexArrayID);
+    
+    if(offscreen_context && ownsContext)
+    {
+        makeContextCurrent(NULL);
+        destroyContext(offscreen_context);
+    }
 }
 
-void RenderingEngine::destroy()
+
+bool RenderingEngine::isValid()
 {
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    
-    delete instance;
-    instance = NULL;
+    return offscreen_context != NULL;
 }
 
 
 void RenderingEngine::makeCurrent()
 {
-    glfwMakeContextCurrent(offscreen_context);
+    makeContextCurrent(offscreen_context);
 }
 
 
 void RenderingEngine::doneCurrent()
 {
-    glfwMakeContextCurrent(nullptr);
-}
-
-GLFWwindow* RenderingEngine::getContext()
-{
-    return offscreen_context;
+    makeContextCurrent(NULL);
 }
 
 
 GLuint RenderingEngine::getFrameBufferID()
 {
-    return frameBufferID;
+    return renderTargets.empty() ? 0 : renderTargets[currentLevel].frameBufferID;
 }
 
 
 GLuint RenderingEngine::getColorTextureID()
 {
-    return colorTextureID;
+    return renderTargets.empty() ? 0 : renderTargets[currentLevel].colorTextureID;
 }
 
 
 GLuint RenderingEngine::getDepthTextureID()
 {
-    return depthTextureID;
+    return renderTargets.empty() ? 0 : renderTargets[currentLevel].depthTextureID;
 }
 
 float RenderingEngine::getZNear()
@@ -152,18 +467,18 @@ Matx44f RenderingEngine::getCalibrationMatrix()
 
 void RenderingEngine::init(const Matx33f& K, int width, int height, float zNear, float zFar, int numLevels)
 {
-    this->width = width;
-    this->height = height;
-    
-    fullWidth = width;
-    fullHeight = height;
-    
     this->zNear = zNear;
     this->zFar = zFar;
     
     this->numLevels = numLevels;
     
-    projectionMatrix = Transformations::perspectiveMatrix(K, width, height, zNear, zFar, true);
+    if(!isValid())
+    {
+        cout << "Can not initialize a rendering engine without an OpenGL context" << endl;
+        return;
+    }
+    
+    setCalibration(K, width, height);
     
     makeCurrent();
     
@@ -172,24 +487,12 @@ void RenderingEngine::init(const Matx33f& K, int width, int height, float zNear,
 //    glGenVertexArrays(1, &vao);
 //    glBindVertexArray(vao);
     
-    calibrationMatrices.clear();
-    
-    for(int i = 0; i < numLevels; i++)
-    {
-        float s = pow(2, i);
-        
-        Matx44f K_l = Matx44f::eye();
-        K_l(0, 0) = K(0, 0)/s;
-        K_l(1, 1) = K(1, 1)/s;
-        K_l(0, 2) = K(0, 2)/s;
-        K_l(1, 2) = K(1, 2)/s;
-        
-        calibrationMatrices.push_back(K_l);
-    }
-    
     glEnable(GL_DEPTH);
     glEnable(GL_DEPTH_TEST);
     
+    // clearing is limited to the region of interest as well
+    glEnable(GL_SCISSOR_TEST);
+    
     //INVERT DEPTH BUFFER
     glDepthRange(1, 0);
     glClearDepth(0.0f);
@@ -199,13 +502,19 @@ void RenderingEngine::init(const Matx33f& K, int width, int height, float zNear,
     
     glClearColor(0.0, 0.0, 0.0, 1.0);
     
-//    initRenderingBuffers();
+    // the rows of the downloaded images are tightly packed like those of a cv::Mat
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    
+    // the default frame buffer is too small to render into
+    initRenderingBuffers();
     
     shaderFolder = "src/";
     
     silhouetteShaderProgram = new Shader("silhouette_vertex_shader.glsl", "silhouette_fragment_shader.glsl");
     phongblinnShaderProgram = new Shader("phongblinn_vertex_shader.glsl", "phongblinn_fragment_shader.glsl");
     normalsShaderProgram = new Shader("normals_vertex_shader.glsl", "normals_fragment_shader.glsl");
+    depthsShaderProgram = new Shader("silhouette_vertex_shader.glsl", "depths_fragment_shader.glsl");
+    overlayShaderProgram = new Shader("overlay_vertex_shader.glsl", "overlay_fragment_shader.glsl");
     
     angle = 0;
     
@@ -214,20 +523,88 @@ void RenderingEngine::init(const Matx33f& K, int width, int height, float zNear,
     doneCurrent();
 }
 
+void RenderingEngine::setCalibration(const Matx33f& K, int width, int height)
+{
+    fullWidth = width;
+    fullHeight = height;
+    
+    projectionMatrix = Transformations::perspectiveMatrix(K, width, height, zNear, zFar, true);
+    
+    calibrationMatrices.clear();
+    
+    for(int i = 0; i < numLevels; i++)
+    {
+        float s = pow(2, i);
+        
+        Matx44f K_l = Matx44f::eye();
+        K_l(0, 0) = K(0, 0)/s;
+        K_l(1, 1) = K(1, 1)/s;
+        K_l(0, 2) = K(0, 2)/s;
+        K_l(1, 2) = K(1, 2)/s;
+        
+        calibrationMatrices.push_back(K_l);
+    }
+    
+    setLevel(currentLevel);
+    
+    // before init the buffers are created with the final size right away
+    if(!renderTargets.empty())
+        initRenderingBuffers();
+}
+
 int RenderingEngine::getNumLevels()
 {
     return numLevels;
 }
 
-void RenderingEngine::setLevel(int level)
+Size RenderingEngine::levelSize(int level)
 {
-    currentLevel = level;
-    int s = pow(2, currentLevel);
-    width = fullWidth/s;
-    height = fullHeight/s;
+    int s = pow(2, level);
+    int width = fullWidth/s;
+    int height = fullHeight/s;
     
     width += width%4;
     height += height%4;
+    
+    return Size(width, height);
+}
+
+void RenderingEngine::setLevel(int level)
+{
+    currentLevel = level;
+    Size size = levelSize(currentLevel);
+    width = size.width;
+    height = size.height;
+    
+    setROI(Rect(0, 0, width, height));
+}
+
+
+void RenderingEngine::setROI(const Rect &roi)
+{
+    this->roi = roi & Rect(0, 0, width, height);
+    if(this->roi.area() == 0)
+        this->roi = Rect(0, 0, width, height);
+    
+    roiProjectionMatrix = cropMatrix(this->roi)*projectionMatrix;
+}
+
+
+Matx44f RenderingEngine::cropMatrix(const Rect &region)
+{
+    // scales and shifts the normalized device coordinates, such that the region covers [-1, 1]
+    float sx = (float)width/region.width;
+    float sy = (float)height/region.height;
+    return Matx44f(sx, 0,  0, (float)(width - 2*region.x - region.width)/region.width,
+                   0,  sy, 0, (float)(height - 2*region.y - region.height)/region.height,
+                   0,  0,  1, 0,
+                   0,  0,  0, 1);
+}
+
+
+Rect RenderingEngine::getROI()
+{
+    return roi;
 }
 
 
@@ -237,39 +614,153 @@ int RenderingEngine::getLevel()
 }
 
 
+void RenderingEngine::setHalfFloatDepth(bool halfFloat)
+{
+    halfFloatDepth = halfFloat;
+    
+    // re-specifying the textures keeps them attached to the frame buffers
+    for(int i = 0; i < renderTargets.size(); i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, renderTargets[i].linearDepthTextureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, halfFloatDepth ? GL_R16F : GL_R32F, renderTargets[i].width, renderTargets[i].height, 0, GL_RED, GL_FLOAT, NULL);
+    }
+    if(atlas.frameBufferID != 0)
+    {
+        glBindTexture(GL_TEXTURE_2D, atlas.linearDepthTextureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, halfFloatDepth ? GL_R16F : GL_R32F, atlas.width, atlas.height, 0, GL_RED, GL_FLOAT, NULL);
+    }
+}
+
+
+bool RenderingEngine::isHalfFloatDepth()
+{
+    return halfFloatDepth;
+}
+
+
 bool RenderingEngine::initRenderingBuffers()
 {
-    glGenTextures(1, &colorTextureID);
-    glBindTexture(GL_TEXTURE_2D, colorTextureID);
+    bool complete = true;
     
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    renderTargets.resize(numLevels, RenderTarget());
+    
+    for(int level = 0; level < numLevels; level++)
+    {
+        RenderTarget &target = renderTargets[level];
+        Size size = levelSize(level);
+        
+        // smaller images, e.g. of cropped frames, are rendered into the bottom left corner
+        if(target.frameBufferID == 0)
+            complete &= initRenderTarget(target, size.width, size.height, true);
+        else if(size.width > target.width || size.height > target.height)
+            resizeRenderTarget(target, max(size.width, target.width), max(size.height, target.height));
+    }
     
+    if(!renderTargets.empty())
+        glBindFramebuffer(GL_FRAMEBUFFER, renderTargets[currentLevel].frameBufferID);
     
-    glGenTextures(1, &depthTextureID);
-    glBindTexture(GL_TEXTURE_2D, depthTextureID);
+    return complete;
+}
+
+
+bool RenderingEngine::initRenderTarget(RenderTarget &target, int width, int height, bool withDepths)
+{
+    glGenTextures(1, &target.colorTextureID);
+    glBindTexture(GL_TEXTURE_2D, target.colorTextureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glGenTextures(1, &target.depthTextureID);
+    glBindTexture(GL_TEXTURE_2D, target.depthTextureID);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     
-    glGenFramebuffers(1, &frameBufferID);
-    glBindFramebuffer(GL_FRAMEBUFFER, frameBufferID);
+    // the metric depth written by the silhouette shader, so it does not have to be linearized on the CPU
+    glGenTextures(1, &target.linearDepthTextureID);
+    glBindTexture(GL_TEXTURE_2D, target.linearDepthTextureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    
+    // renderDepths needs float precision and blending, but no depth buffer
+    if(withDepths)
+    {
+        glGenTextures(1, &target.depthsTextureID);
+        glBindTexture(GL_TEXTURE_2D, target.depthsTextureID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    
+    resizeRenderTarget(target, width, height);
+    
+    glGenFramebuffers(1, &target.frameBufferID);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.frameBufferID);
+    
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTextureID, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, target.linearDepthTextureID, 0);
     
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTextureID, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depthTextureID, 0);
     
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextureID, 0);
+    // the shaders without a second output leave the linear depth map undefined
+    GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
     
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    
+    if(withDepths)
     {
-        cout << "error creating rendering buffers" << endl;
+        glGenFramebuffers(1, &target.depthsFrameBufferID);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.depthsFrameBufferID);
+        
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.depthsTextureID, 0);
+        
+        complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+    
+    if(!complete)
+    {
+        cout << "error creating rendering buffers of size " << width << "x" << height << endl;
         return false;
     }
     return true;
 }
 
 
+void RenderingEngine::resizeRenderTarget(RenderTarget &target, int width, int height)
+{
+    target.width = width;
+    target.height = height;
+    
+    // re-specifying the textures keeps them attached to the frame buffers
+    glBindTexture(GL_TEXTURE_2D, target.colorTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    
+    glBindTexture(GL_TEXTURE_2D, target.depthTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    
+    glBindTexture(GL_TEXTURE_2D, target.linearDepthTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, halfFloatDepth ? GL_R16F : GL_R32F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+    
+    if(target.depthsTextureID != 0)
+    {
+        glBindTexture(GL_TEXTURE_2D, target.depthsTextureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    }
+    
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+void RenderingEngine::deleteRenderTarget(RenderTarget &target)
+{
+    glDeleteTextures(1, &target.colorTextureID);
+    glDeleteTextures(1, &target.depthTextureID);
+    glDeleteTextures(1, &target.linearDepthTextureID);
+    glDeleteFramebuffers(1, &target.frameBufferID);
+    glDeleteTextures(1, &target.depthsTextureID);
+    glDeleteFramebuffers(1, &target.depthsFrameBufferID);
+}
+
+
 
 bool RenderingEngine::initShaderProgram(GLuint ID, string shaderName)
 {
@@ -312,7 +803,11 @@ void RenderingEngine::renderNormals(Model* model, GLenum polyonMode, bool drawAl
 
 void RenderingEngine::renderSilhouette(vector<Model*> models, GLenum polyonMode, bool invertDepth, const std::vector<cv::Point3f>& colors, bool drawAll)
 {
-    glViewport(0, 0, width, height);
+    // other engines may render with the same context in between
+    glBindFramebuffer(GL_FRAMEBUFFER, renderTargets[currentLevel].frameBufferID);
+    
+    glViewport(0, 0, roi.width, roi.height);
+    glScissor(0, 0, roi.width, roi.height);
     
     if(invertDepth)
     {
@@ -333,9 +828,10 @@ void RenderingEngine::renderSilhouette(vector<Model*> models, GLenum polyonMode,
             
             Matx44f modelViewMatrix = lookAtMatrix*(pose*normalization);
             
-            Matx44f modelViewProjectionMatrix = projectionMatrix*modelViewMatrix;
+            Matx44f modelViewProjectionMatrix = roiProjectionMatrix*modelViewMatrix;
             
             silhouetteShaderProgram->use();
+            silhouetteShaderProgram->setMat4("uMVMatrix", modelViewMatrix);
             silhouetteShaderProgram->setMat4("uMVPMatrix", modelViewProjectionMatrix);
             silhouetteShaderProgram->setFloat("uAlpha", 1.0f);
             
@@ -359,16 +855,179 @@ void RenderingEngine::renderSilhouette(vector<Model*> models, GLenum polyonMode,
     glClearDepth(0.0f);
     glDepthFunc(GL_GREATER);
     
-    glFinish();
+    // the downloads wait for the rendering themselves, so the GPU only has to be kept busy
+    glFlush();
+}
+
+
+int RenderingEngine::renderSilhouetteAtlas(Model *model, const vector<Matx44f> &poses, const vector<Rect> &regions, int first, vector<Rect> &tiles)
+{
+    if(atlas.frameBufferID == 0)
+    {
+        GLint maxTextureSize, maxViewportDims[2];
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewportDims);
+        
+        int size = min(ATLAS_SIZE, (int)min(maxTextureSize, min(maxViewportDims[0], maxViewportDims[1])));
+        initRenderTarget(atlas, size, size, false);
+    }
+    
+    // the tiles are packed into rows, the next row starts below the highest tile of the previous one
+    tiles.clear();
+    int x = 0;
+    int y = 0;
+    int rowHeight = 0;
+    atlasSize = Size(0, 0);
+    for(int i = first; i < poses.size(); i++)
+    {
+        int tileWidth = max(min(regions[i].width, atlas.width), 0);
+        int tileHeight = max(min(regions[i].height, atlas.height), 0);
+        if(x + tileWidth > atlas.width)
+        {
+            x = 0;
+            y += rowHeight;
+            rowHeight = 0;
+        }
+        if(y + tileHeight > atlas.height)
+            break;
+        
+        tiles.push_back(Rect(x, y, tileWidth, tileHeight));
+        
+        x += tileWidth;
+        rowHeight = max(rowHeight, tileHeight);
+        atlasSize.width = max(atlasSize.width, x);
+    }
+    atlasSize.height = y + rowHeight;
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, atlas.frameBufferID);
+    
+    glScissor(0, 0, atlasSize.width, atlasSize.height);
+    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    
+    silhouetteShaderProgram->use();
+    silhouetteShaderProgram->setFloat("uAlpha", 1.0f);
+    silhouetteShaderProgram->setVec3("uColor", 1.0f, 1.0f, 1.0f);
+    
+    Matx44f normalization = model->getNormalization();
+    
+    for(int i = 0; i < tiles.size(); i++)
+    {
+        Rect &tile = tiles[i];
+        if(tile.area() == 0)
+            continue;
+        
+        glViewport(tile.x, tile.y, tile.width, tile.height);
+        glScissor(tile.x, tile.y, tile.width, tile.height);
+        
+        Matx44f modelViewMatrix = lookAtMatrix*(poses[first + i]*normalization);
+        
+        // the same projection as with the region set as the region of interest
+        Matx44f modelViewProjectionMatrix = cropMatrix(Rect(regions[first + i].tl(), tile.size()))*projectionMatrix*modelViewMatrix;
+        
+        silhouetteShaderProgram->setMat4("uMVMatrix", modelViewMatrix);
+        silhouetteShaderProgram->setMat4("uMVPMatrix", modelViewProjectionMatrix);
+        
+        model->draw(silhouetteShaderProgram);
+    }
+    
+    glFlush();
+    
+    return (int)tiles.size();
+}
+
+
+Mat RenderingEngine::downloadAtlas(RenderingEngine::FrameType type)
+{
+    return readPixels(atlas.frameBufferID, type, atlasSize.width, atlasSize.height);
 }
 
 
 void RenderingEngine::renderShaded(vector<Model*> models, GLenum polyonMode, const std::vector<cv::Point3f>& colors, bool drawAll)
 {
-    glViewport(0, 0, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, renderTargets[currentLevel].frameBufferID);
+    
+    glViewport(0, 0, roi.width, roi.height);
+    glScissor(0, 0, roi.width, roi.height);
     
     glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
     
+    drawShaded(models, polyonMode, colors, 1.0f, drawAll);
+    
+    glFlush();
+}
+
+
+void RenderingEngine::renderOverlay(vector<Model*> models, const Mat &frame, FrameFormat format, const std::vector<cv::Point3f>& colors, float alpha, bool drawAll)
+{
+    if(frameTextureID == 0)
+    {
+        glGenTextures(1, &frameTextureID);
+        glBindTexture(GL_TEXTURE_2D, frameTextureID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        
+        glGenVertexArrays(1, &overlayVertexArrayID);
+    }
+    
+    // the rows of the frame may be padded, e.g. if it is a region of a larger image
+    glBindTexture(GL_TEXTURE_2D, frameTextureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)(frame.step/frame.elemSize()));
+    
+    // the channels are reordered during the upload
+    GLenum pixelFormat;
+    if(format == FRAME_FORMAT_RGB)
+        pixelFormat = (frame.channels() == 4) ? GL_RGBA : GL_RGB;
+    else
+        pixelFormat = (frame.channels() == 4) ? GL_BGRA : GL_BGR;
+    
+    if(frame.size() != frameTextureSize)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, frame.cols, frame.rows, 0, pixelFormat, GL_UNSIGNED_BYTE, frame.data);
+        frameTextureSize = frame.size();
+    }
+    else
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.cols, frame.rows, pixelFormat, GL_UNSIGNED_BYTE, frame.data);
+    
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, renderTargets[currentLevel].frameBufferID);
+    
+    glViewport(0, 0, roi.width, roi.height);
+    glScissor(0, 0, roi.width, roi.height);
+    
+    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    
+    // the frame lies behind all models
+    glDisable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    
+    overlayShaderProgram->use();
+    overlayShaderProgram->setInt("uFrame", 0);
+    overlayShaderProgram->setVec2("uOffset", (float)roi.x, (float)roi.y);
+    
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(overlayVertexArrayID);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    
+    glEnable(GL_DEPTH_TEST);
+    
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    
+    drawShaded(models, GL_FILL, colors, alpha, drawAll);
+    
+    glDisable(GL_BLEND);
+    
+    glFlush();
+}
+
+
+void RenderingEngine::drawShaded(vector<Model*> &models, GLenum polyonMode, const std::vector<cv::Point3f>& colors, float alpha, bool drawAll)
+{
     for(int i = 0; i < models.size(); i++)
     {
         Model* model = models[i];
@@ -382,7 +1041,7 @@ void RenderingEngine::renderShaded(vector<Model*> models, GLenum polyonMode, con
             
             Matx33f normalMatrix = modelViewMatrix.get_minor<3, 3>(0, 0).inv().t();
             
-            Matx44f modelViewProjectionMatrix = projectionMatrix*modelViewMatrix;
+            Matx44f modelViewProjectionMatrix = roiProjectionMatrix*modelViewMatrix;
             
             phongblinnShaderProgram->use();
             phongblinnShaderProgram->setMat4("uMVMatrix", modelViewMatrix);
@@ -392,7 +1051,7 @@ void RenderingEngine::renderShaded(vector<Model*> models, GLenum polyonMode, con
             phongblinnShaderProgram->setVec3("uLightPosition2", -0.1, 0.1, -0.02);
             phongblinnShaderProgram->setVec3("uLightPosition3", 0.0, 0.0, 0.1);
             phongblinnShaderProgram->setFloat("uShininess", 100.0f);
-            phongblinnShaderProgram->setFloat("uAlpha", 1.0f);
+            phongblinnShaderProgram->setFloat("uAlpha", alpha);
             
             Point3f color;
             if(i < colors.size())
@@ -410,13 +1069,14 @@ void RenderingEngine::renderShaded(vector<Model*> models, GLenum polyonMode, con
             model->draw(phongblinnShaderProgram);
         }
     }
-    
-    glFinish();
 }
 
 void RenderingEngine::renderNormals(vector<Model*> models, GLenum polyonMode, bool drawAll)
 {
-    glViewport(0, 0, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, renderTargets[currentLevel].frameBufferID);
+    
+    glViewport(0, 0, roi.width, roi.height);
+    glScissor(0, 0, roi.width, roi.height);
     
     glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
     
@@ -433,7 +1093,7 @@ void RenderingEngine::renderNormals(vector<Model*> models, GLenum polyonMode, bo
             
             Matx33f normalMatrix = modelViewMatrix.get_minor<3, 3>(0, 0).inv().t();
             
-            Matx44f modelViewProjectionMatrix = projectionMatrix*modelViewMatrix;
+            Matx44f modelViewProjectionMatrix = roiProjectionMatrix*modelViewMatrix;
             
             normalsShaderProgram->use();
             normalsShaderProgram->setMat4("uMVMatrix", modelViewMatrix);
@@ -447,7 +1107,83 @@ void RenderingEngine::renderNormals(vector<Model*> models, GLenum polyonMode, bo
         }
     }
     
-    glFinish();
+    glFlush();
+}
+
+
+void RenderingEngine::renderDepths(vector<Model*> models, bool drawAll)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, renderTargets[currentLevel].depthsFrameBufferID);
+    
+    glViewport(0, 0, roi.width, roi.height);
+    glScissor(0, 0, roi.width, roi.height);
+    
+    // every fragment is blended, so both the nearest and the farthest surface are kept
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_MAX);
+    
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    
+    depthsShaderProgram->use();
+    depthsShaderProgram->setFloat("uZFar", zFar);
+    
+    for(int i = 0; i < models.size(); i++)
+    {
+        Model* model = models[i];
+        
+        if(model->isInitialized() || drawAll)
+        {
+            Matx44f pose = model->getPose();
+            Matx44f normalization = model->getNormalization();
+            
+            Matx44f modelViewMatrix = lookAtMatrix*(pose*normalization);
+            
+            Matx44f modelViewProjectionMatrix = roiProjectionMatrix*modelViewMatrix;
+            
+            depthsShaderProgram->setMat4("uMVMatrix", modelViewMatrix);
+            depthsShaderProgram->setMat4("uMVPMatrix", modelViewProjectionMatrix);
+            depthsShaderProgram->setFloat("uModelID", (float)model->getModelID());
+            
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            
+            model->draw(depthsShaderProgram);
+        }
+    }
+    
+    glBlendEquation(GL_FUNC_ADD);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    
+    glFlush();
+}
+
+
+void RenderingEngine::splitDepths(const Mat &depths, Mat &mask, Mat &depth, Mat &depthInv)
+{
+    mask.create(depths.rows, depths.cols, CV_8UC1);
+    depth.create(depths.rows, depths.cols, CV_32FC1);
+    depthInv.create(depths.rows, depths.cols, CV_32FC1);
+    
+    for(int y = 0; y < depths.rows; y++)
+    {
+        const Vec3f *src = depths.ptr<Vec3f>(y);
+        uchar *maskRow = mask.ptr<uchar>(y);
+        float *depthRow = depth.ptr<float>(y);
+        float *depthInvRow = depthInv.ptr<float>(y);
+        
+        for(int x = 0; x < depths.cols; x++)
+        {
+            // the front depth is stored as zFar minus the depth, such that the maximum is the nearest
+            depthRow[x] = src[x][0] > 0 ? zFar - src[x][0] : 0;
+            
+            depthInvRow[x] = src[x][1];
+            
+            maskRow[x] = (uchar)((int)src[x][2] & 0xff);
+        }
+    }
 }
 
 
@@ -505,28 +1241,187 @@ void RenderingEngine::projectBoundingBox(Model* model, std::vector<cv::Point2f>&
 
 Mat RenderingEngine::downloadFrame(RenderingEngine::FrameType type)
 {
+    RenderTarget &target = renderTargets[currentLevel];
+    
+    return readPixels((type == FRONT_BACK_DEPTH) ? target.depthsFrameBufferID : target.frameBufferID, type, roi.width, roi.height);
+}
+
+
+Mat RenderingEngine::readPixels(GLuint frameBufferID, RenderingEngine::FrameType type, int cols, int rows)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, frameBufferID);
+    
     Mat res;
     switch (type)
     {
         case MASK:
-            res = Mat(height, width, CV_8UC1);
+            res = Mat(rows, cols, CV_8UC1);
             glReadPixels(0, 0, res.cols, res.rows, GL_RED, GL_UNSIGNED_BYTE, res.data);
             break;
         case RGB:
-            res = Mat(height, width, CV_8UC3);
+            res = Mat(rows, cols, CV_8UC3);
             glReadPixels(0, 0, res.cols, res.rows, GL_RGB, GL_UNSIGNED_BYTE, res.data);
             break;
         case RGB_32F:
-            res = Mat(height, width, CV_32FC3);
+            res = Mat(rows, cols, CV_32FC3);
             glReadPixels(0, 0, res.cols, res.rows, GL_RGB, GL_FLOAT, res.data);
             break;
         case DEPTH:
-            res = Mat(height, width, CV_32FC1);
+            res = Mat(rows, cols, CV_32FC1);
             glReadPixels(0, 0, res.cols, res.rows, GL_DEPTH_COMPONENT, GL_FLOAT,  res.data);
             break;
+        case FRONT_BACK_DEPTH:
+            res = Mat(rows, cols, CV_32FC3);
+            glReadPixels(0, 0, res.cols, res.rows, GL_RGB, GL_FLOAT, res.data);
+            break;
+        case BGR:
+            res = Mat(rows, cols, CV_8UC3);
+            glReadPixels(0, 0, res.cols, res.rows, GL_BGR, GL_UNSIGNED_BYTE, res.data);
+            break;
+        case LINEAR_DEPTH:
+            glReadBuffer(GL_COLOR_ATTACHMENT1);
+            if(halfFloatDepth)
+            {
+                Mat half(rows, cols, CV_16FC1);
+                glReadPixels(0, 0, half.cols, half.rows, GL_RED, GL_HALF_FLOAT, half.data);
+                half.convertTo(res, CV_32F);
+            }
+            else
+            {
+                res = Mat(rows, cols, CV_32FC1);
+                glReadPixels(0, 0, res.cols, res.rows, GL_RED, GL_FLOAT, res.data);
+            }
+            glReadBuffer(GL_COLOR_ATTACHMENT0);
+            break;
         default:
-            res = Mat::zeros(height, width, CV_8UC1);
+            res = Mat::zeros(rows, cols, CV_8UC1);
             break;
     }
     return res;
 }
+
+
+// the OpenGL format, data type and OpenCV type of the downloaded data of a frame type
+static void pixelFormat(RenderingEngine::FrameType type, bool halfFloat, GLenum &format, GLenum &dataType, int &matType)
+{
+    switch (type)
+    {
+        case RenderingEngine::MASK:
+            format = GL_RED;
+            dataType = GL_UNSIGNED_BYTE;
+            matType = CV_8UC1;
+            break;
+        case RenderingEngine::RGB:
+            format = GL_RGB;
+            dataType = GL_UNSIGNED_BYTE;
+            matType = CV_8UC3;
+            break;
+        case RenderingEngine::BGR:
+            format = GL_BGR;
+            dataType = GL_UNSIGNED_BYTE;
+            matType = CV_8UC3;
+            break;
+        case RenderingEngine::RGB_32F:
+        case RenderingEngine::FRONT_BACK_DEPTH:
+            format = GL_RGB;
+            dataType = GL_FLOAT;
+            matType = CV_32FC3;
+            break;
+        case RenderingEngine::LINEAR_DEPTH:
+            format = GL_RED;
+            dataType = halfFloat ? GL_HALF_FLOAT : GL_FLOAT;
+            matType = halfFloat ? CV_16FC1 : CV_32FC1;
+            break;
+        default:
+            format = GL_DEPTH_COMPONENT;
+            dataType = GL_FLOAT;
+            matType = CV_32FC1;
+            break;
+    }
+}
+
+
+int RenderingEngine::requestFrame(RenderingEngine::FrameType type)
+{
+    int request = 0;
+    while(request < readbackBuffers.size() && readbackBuffers[request].pending)
+    {
+        request++;
+    }
+    if(request == readbackBuffers.size())
+    {
+        ReadbackBuffer readbackBuffer;
+        glGenBuffers(1, &readbackBuffer.bufferID);
+        readbackBuffer.capacity = 0;
+        readbackBuffer.pending = false;
+        readbackBuffers.push_back(readbackBuffer);
+    }
+    ReadbackBuffer &readbackBuffer = readbackBuffers[request];
+    
+    GLenum format, dataType;
+    int matType;
+    pixelFormat(type, halfFloatDepth, format, dataType, matType);
+    
+    size_t size = (size_t)roi.width*roi.height*CV_ELEM_SIZE(matType);
+    
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer.bufferID);
+    if(size > readbackBuffer.capacity)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        readbackBuffer.capacity = size;
+    }
+    
+    // with a pixel pack buffer bound this only queues the copy
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, (type == FRONT_BACK_DEPTH) ? renderTargets[currentLevel].depthsFrameBufferID : renderTargets[currentLevel].frameBufferID);
+    if(type == LINEAR_DEPTH)
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glReadPixels(0, 0, roi.width, roi.height, format, dataType, 0);
+    if(type == LINEAR_DEPTH)
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    
+    readbackBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readbackBuffer.matType = matType;
+    readbackBuffer.width = roi.width;
+    readbackBuffer.height = roi.height;
+    readbackBuffer.pending = true;
+    
+    return request;
+}
+
+
+bool RenderingEngine::isFrameReady(int request)
+{
+    GLenum status = glClientWaitSync(readbackBuffers[request].fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+
+void RenderingEngine::fetchFrame(int request, cv::Mat &frame)
+{
+    ReadbackBuffer &readbackBuffer = readbackBuffers[request];
+    
+    // the first wait flushes the commands, such that the fence is signaled eventually
+    GLenum status = glClientWaitSync(readbackBuffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    while(status == GL_TIMEOUT_EXPIRED)
+    {
+        status = glClientWaitSync(readbackBuffer.fence, 0, 1000000000);
+    }
+    glDeleteSync(readbackBuffer.fence);
+    readbackBuffer.pending = false;
+    
+    int matType = readbackBuffer.matType;
+    bool halfFloat = CV_MAT_DEPTH(matType) == CV_16F;
+    
+    frame.create(readbackBuffer.height, readbackBuffer.width, halfFloat ? CV_32FC1 : matType);
+    
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer.bufferID);
+    void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame.total()*CV_ELEM_SIZE(matType), GL_MAP_READ_BIT);
+    if(status != GL_WAIT_FAILED && data != NULL)
+        Mat(frame.rows, frame.cols, matType, data).convertTo(frame, frame.type());
+    else
+        frame.setTo(Scalar::all(0));
+    if(data != NULL)
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
@@ -39,7 +39,6 @@
 #include <iostream>
 
 #include "glad/glad.h"
-#include <GLFW/glfw3.h>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
@@ -47,14 +46,33 @@
 #include "transformations.h"
 #include "model.h"
 #include "shader.h"
+#include "pixel_layout.h"
+
+// the OpenGL context of the backend selected at compile time, see rendering_engine.cpp
+struct OffscreenContext;
 
 /**
  *  This class implements an OpenGL-based offscreen rendering engine for generating
  *  images of projected 3D meshes based on given object poses and camera instrinsics.
  *  It supports one or mutiple objects to be rendered as binary masks, depth maps,
  *  normal maps or phong-shaded. It also allows to perform all renderings according
- *  to a specified image pyramid level at lower resolutions. The class is  implemented
- *  as a singleton.
+ *  to a specified image pyramid level at lower resolutions. Every engine is a
+ *  separate render context with its own frame buffers, calibration, pyramid
+ *  level and region of interest, such that e.g. the pose estimator, the
+ *  optimization engine and the template generation do not change each other's
+ *  state. An engine either creates its own OpenGL context, which is needed to
+ *  render on several threads at once (e.g. one per tracking session), or
+ *  renders with the context of another engine on the same thread.
+ *
+ *  All renderings go into frame buffer objects, one set per pyramid level, so
+ *  the renderings of different levels do not overwrite each other and the
+ *  OpenGL context does not need a window of the image size. By default it is
+ *  created with GLFW as a tiny hidden window,
+ *  which requires a display. For headless machines the context can instead be
+ *  created through EGL (surfaceless if supported, otherwise with a tiny
+ *  pbuffer) by defining RBOT_GL_BACKEND_EGL and linking against libEGL, or
+ *  through Mesa's OSMesa by defining RBOT_GL_BACKEND_OSMESA and linking
+ *  against libOSMesa. With Mesa's llvmpipe driver neither needs a GPU.
  */
 class RenderingEngine
 {
@@ -63,21 +81,39 @@ public:
         MASK,
         RGB,
         RGB_32F,
-        DEPTH
+        DEPTH,
+        FRONT_BACK_DEPTH,
+        LINEAR_DEPTH,
+        BGR
     };
     
+    /**
+     *  Creates a rendering engine with its own OpenGL context, which is left
+     *  current on the calling thread. If the context or the OpenGL functions
+     *  can not be loaded, the engine is not valid (see isValid).
+     */
     RenderingEngine(void);
     
-    ~RenderingEngine(void);
+    /**
+     *  Creates a rendering engine that renders with the OpenGL context of
+     *  another engine, but has its own frame buffers and pixel buffer objects
+     *  as well as its own calibration, pyramid level and region of interest.
+     *  It uses the same depth format as the other engine at the time of its
+     *  creation. Both may only be used on the thread the context is current
+     *  on and this engine must be deleted before the other one.
+     *
+     *  @param  sharedEngine The engine whose OpenGL context is used.
+     */
+    RenderingEngine(RenderingEngine *sharedEngine);
     
-    static RenderingEngine *Instance(void)
-    {
-        if (instance == NULL) instance = new RenderingEngine();
-        return instance;
-    }
+    /**
+     *  Deletes the buffers and shaders of the rendering engine and destroys
+     *  its OpenGL context if it has created one. The context must be current.
+     */
+    ~RenderingEngine(void);
     
     /**
-     *  Initializes the rendering engine instance given a 3x3 float
+     *  Initializes the rendering engine given a 3x3 float
      *  intrinsic camera matrix
      *  K = [fx 0 cx]
      *      [0 fy cy]
@@ -94,6 +130,29 @@ public:
      */
     void init(const cv::Matx33f &K, int width, int height, float zNear, float zFar, int numLevels);
     
+    /**
+     *  Returns whether the engine has an OpenGL context, i.e. whether creating
+     *  it succeeded. An engine that is not valid can not be initialized or used
+     *  for rendering, it can only be deleted.
+     *
+     *  @return  True if the engine has an OpenGL context and false otherwise.
+     */
+    bool isValid();
+    
+    /**
+     *  Replaces the intrinsic camera matrix and the image resolution at level 0
+     *  after initialization, e.g. when the camera frames are cropped or scaled.
+     *  The projection and the calibration matrices of all pyramid levels are
+     *  updated accordingly, the current pyramid level is kept. The frame buffers
+     *  are enlarged if the resolution exceeds the one they have been created
+     *  for, in which case the OpenGL context must be current.
+     *
+     *  @param  K The intrinsic camera matrix of the (cropped or scaled) camera frame.
+     *  @param  width The width in pixels of the rendered images at level 0.
+     *  @param  height The height in pixels of the rendered images at level 0.
+     */
+    void setCalibration(const cv::Matx33f &K, int width, int height);
+    
     /**
      *  Returns the number of supported pyramid levels for rendering.
      *
@@ -103,7 +162,9 @@ public:
     
     /**
      *  Sets a pyramid level to be used for rendering between 0 (full resolution)
-     *  and getNumLevels() (the smallest resolution).
+     *  and getNumLevels() (the smallest resolution). Every level renders into
+     *  frame buffers of its own, which keep their last rendering until it is
+     *  rendered to again at that level.
      *
      *  @param level The pyramid level to be used for rendering.
      */
@@ -117,38 +178,76 @@ public:
     int getLevel();
     
     /**
-     *  Activates the OpenGL context of the rendering engine.
+     *  Restricts rendering and downloading to a 2D region of interest of the
+     *  current pyramid level. The projection is adjusted such that only the
+     *  region is rasterized, into the bottom left corner of the frame buffer,
+     *  and the downloaded images only contain the region. Setting the pyramid
+     *  level resets the region to the whole image.
+     *
+     *  @param roi The region in pixels of the current pyramid level, it is clipped to the image.
      */
-    void makeCurrent();
+    void setROI(const cv::Rect &roi);
     
     /**
-     *  Deactivates the OpenGL context of the rendering engine.
+     *  Returns the region of interest used for rendering.
+     *
+     *  @return  The region of interest used for rendering.
      */
-    void doneCurrent();
+    cv::Rect getROI();
     
     /**
-     *  Returns the OpenGL context of the rendering engine.
+     *  Selects whether the linear depth map (see LINEAR_DEPTH) is rendered into
+     *  a 16 bit half float target instead of a 32 bit float target, which halves
+     *  the amount of data downloaded, with a relative precision of about 0.05%.
+     *  The OpenGL context of the engine must be current.
      *
-     *  @return  The OpenGL context of the rendering engine.
+     *  @param halfFloat Whether to use a half float target for the linear depth map.
+     */
+    void setHalfFloatDepth(bool halfFloat);
+    
+    /**
+     *  Returns whether the linear depth map is rendered into a half float target.
+     *
+     *  @return  True if the linear depth map is rendered into a half float target and false otherwise.
+     */
+    bool isHalfFloatDepth();
+    
+    /**
+     *  Releases the resources of the OpenGL backend shared by all rendering
+     *  engines. Must be called on the main thread after all engines have been
+     *  destroyed.
+     */
+    static void terminate();
+    
+    /**
+     *  Activates the OpenGL context of the rendering engine.
+     */
+    void makeCurrent();
+    
+    /**
+     *  Deactivates the OpenGL context of the rendering engine.
      */
-    GLFWwindow *getContext();
+    void doneCurrent();
     
     /**
-     *  Returns the OpenGL ID of the frame buffer object used for offscreen rendering.
+     *  Returns the OpenGL ID of the frame buffer object used for offscreen rendering
+     *  at the current pyramid level.
      *
      *  @return  The OpenGL ID of the frame buffer object used for offscreen rendering.
      */
     GLuint getFrameBufferID();
     
     /**
-     *  Returns the OpenGL texture ID of the rendered color image.
+     *  Returns the OpenGL texture ID of the rendered color image at the current
+     *  pyramid level. The image is in its bottom left corner, the texture can be larger.
      *
      *  @return  The OpenGL texture ID of the rendered color image.
      */
     GLuint getColorTextureID();
     
     /**
-     *  Returns the OpenGL texture ID of the rendered depth buffer.
+     *  Returns the OpenGL texture ID of the rendered depth buffer at the current
+     *  pyramid level. The image is in its bottom left corner, the texture can be larger.
      *
      *  @return  The OpenGL texture ID of the rendered depth buffer.
      */
@@ -223,6 +322,8 @@ public:
      *  in order to obtain a their binary silhouette masks with correct occlusions
      *  according to their current poses. If no colors are spefified each model will by default
      *  get rendered with a constant color corresponding to their model index in the red channel.
+     *  The linear depth map (see LINEAR_DEPTH) of the visible surfaces, or of the back surfaces
+     *  if the depth test is inverted, is rendered alongside.
      *
      *  @param model The models to be rendered.
      *  @param polyonMode The OpenGL polygon mode to be used (e.g. GL_FILL).
@@ -242,6 +343,22 @@ public:
      */
     void renderShaded(std::vector<Model*> models, GLenum polyonMode, const std::vector<cv::Point3f> &colors = std::vector<cv::Point3f>(), bool drawAll = false);
     
+    /**
+     *  Renders multiple models in a common scene wrt their current poses using Phong shading
+     *  on top of a camera frame, e.g. for visualizing the tracking results. The frame is
+     *  uploaded into a texture and drawn as the background, such that each of its pixels
+     *  lies at the same image pixel as in the current pyramid level. The models are blended
+     *  with it according to their opacity. Download the result with the frame type BGR.
+     *
+     *  @param models The models to be rendered.
+     *  @param frame The camera frame at the resolution of the current pyramid level (3 or 4 channels, uchar).
+     *  @param format The channel order of the frame, FRAME_FORMAT_BGR or FRAME_FORMAT_RGB.
+     *  @param colors A vector of colors to be used for each model (default = empty).
+     *  @param alpha The opacity of the models in [0, 1] (default = 1.0).
+     *  @param drawAll Whether to draw the model even if it has not yet been initlaized for tracking (default = false).
+     */
+    void renderOverlay(std::vector<Model*> models, const cv::Mat &frame, FrameFormat format, const std::vector<cv::Point3f> &colors = std::vector<cv::Point3f>(), float alpha = 1.0f, bool drawAll = false);
+    
     /**
      *  Renders the per pixel surface normals of multiple models in a common scene wrt their
      *  current poses where the normal direction is mapped from (x, y, z) in [-1, 1] to (r, g, b)
@@ -253,6 +370,32 @@ public:
      */
     void renderNormals(std::vector<Model*> models, GLenum polyonMode, bool drawAll = false);
     
+    /**
+     *  Renders multiple models in a common scene in a single pass that yields
+     *  their silhouette mask, the linear depth map of their front surfaces and
+     *  the linear depth map of their back surfaces (i.e. the one obtained with
+     *  an inverted depth test). The result is downloaded with the frame type
+     *  FRONT_BACK_DEPTH and separated with splitDepths. Where the silhouettes
+     *  of several models overlap, the back depth is that of the farthest
+     *  model, so it only equals the back depth of a single model where no
+     *  other model is rendered.
+     *
+     *  @param models The models to be rendered, each with its model ID in the mask.
+     *  @param drawAll Whether to draw all models even if they been not yet initlaized for tracking (default = false).
+     */
+    void renderDepths(std::vector<Model*> models, bool drawAll = false);
+    
+    /**
+     *  Separates an image downloaded after renderDepths with the frame type
+     *  FRONT_BACK_DEPTH into images of the frame types MASK and LINEAR_DEPTH.
+     *
+     *  @param depths The downloaded image.
+     *  @param mask The silhouette mask containing the model IDs.
+     *  @param depth The linear depth map of the front surfaces.
+     *  @param depthInv The linear depth map of the back surfaces.
+     */
+    void splitDepths(const cv::Mat &depths, cv::Mat &mask, cv::Mat &depth, cv::Mat &depthInv);
+    
     /**
      *  Projects the eight corners of a model's bouding box into the image and computes the
      *  enclosing 2D bounding rect of these projections wrt the model's poae.
@@ -267,8 +410,12 @@ public:
      *  Downloads the most recently rendered image from the GPU to the host memory and converts
      *  it to an OpenCV image depending on a given frametype. Use MASK to obtain a silhouette
      *  mask image (single channel, uchar), RGB to obtain a color image (RGB, uchar), RGB_32F
-     *  to obtain color image with normalized intensities in [0, 1] (RGB, float) or DEPTH to
-     *  obtain the depth buffer.
+     *  to obtain color image with normalized intensities in [0, 1] (RGB, float), DEPTH to
+     *  obtain the depth buffer, LINEAR_DEPTH to obtain the Z-distance to the camera per pixel
+     *  written by renderSilhouette (single channel, float, 0 where no model has been rendered),
+     *  FRONT_BACK_DEPTH to obtain the result of renderDepths or BGR to obtain a color image in
+     *  the channel order of OpenCV (BGR, uchar). Only the current region of interest is
+     *  downloaded.
      *
      *  @param type The frame type to be downloaded and returned (e.g. MASK, RGB, RGB32F or DEPTH).
      *
@@ -277,14 +424,70 @@ public:
     cv::Mat downloadFrame(RenderingEngine::FrameType type);
     
     /**
-     *  Destroys and deletes the current rendering engine singleton instance.
+     *  Starts downloading the most recently rendered image into a pixel buffer
+     *  object without waiting for the rendering to finish. The image can be
+     *  rendered over afterwards, so the next rendering and any work on the CPU
+     *  overlap the transfer. Every request has to be completed with fetchFrame.
+     *
+     *  @param type The frame type to be downloaded (e.g. MASK, RGB, RGB32F or DEPTH).
+     *
+     *  @return  The ID of the request.
+     */
+    int requestFrame(RenderingEngine::FrameType type);
+    
+    /**
+     *  Returns whether the download of a requested image has finished, such
+     *  that fetchFrame will not block.
+     *
+     *  @param request The ID returned by requestFrame.
+     *
+     *  @return  True if the image can be fetched without waiting and false otherwise.
      */
-    void destroy();
+    bool isFrameReady(int request);
+    
+    /**
+     *  Waits for a requested image and copies it into an OpenCV image of the
+     *  same format as returned by downloadFrame.
+     *
+     *  @param request The ID returned by requestFrame.
+     *  @param frame The downloaded image, its memory is reused if it has the size and type of the image.
+     */
+    void fetchFrame(int request, cv::Mat &frame);
+    
+    /**
+     *  Renders a model in many poses at once into an atlas texture, e.g. for
+     *  generating the templates of the pose estimation. Every pose is rendered
+     *  into a tile of the atlas of the size of its region, with the projection
+     *  of the current pyramid level cropped to the region, i.e. exactly like
+     *  renderSilhouette with the region set as the region of interest. The
+     *  tiles are packed starting with the pose at index first until the atlas
+     *  is full, regions larger than the atlas are cut off at their bottom and
+     *  right. The model is rendered in white, the linear depth map (see
+     *  LINEAR_DEPTH) is rendered alongside. Download the atlas with
+     *  downloadAtlas and crop the tiles from it.
+     *
+     *  @param model The model to be rendered.
+     *  @param poses The poses of the model.
+     *  @param regions The region of each pose in pixels of the current pyramid level.
+     *  @param first The index of the first pose to be rendered.
+     *  @param tiles The resulting tiles of the rendered poses in the downloaded atlas.
+     *
+     *  @return  The number of rendered poses, i.e. the number of tiles.
+     */
+    int renderSilhouetteAtlas(Model *model, const std::vector<cv::Matx44f> &poses, const std::vector<cv::Rect> &regions, int first, std::vector<cv::Rect> &tiles);
+    
+    /**
+     *  Downloads the part of the atlas covered by the tiles of the most recent
+     *  renderSilhouetteAtlas in the format of downloadFrame.
+     *
+     *  @param type The frame type to be downloaded (MASK, RGB, DEPTH or LINEAR_DEPTH).
+     *
+     *  @return  The downloaded atlas.
+     */
+    cv::Mat downloadAtlas(RenderingEngine::FrameType type);
 
     
 private:
-    static RenderingEngine *instance;
-    
     int width;
     int height;
     
@@ -300,13 +503,46 @@ private:
     
     std::vector<cv::Matx44f> calibrationMatrices;
     cv::Matx44f projectionMatrix;
+    
+    cv::Rect roi;
+    
+    // the projection matrix mapping the region of interest to the whole viewport
+    cv::Matx44f roiProjectionMatrix;
     cv::Matx44f lookAtMatrix;
     
-    GLFWwindow *offscreen_context;
+    OffscreenContext *offscreen_context;
     
-    GLuint frameBufferID;
-    GLuint colorTextureID;
-    GLuint depthTextureID;
+    // whether the context has been created by this engine or belongs to another one
+    bool ownsContext;
+    
+    // the frame buffers of a pyramid level, they are only ever enlarged
+    struct RenderTarget
+    {
+        int width;
+        int height;
+        
+        GLuint frameBufferID;
+        GLuint colorTextureID;
+        GLuint depthTextureID;
+        
+        // the second color attachment of the frame buffer, written by the silhouette shader
+        GLuint linearDepthTextureID;
+        
+        // the target of renderDepths
+        GLuint depthsFrameBufferID;
+        GLuint depthsTextureID;
+    };
+    
+    // one per pyramid level, created by init
+    std::vector<RenderTarget> renderTargets;
+    
+    // the target of renderSilhouetteAtlas without a depths frame buffer, created on first use
+    RenderTarget atlas;
+    
+    // the part of the atlas covered by the tiles of the last rendering
+    cv::Size atlasSize;
+    
+    bool halfFloatDepth;
     
     int angle;
     
@@ -316,11 +552,56 @@ private:
     Shader *silhouetteShaderProgram;
     Shader *phongblinnShaderProgram;
     Shader *normalsShaderProgram;
+    Shader *depthsShaderProgram;
+    Shader *overlayShaderProgram;
+    
+    // the camera frame drawn by renderOverlay
+    GLuint frameTextureID;
+    cv::Size frameTextureSize;
+    
+    // the overlay is drawn without vertex buffers, but the core profile needs a vertex array object
+    GLuint overlayVertexArrayID;
+    
+    // a pixel buffer object the rendered image is downloaded into asynchronously
+    struct ReadbackBuffer
+    {
+        GLuint bufferID;
+        size_t capacity;
+        
+        // signaled once the download has finished
+        GLsync fence;
+        
+        // the type of the downloaded data, half floats are converted when fetched
+        int matType;
+        int width;
+        int height;
+        
+        bool pending;
+    };
+    
+    // grows to the largest number of simultaneously pending requests
+    std::vector<ReadbackBuffer> readbackBuffers;
+    
+    void initMembers();
+    
+    cv::Size levelSize(int level);
     
     bool initRenderingBuffers();
     
+    bool initRenderTarget(RenderTarget &target, int width, int height, bool withDepths);
+    
+    void resizeRenderTarget(RenderTarget &target, int width, int height);
+    
+    void deleteRenderTarget(RenderTarget &target);
+    
+    cv::Matx44f cropMatrix(const cv::Rect &region);
+    
+    cv::Mat readPixels(GLuint frameBufferID, RenderingEngine::FrameType type, int cols, int rows);
+    
     bool initShaderProgram(GLuint program, std::string shaderName);
     
+    void drawShaded(std::vector<Model*> &models, GLenum polyonMode, const std::vector<cv::Point3f> &colors, float alpha, bool drawAll);
+    
 };
 
 
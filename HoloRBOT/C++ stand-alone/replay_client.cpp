@@ -0,0 +1,298 @@
+/**
+ *  Replay client for the tracking server: streams a recorded image sequence
+ *  or video (anything cv::VideoCapture can open, e.g. "frames/%04d.png"),
+ *  or synthetic frames, over the same protocol as the HoloLens app and
+ *  measures the end-to-end throughput of the server.
+ *
+ *  Frames are sent at a fixed rate, as fast as possible (--fps 0) or one at
+ *  a time waiting for each reply (--lockstep). At the end the achieved
+ *  frame rate, the p50/p95/p99 frame-to-pose latency and the number of
+ *  frames the server dropped are reported. With --min-fps or --max-p95 the
+ *  exit code tells whether the server met the given throughput, such that
+ *  regressions can be caught by a script.
+ *
+ *  Synthetic frames are drawn while sending. Of a recorded sequence only
+ *  the first --preload-mb megabytes are loaded upfront, the rest is read
+ *  while sending, which may limit the rate.
+ *
+ *  usage: replay_client [--host h] [--port n] [--fps n] [--lockstep] [--codec raw|jpeg|png]
+ *                       [--frames n] [--preload-mb n] [--display-offset ms] [--min-fps n] [--max-p95 ms] [source]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "tracking_client.h"
+
+using namespace std;
+using namespace cv;
+
+static int64_t now()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double percentile(vector<double> &values, double p)
+{
+    if(values.empty())
+        return 0;
+    
+    sort(values.begin(), values.end());
+    return values[min((size_t)(p*values.size()), values.size() - 1)];
+}
+
+// the frames are produced while sending, only the beginning of a recorded sequence is kept in memory
+struct FrameSource
+{
+    VideoCapture capture;
+    
+    // loaded upfront, such that reading them does not limit the rate
+    vector<Mat> preloaded;
+    
+    // the background of the synthetic frames, if no sequence is replayed
+    Mat background;
+    
+    // the buffer the frames read from the capture or drawn are written into
+    Mat buffer;
+    
+    int numFrames;
+    int next;
+};
+
+static bool openFrames(const string &source, int maxFrames, size_t maxPreloadBytes, FrameSource &frames)
+{
+    frames.numFrames = maxFrames;
+    frames.next = 0;
+    
+    if(source.empty())
+    {
+        // an object moving in front of a textured background, at the HoloLens camera resolution
+        frames.background = Mat(792, 1408, CV_8UC3);
+        randu(frames.background, Scalar::all(0), Scalar::all(255));
+        GaussianBlur(frames.background, frames.background, Size(15, 15), 0);
+        return true;
+    }
+    
+    if(!frames.capture.open(source))
+    {
+        cout << "Could not open the image sequence: \"" << source << "\"" << endl;
+        return false;
+    }
+    
+    // the rest of the sequence is read while sending
+    size_t preloadBytes = 0;
+    Mat frame;
+    while(frames.preloaded.size() < maxFrames && preloadBytes < maxPreloadBytes && frames.capture.read(frame))
+    {
+        frames.preloaded.push_back(frame.clone());
+        preloadBytes += frame.total()*frame.elemSize();
+    }
+    return !frames.preloaded.empty();
+}
+
+static bool nextFrame(FrameSource &frames, Mat &frame)
+{
+    if(frames.next >= frames.numFrames)
+        return false;
+    
+    int i = frames.next++;
+    if(i < frames.preloaded.size())
+    {
+        frame = frames.preloaded[i];
+        return true;
+    }
+    
+    if(frames.capture.isOpened())
+    {
+        if(!frames.capture.read(frames.buffer))
+            return false;
+    }
+    else
+    {
+        frames.background.copyTo(frames.buffer);
+        int x = 500 + (int)(200*sin(i*0.05));
+        rectangle(frames.buffer, Rect(x, 300, 200, 200), Scalar(40, 120, 220), FILLED);
+    }
+    
+    frame = frames.buffer;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    string host = "127.0.0.1";
+    int port = 27015;
+    double fps = 30.0;
+    bool lockstep = false;
+    string codecName = "jpeg";
+    int maxFrames = 300;
+    int maxPreloadMB = 256;
+    int64_t displayOffset = 0;
+    double minFPS = 0;
+    double maxP95 = 0;
+    string source;
+    
+    for(int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        
+        if(option == "--lockstep")
+            lockstep = true;
+        else if(option == "--host" && hasValue)
+            host = argv[++i];
+        else if(option == "--port" && hasValue)
+            port = atoi(argv[++i]);
+        else if(option == "--fps" && hasValue)
+            fps = atof(argv[++i]);
+        else if(option == "--codec" && hasValue)
+            codecName = argv[++i];
+        else if(option == "--frames" && hasValue)
+            maxFrames = atoi(argv[++i]);
+        else if(option == "--preload-mb" && hasValue)
+            maxPreloadMB = max(atoi(argv[++i]), 0);
+        else if(option == "--display-offset" && hasValue)
+            displayOffset = atoi(argv[++i])*1000;
+        else if(option == "--min-fps" && hasValue)
+            minFPS = atof(argv[++i]);
+        else if(option == "--max-p95" && hasValue)
+            maxP95 = atof(argv[++i]);
+        else if(option.compare(0, 2, "--") != 0)
+            source = option;
+        else
+        {
+            cout << "unknown option or missing value: " << option << endl;
+            return -1;
+        }
+    }
+    
+    uint32_t codecs = 1 << FRAME_CODEC_RAW;
+    if(codecName == "jpeg")
+        codecs = 1 << FRAME_CODEC_JPEG;
+    else if(codecName == "png")
+        codecs = 1 << FRAME_CODEC_PNG;
+    
+    FrameSource frames;
+    if(!openFrames(source, maxFrames, (size_t)maxPreloadMB << 20, frames))
+        return -1;
+    
+    Mat frame;
+    if(!nextFrame(frames, frame))
+        return -1;
+    
+    TrackingClient client;
+    boost::system::error_code error;
+    if(!client.connect(host, port, codecs, error) || !client.sendCommand(COMMAND_START_TRACKING, -1, error))
+    {
+        cout << "connecting failed: " << error.message() << endl;
+        return -1;
+    }
+    
+    cout << "replaying up to " << maxFrames << " frames of " << frame.cols << "x" << frame.rows << " (" << codecName << ") ";
+    if(lockstep)
+        cout << "in lockstep" << endl;
+    else if(fps > 0)
+        cout << "at " << fps << " fps" << endl;
+    else
+        cout << "as fast as possible" << endl;
+    
+    // the receiving thread measures the latency and wakes up the sender in lockstep mode
+    vector<double> latencies;
+    uint32_t lastReplyID = 0;
+    atomic<uint64_t> numReplies(0);
+    mutex replyMutex;
+    condition_variable replyReceived;
+    
+    thread receiver([&]()
+    {
+        CropRequest request;
+        PoseReply reply;
+        vector<ObjectPose> poses;
+        boost::system::error_code error;
+        while(client.receiveReply(request, reply, poses, error))
+        {
+            lock_guard<mutex> lock(replyMutex);
+            latencies.push_back((now() - (int64_t)reply.captureTimestamp)/1000.0);
+            lastReplyID = reply.frameID;
+            numReplies++;
+            replyReceived.notify_one();
+        }
+        replyReceived.notify_one();
+    });
+    
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::duration period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>((fps > 0) ? 1.0/fps : 0.0));
+    uint32_t numSent = 0;
+    for(uint32_t frameID = 0; !frame.empty(); frameID++)
+    {
+        int64_t timestamp = now();
+        if(!client.sendFrame(frame, frameID, timestamp, (displayOffset > 0) ? timestamp + displayOffset : 0, error))
+        {
+            cout << "sending failed: " << error.message() << endl;
+            break;
+        }
+        numSent++;
+        
+        // prepared while waiting for the next frame to be due
+        if(!nextFrame(frames, frame))
+            frame.release();
+        
+        if(lockstep)
+        {
+            unique_lock<mutex> lock(replyMutex);
+            if(!replyReceived.wait_for(lock, chrono::seconds(5), [&]()
+            {
+                return numReplies > 0 && lastReplyID == frameID;
+            }))
+            {
+                cout << "no reply for frame " << frameID << endl;
+                break;
+            }
+        }
+        else if(fps > 0)
+            this_thread::sleep_until(start + period*(frameID + 1));
+    }
+    
+    // wait for the replies to the last frames
+    {
+        unique_lock<mutex> lock(replyMutex);
+        replyReceived.wait_for(lock, chrono::seconds(1), [&]()
+        {
+            return numReplies > 0 && lastReplyID + 1 == numSent;
+        });
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    client.close();
+    receiver.join();
+    
+    double achievedFPS = numReplies/seconds;
+    double p95 = percentile(latencies, 0.95);
+    cout << "sent " << numSent << " frames, received " << numReplies << " poses, dropped " << numSent - numReplies << endl;
+    cout << "achieved " << achievedFPS << " fps, latency p50 " << percentile(latencies, 0.5) << " ms, p95 " << p95 << " ms, p99 " << percentile(latencies, 0.99) << " ms" << endl;
+    
+    bool passed = true;
+    if(minFPS > 0 && achievedFPS < minFPS)
+    {
+        cout << "FAILED: frame rate below " << minFPS << " fps" << endl;
+        passed = false;
+    }
+    if(maxP95 > 0 && p95 > maxP95)
+    {
+        cout << "FAILED: p95 latency above " << maxP95 << " ms" << endl;
+        passed = false;
+    }
+    
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+#include "session_log.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+using namespace cv;
+
+SessionLogReader::SessionLogReader()
+{
+    memset(&header, 0, sizeof(SessionLogHeader));
+    
+    complete = false;
+    end = 0;
+}
+
+
+SessionLogReader::~SessionLogReader()
+{
+    
+}
+
+
+bool SessionLogReader::open(const std::string &filename)
+{
+    file.open(filename, ios::binary);
+    if(!file.is_open())
+    {
+        cout << "Could not open the session log: \"" << filename << "\"" << endl;
+        return false;
+    }
+    
+    file.seekg(0, ios::end);
+    uint64_t size = file.tellg();
+    file.seekg(0);
+    
+    if(!file.read((char*)&header, sizeof(SessionLogHeader)) || header.magic != SESSION_LOG_MAGIC || header.version != SESSION_LOG_VERSION)
+    {
+        cout << "\"" << filename << "\" is not a compatible session log" << endl;
+        return false;
+    }
+    
+    complete = readIndex(size);
+    if(!complete)
+        rebuildIndex(size);
+    
+    seek(sizeof(SessionLogHeader));
+    
+    return true;
+}
+
+
+bool SessionLogReader::readIndex(uint64_t size)
+{
+    SessionLogTrailer trailer;
+    if(size < sizeof(SessionLogHeader) + sizeof(LogRecordHeader) + sizeof(SessionLogTrailer))
+        return false;
+    
+    file.seekg(size - sizeof(SessionLogTrailer));
+    if(!file.read((char*)&trailer, sizeof(SessionLogTrailer)) || trailer.magic != SESSION_LOG_MAGIC || trailer.indexOffset >= size)
+        return false;
+    
+    LogRecordHeader recordHeader;
+    file.seekg(trailer.indexOffset);
+    if(!file.read((char*)&recordHeader, sizeof(LogRecordHeader)) || recordHeader.type != LOG_RECORD_INDEX)
+        return false;
+    
+    index.resize(recordHeader.length/sizeof(LogIndexEntry));
+    if(!file.read((char*)index.data(), index.size()*sizeof(LogIndexEntry)))
+    {
+        index.clear();
+        return false;
+    }
+    
+    end = trailer.indexOffset;
+    
+    return true;
+}
+
+
+void SessionLogReader::rebuildIndex(uint64_t size)
+{
+    index.clear();
+    
+    // a record cut off by a crash ends the log
+    uint64_t offset = sizeof(SessionLogHeader);
+    LogRecordHeader recordHeader;
+    LogFrame frame;
+    while(offset + sizeof(LogRecordHeader) <= size)
+    {
+        file.seekg(offset);
+        if(!file.read((char*)&recordHeader, sizeof(LogRecordHeader)) || offset + sizeof(LogRecordHeader) + recordHeader.length > size)
+            break;
+        
+        if(recordHeader.type == LOG_RECORD_FRAME && recordHeader.length >= sizeof(LogFrame))
+        {
+            file.read((char*)&frame, sizeof(LogFrame));
+            
+            LogIndexEntry entry = {offset, frame.frameID, frame.captureTimestamp};
+            index.push_back(entry);
+        }
+        offset += sizeof(LogRecordHeader) + recordHeader.length;
+    }
+    
+    end = offset;
+    file.clear();
+}
+
+
+bool SessionLogReader::readRecord(LogRecordHeader &recordHeader, std::vector<uchar> &data)
+{
+    uint64_t offset = file.tellg();
+    if(!file || offset + sizeof(LogRecordHeader) > end)
+        return false;
+    
+    if(!file.read((char*)&recordHeader, sizeof(LogRecordHeader)) || offset + sizeof(LogRecordHeader) + recordHeader.length > end)
+        return false;
+    
+    data.resize(recordHeader.length);
+    return (bool)file.read((char*)data.data(), recordHeader.length);
+}
+
+
+void SessionLogReader::seek(uint64_t offset)
+{
+    file.clear();
+    file.seekg(offset);
+}
+
+
+const std::vector<LogIndexEntry>& SessionLogReader::getIndex()
+{
+    return index;
+}
+
+
+bool SessionLogReader::isComplete()
+{
+    return complete;
+}
+
+
+const SessionLogHeader& SessionLogReader::getHeader()
+{
+    return header;
+}
+
+
+bool SessionLogReader::decodeFrame(const std::vector<uchar> &data, LogFrame &frame, cv::Mat &image)
+{
+    if(data.size() <= sizeof(LogFrame))
+        return false;
+    
+    memcpy(&frame, data.data(), sizeof(LogFrame));
+    
+    Mat encoded(1, (int)(data.size() - sizeof(LogFrame)), CV_8UC1, const_cast<uchar*>(data.data()) + sizeof(LogFrame));
+    Mat decoded = imdecode(encoded, IMREAD_UNCHANGED);
+    if(decoded.empty())
+        return false;
+    
+    // the pairs of YUYV frames have been stored as 4 channel pixels
+    if(frame.pixelFormat == PIXEL_FORMAT_YUYV)
+        decoded = decoded.reshape(2);
+    
+    int rows = (frame.pixelFormat == PIXEL_FORMAT_NV12) ? frame.height*3/2 : frame.height;
+    if(decoded.cols != frame.width || decoded.rows != rows)
+        return false;
+    
+    image = decoded;
+    
+    return true;
+}
+
+
+bool SessionLogReader::decodePoses(const std::vector<uchar> &data, LogPoses &poses, std::vector<ObjectPose> &objectPoses)
+{
+    if(data.size() < sizeof(LogPoses))
+        return false;
+    
+    memcpy(&poses, data.data(), sizeof(LogPoses));
+    if(data.size() != sizeof(LogPoses) + poses.numObjects*sizeof(ObjectPose))
+        return false;
+    
+    objectPoses.resize(poses.numObjects);
+    memcpy(objectPoses.data(), data.data() + sizeof(LogPoses), poses.numObjects*sizeof(ObjectPose));
+    
+    return true;
+}
@@ -0,0 +1,246 @@
+#ifndef SESSION_LOG_H
+#define SESSION_LOG_H
+
+#include <stdint.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "frame_protocol.h"
+
+/**
+ *  Magic number at the start and the end of a session log ("HRBL" in little endian).
+ */
+#define SESSION_LOG_MAGIC 0x4C425248
+
+/**
+ *  The version of the session log format.
+ */
+#define SESSION_LOG_VERSION 1
+
+/**
+ *  The kinds of records of a session log. The records reproduce the calls
+ *  made to the pose estimator of a session in their original order.
+ */
+enum SessionLogRecordType
+{
+    // the TrackingConfig of the session as YAML, always the first record
+    LOG_RECORD_CONFIG = 0,
+    
+    // a LogFrame followed by the frame as tracked (i.e. decoded and mirrored) in PNG
+    LOG_RECORD_FRAME = 1,
+    
+    // a LogToggle, toggleTracking has been called with the last frame
+    LOG_RECORD_TOGGLE = 2,
+    
+    // reset has been called, no data
+    LOG_RECORD_RESET = 3,
+    
+    // a LogPoses followed by one ObjectPose per object, estimatePoses has been called with the last frame
+    LOG_RECORD_POSES = 4,
+    
+    // the LogIndexEntry of every frame record, written when the log is closed
+    LOG_RECORD_INDEX = 5
+};
+
+#pragma pack(push, 1)
+
+/**
+ *  The start of a session log, followed by the records.
+ */
+struct SessionLogHeader
+{
+    // Must be SESSION_LOG_MAGIC.
+    uint32_t magic;
+    
+    // Must be SESSION_LOG_VERSION.
+    uint32_t version;
+    
+    // The time the recording has been started (server clock).
+    uint64_t startTimestamp;
+};
+
+/**
+ *  Precedes the data of every record.
+ */
+struct LogRecordHeader
+{
+    // One of SessionLogRecordType.
+    uint32_t type;
+    
+    // The number of bytes following this header.
+    uint32_t length;
+    
+    // The time the record has been written by the session (server clock).
+    uint64_t timestamp;
+};
+
+/**
+ *  Describes a recorded frame, the PNG image has the size given by width
+ *  and height, except for NV12 frames, which are stored as a single channel
+ *  image of 3/2 times the height and YUYV frames, which are stored as a 4
+ *  channel image of half the width.
+ */
+struct LogFrame
+{
+    uint32_t frameID;
+    
+    // One of PixelFormat, compressed frames are recorded after decoding.
+    uint32_t pixelFormat;
+    
+    uint32_t width;
+    uint32_t height;
+    
+    // The region of the camera image and its scale, as passed to PoseEstimator6D::setFrameGeometry.
+    int32_t cropX;
+    int32_t cropY;
+    int32_t cropWidth;
+    int32_t cropHeight;
+    uint32_t scaleShift;
+    
+    // The timestamps of the frame as received from the client (client and server clock).
+    uint64_t captureTimestamp;
+    uint64_t receiveTimestamp;
+    uint64_t displayTimestamp;
+};
+
+struct LogToggle
+{
+    int32_t objectIndex;
+};
+
+/**
+ *  The poses estimated from a frame, followed by numObjects ObjectPoses
+ *  containing the pose T_cm of every object as returned by
+ *  Object3D::getPose, i.e. neither relative to the initial pose nor
+ *  extrapolated.
+ */
+struct LogPoses
+{
+    uint32_t frameID;
+    
+    // The checkForLoss argument of estimatePoses.
+    uint32_t checkForLoss;
+    
+    uint32_t numObjects;
+};
+
+struct LogIndexEntry
+{
+    // The position of the record header in the log.
+    uint64_t offset;
+    
+    uint32_t frameID;
+    
+    uint64_t captureTimestamp;
+};
+
+/**
+ *  The last bytes of a completely written log.
+ */
+struct SessionLogTrailer
+{
+    // The position of the index record.
+    uint64_t indexOffset;
+    
+    // Must be SESSION_LOG_MAGIC.
+    uint32_t magic;
+};
+
+#pragma pack(pop)
+
+/**
+ *  Reads a session log written by SessionRecorder. The records can be read
+ *  one after another or from any frame listed in the index. Logs that were
+ *  not closed properly, e.g. because the server crashed, do not have an
+ *  index, which is then rebuilt by scanning all complete records.
+ */
+class SessionLogReader
+{
+public:
+    SessionLogReader();
+    
+    ~SessionLogReader();
+    
+    /**
+     *  Opens a log and reads its index. Afterwards the first record is
+     *  read next.
+     *
+     *  @param  filename The path of the log.
+     *  @return True if the file is a compatible session log and false otherwise.
+     */
+    bool open(const std::string &filename);
+    
+    /**
+     *  Reads the next record.
+     *
+     *  @param  header The header of the record.
+     *  @param  data The data of the record.
+     *  @return False at the end of the log or of its complete records and true otherwise.
+     */
+    bool readRecord(LogRecordHeader &header, std::vector<uchar> &data);
+    
+    /**
+     *  Continues reading at a record, e.g. one listed in the index.
+     *
+     *  @param  offset The position of the record header.
+     */
+    void seek(uint64_t offset);
+    
+    /**
+     *  Returns the frame records of the log in their order.
+     *
+     *  @return The index of the log.
+     */
+    const std::vector<LogIndexEntry>& getIndex();
+    
+    /**
+     *  Returns whether the log has been closed properly.
+     *
+     *  @return True if the log ends with its index and false if the index has been rebuilt.
+     */
+    bool isComplete();
+    
+    const SessionLogHeader& getHeader();
+    
+    /**
+     *  Decodes the data of a frame record.
+     *
+     *  @param  data The data of a LOG_RECORD_FRAME record.
+     *  @param  frame The description of the frame.
+     *  @param  image The frame as it has been tracked, e.g. a 2 channel image for YUYV frames.
+     *  @return False if the record is corrupt and true otherwise.
+     */
+    static bool decodeFrame(const std::vector<uchar> &data, LogFrame &frame, cv::Mat &image);
+    
+    /**
+     *  Splits the data of a poses record.
+     *
+     *  @param  data The data of a LOG_RECORD_POSES record.
+     *  @param  poses The description of the poses.
+     *  @param  objectPoses The poses of the objects.
+     *  @return False if the record is corrupt and true otherwise.
+     */
+    static bool decodePoses(const std::vector<uchar> &data, LogPoses &poses, std::vector<ObjectPose> &objectPoses);
+
+private:
+    std::ifstream file;
+    
+    SessionLogHeader header;
+    
+    std::vector<LogIndexEntry> index;
+    
+    bool complete;
+    
+    // the end of the records, i.e. the start of the index or of an incomplete record
+    uint64_t end;
+    
+    bool readIndex(uint64_t size);
+    
+    void rebuildIndex(uint64_t size);
+};
+
+#endif /* SESSION_LOG_H */
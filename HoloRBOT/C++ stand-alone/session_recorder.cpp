@@ -0,0 +1,222 @@
+#include "session_recorder.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+using namespace cv;
+
+SessionRecorder* SessionRecorder::create(const std::string &filename, const std::string &config)
+{
+    SessionRecorder *recorder = new SessionRecorder(filename);
+    if(!recorder->file.is_open())
+    {
+        cout << "Could not create the session log: \"" << filename << "\"" << endl;
+        delete recorder;
+        return NULL;
+    }
+    
+    Entry entry;
+    entry.header.type = LOG_RECORD_CONFIG;
+    entry.header.timestamp = FrameProtocol::timestamp();
+    entry.data.assign(config.begin(), config.end());
+    recorder->push(entry);
+    
+    return recorder;
+}
+
+
+SessionRecorder::SessionRecorder(const std::string &filename)
+{
+    offset = 0;
+    numQueuedFrames = 0;
+    closing = false;
+    
+    file.open(filename, ios::binary | ios::trunc);
+    if(!file.is_open())
+        return;
+    
+    SessionLogHeader header = {SESSION_LOG_MAGIC, SESSION_LOG_VERSION, FrameProtocol::timestamp()};
+    file.write((const char*)&header, sizeof(SessionLogHeader));
+    offset = sizeof(SessionLogHeader);
+    
+    writerThread = thread(&SessionRecorder::writeEntries, this);
+}
+
+
+SessionRecorder::~SessionRecorder()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    condition.notify_all();
+    
+    if(writerThread.joinable())
+        writerThread.join();
+    
+    if(!file.is_open())
+        return;
+    
+    // the index and the trailer complete the log, without them the reader rebuilds the index
+    Entry entry;
+    entry.header.type = LOG_RECORD_INDEX;
+    entry.header.timestamp = FrameProtocol::timestamp();
+    entry.data.resize(index.size()*sizeof(LogIndexEntry));
+    memcpy(entry.data.data(), index.data(), entry.data.size());
+    
+    SessionLogTrailer trailer = {offset, SESSION_LOG_MAGIC};
+    write(entry);
+    file.write((const char*)&trailer, sizeof(SessionLogTrailer));
+    file.close();
+}
+
+
+void SessionRecorder::recordFrame(const LogFrame &frame, const cv::Mat &image)
+{
+    Entry entry;
+    entry.header.type = LOG_RECORD_FRAME;
+    entry.header.timestamp = FrameProtocol::timestamp();
+    entry.data.resize(sizeof(LogFrame));
+    memcpy(entry.data.data(), &frame, sizeof(LogFrame));
+    
+    // PNG has no 2 channel images, so the pixel pairs of YUYV frames are stored as 4 channel pixels
+    if(image.channels() == 2)
+        entry.image = image.reshape(4).clone();
+    else
+        entry.image = image.clone();
+    
+    push(entry);
+}
+
+
+void SessionRecorder::recordToggle(int objectIndex)
+{
+    LogToggle toggle = {objectIndex};
+    
+    Entry entry;
+    entry.header.type = LOG_RECORD_TOGGLE;
+    entry.header.timestamp = FrameProtocol::timestamp();
+    entry.data.resize(sizeof(LogToggle));
+    memcpy(entry.data.data(), &toggle, sizeof(LogToggle));
+    
+    push(entry);
+}
+
+
+void SessionRecorder::recordReset()
+{
+    Entry entry;
+    entry.header.type = LOG_RECORD_RESET;
+    entry.header.timestamp = FrameProtocol::timestamp();
+    
+    push(entry);
+}
+
+
+void SessionRecorder::recordPoses(uint32_t frameID, bool checkForLoss, const std::vector<Object3D*> &objects)
+{
+    vector<ObjectPose> objectPoses;
+    collectPoses(objects, objectPoses);
+    
+    LogPoses poses = {frameID, checkForLoss ? 1u : 0u, (uint32_t)objectPoses.size()};
+    
+    Entry entry;
+    entry.header.type = LOG_RECORD_POSES;
+    entry.header.timestamp = FrameProtocol::timestamp();
+    entry.data.resize(sizeof(LogPoses) + objectPoses.size()*sizeof(ObjectPose));
+    memcpy(entry.data.data(), &poses, sizeof(LogPoses));
+    memcpy(entry.data.data() + sizeof(LogPoses), objectPoses.data(), objectPoses.size()*sizeof(ObjectPose));
+    
+    push(entry);
+}
+
+
+void SessionRecorder::collectPoses(const std::vector<Object3D*> &objects, std::vector<ObjectPose> &objectPoses)
+{
+    objectPoses.resize(objects.size());
+    for(int i = 0; i < objects.size(); i++)
+    {
+        objectPoses[i].flags = 0;
+        if(objects[i]->isInitialized())
+            objectPoses[i].flags |= OBJECT_POSE_INITIALIZED;
+        if(objects[i]->isTrackingLost())
+            objectPoses[i].flags |= OBJECT_POSE_LOST;
+        
+        Matx44f pose = objects[i]->getPose();
+        copy(pose.val, pose.val + 16, objectPoses[i].pose);
+        
+        objectPoses[i].energy = objects[i]->getEnergy();
+    }
+}
+
+
+void SessionRecorder::push(Entry &entry)
+{
+    unique_lock<std::mutex> lock(mutex);
+    
+    if(!entry.image.empty())
+    {
+        condition.wait(lock, [this]() { return numQueuedFrames < MAX_QUEUED_FRAMES; });
+        numQueuedFrames++;
+    }
+    
+    queue.push_back(std::move(entry));
+    condition.notify_all();
+}
+
+
+void SessionRecorder::write(Entry &entry)
+{
+    if(!entry.image.empty())
+    {
+        // fast and lossless, such that the replayed frames are bit-exact
+        vector<uchar> encoded;
+        imencode(".png", entry.image, encoded, {IMWRITE_PNG_COMPRESSION, 1});
+        entry.data.insert(entry.data.end(), encoded.begin(), encoded.end());
+        
+        LogFrame *frame = (LogFrame*)entry.data.data();
+        LogIndexEntry indexEntry = {offset, frame->frameID, frame->captureTimestamp};
+        index.push_back(indexEntry);
+    }
+    
+    entry.header.length = (uint32_t)entry.data.size();
+    
+    file.write((const char*)&entry.header, sizeof(LogRecordHeader));
+    file.write((const char*)entry.data.data(), entry.data.size());
+    
+    offset += sizeof(LogRecordHeader) + entry.data.size();
+}
+
+
+void SessionRecorder::writeEntries()
+{
+    unique_lock<std::mutex> lock(mutex);
+    while(true)
+    {
+        condition.wait(lock, [this]() { return closing || !queue.empty(); });
+        if(queue.empty())
+            break;
+        
+        Entry entry = std::move(queue.front());
+        queue.pop_front();
+        
+        // compressing and writing does not block the session
+        lock.unlock();
+        bool isFrame = !entry.image.empty();
+        write(entry);
+        lock.lock();
+        
+        if(isFrame)
+        {
+            numQueuedFrames--;
+            condition.notify_all();
+        }
+        
+        // whatever has been written survives a crash of the server
+        if(queue.empty())
+            file.flush();
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef SESSION_RECORDER_H
+#define SESSION_RECORDER_H
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "session_log.h"
+#include "object3d.h"
+
+/**
+ *  This class records a tracking session into an append-only session log,
+ *  such that the session can be replayed deterministically through a
+ *  PoseEstimator6D later on, see session_replay.cpp. Every frame is stored
+ *  as tracked, losslessly compressed, together with its timestamps and
+ *  geometry, followed by the calls made to the pose estimator with it and
+ *  the resulting poses. The index of all frames is appended when the
+ *  recorder is destroyed.
+ *
+ *  The frames are compressed and written by a separate thread, so a
+ *  recording only costs the session a copy of every frame. If the writer
+ *  falls behind by more than a few frames, recording a frame waits for it,
+ *  since a log with missing frames could not be replayed.
+ */
+class SessionRecorder
+{
+public:
+    /**
+     *  Creates a new log file and writes the configuration of the session
+     *  into it.
+     *
+     *  @param  filename The path of the log file, an existing file is replaced.
+     *  @param  config The configuration of the session as returned by TrackingConfig::toString.
+     *  @return The recorder or NULL if the file could not be created.
+     */
+    static SessionRecorder* create(const std::string &filename, const std::string &config);
+    
+    /**
+     *  Writes all pending records and the index and closes the log.
+     */
+    ~SessionRecorder();
+    
+    /**
+     *  Records a frame after it has been passed to
+     *  PoseEstimator6D::setFrameGeometry.
+     *
+     *  @param  frame The description of the frame.
+     *  @param  image The frame as passed to the pose estimator, it is copied.
+     */
+    void recordFrame(const LogFrame &frame, const cv::Mat &image);
+    
+    /**
+     *  Records a call of PoseEstimator6D::toggleTracking with the last frame.
+     *
+     *  @param  objectIndex The index of the object.
+     */
+    void recordToggle(int objectIndex);
+    
+    /**
+     *  Records a call of PoseEstimator6D::reset.
+     */
+    void recordReset();
+    
+    /**
+     *  Records the poses of all objects after a call of
+     *  PoseEstimator6D::estimatePoses with the last frame.
+     *
+     *  @param  frameID The ID of the last frame.
+     *  @param  checkForLoss The checkForLoss argument of estimatePoses.
+     *  @param  objects The objects of the pose estimator.
+     */
+    void recordPoses(uint32_t frameID, bool checkForLoss, const std::vector<Object3D*> &objects);
+    
+    /**
+     *  Collects the state of the objects as stored in a poses record.
+     *
+     *  @param  objects The objects of a pose estimator.
+     *  @param  objectPoses The pose T_cm, the flags and the energy of every object.
+     */
+    static void collectPoses(const std::vector<Object3D*> &objects, std::vector<ObjectPose> &objectPoses);
+
+private:
+    // the number of frames waiting to be compressed before recordFrame blocks
+    static const int MAX_QUEUED_FRAMES = 4;
+    
+    struct Entry
+    {
+        LogRecordHeader header;
+        
+        std::vector<uchar> data;
+        
+        // the frame of a frame record, compressed and appended to the data by the writer thread
+        cv::Mat image;
+    };
+    
+    SessionRecorder(const std::string &filename);
+    
+    std::ofstream file;
+    
+    uint64_t offset;
+    
+    std::vector<LogIndexEntry> index;
+    
+    std::mutex mutex;
+    std::condition_variable condition;
+    
+    std::deque<Entry> queue;
+    int numQueuedFrames;
+    
+    bool closing;
+    
+    std::thread writerThread;
+    
+    void push(Entry &entry);
+    
+    void write(Entry &entry);
+    
+    void writeEntries();
+};
+
+#endif /* SESSION_RECORDER_H */
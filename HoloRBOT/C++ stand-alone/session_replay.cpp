@@ -0,0 +1,296 @@
+/**
+ *  Replays a session log recorded by the tracking server (--record) offline
+ *  through a PoseEstimator6D configured like the recorded session, without
+ *  a client or a network. The calls made to the pose estimator during the
+ *  session are repeated in their original order with the recorded frames,
+ *  so a tracking failure seen on the device can be reproduced and debugged
+ *  on a workstation, or a change of the tracker can be profiled on real
+ *  sessions.
+ *
+ *  After every estimatePoses the poses are compared to the recorded ones.
+ *  On the machine the session has been recorded on they must be bit-exact,
+ *  otherwise the number of differing frames tells how much a change of the
+ *  tracker affected its results. At the end the time spent per frame, the
+ *  slowest frames and the number of differing frames are reported, the
+ *  exit code is 1 if any frame differed.
+ *
+ *  usage: session_replay [--info] [--from frameID] [--slowest n] log
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "object3d.h"
+#include "pixel_layout.h"
+#include "pose_estimator6d.h"
+#include "rendering_engine.h"
+#include "session_log.h"
+#include "session_recorder.h"
+#include "tracking_config.h"
+
+using namespace std;
+using namespace cv;
+
+struct FrameTiming
+{
+    uint32_t frameID;
+    
+    // the time spent in estimatePoses by the replay
+    double replayTime;
+    
+    // the time between receiving the frame and recording the poses during the session
+    double sessionTime;
+};
+
+static int64_t now()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double percentile(vector<double> &values, double p)
+{
+    if(values.empty())
+        return 0;
+    
+    sort(values.begin(), values.end());
+    return values[min((size_t)(p*values.size()), values.size() - 1)];
+}
+
+static void printInfo(SessionLogReader &log, const TrackingConfig &config)
+{
+    const vector<LogIndexEntry> &index = log.getIndex();
+    
+    cout << "objects: " << config.objects.size() << endl;
+    for(int i = 0; i < config.objects.size(); i++)
+    {
+        cout << "  " << config.objects[i].filename << endl;
+    }
+    cout << "camera: " << config.width << "x" << config.height << endl;
+    cout << "frames: " << index.size() << endl;
+    if(index.size() > 1)
+        cout << "duration: " << (index.back().captureTimestamp - index.front().captureTimestamp)/1e6 << " s (frames " << index.front().frameID << " to " << index.back().frameID << ")" << endl;
+    cout << "complete: " << (log.isComplete() ? "yes" : "no, the index has been rebuilt") << endl;
+}
+
+// the largest difference of the pose entries, to tell a numerical drift from a different result
+static float maxDifference(const vector<ObjectPose> &a, const vector<ObjectPose> &b)
+{
+    float difference = 0;
+    for(int i = 0; i < a.size() && i < b.size(); i++)
+    {
+        for(int j = 0; j < 16; j++)
+        {
+            difference = max(difference, fabs(a[i].pose[j] - b[i].pose[j]));
+        }
+    }
+    return difference;
+}
+
+
+int main(int argc, char *argv[])
+{
+    bool info = false;
+    bool seekFrame = false;
+    uint32_t fromFrameID = 0;
+    int numSlowest = 5;
+    string filename;
+    
+    for(int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if(arg == "--info")
+            info = true;
+        else if(arg == "--from" && i + 1 < argc)
+        {
+            seekFrame = true;
+            fromFrameID = (uint32_t)atoi(argv[++i]);
+        }
+        else if(arg == "--slowest" && i + 1 < argc)
+            numSlowest = max(atoi(argv[++i]), 0);
+        else if(arg[0] != '-')
+            filename = arg;
+        else
+        {
+            cout << "usage: session_replay [--info] [--from frameID] [--slowest n] log" << endl;
+            return 1;
+        }
+    }
+    
+    if(filename.empty())
+    {
+        cout << "usage: session_replay [--info] [--from frameID] [--slowest n] log" << endl;
+        return 1;
+    }
+    
+    SessionLogReader log;
+    if(!log.open(filename))
+        return 1;
+    
+    LogRecordHeader header;
+    vector<uchar> data;
+    TrackingConfig config;
+    if(!log.readRecord(header, data) || header.type != LOG_RECORD_CONFIG || !config.loadString(string(data.begin(), data.end())))
+    {
+        cout << "The session log does not start with a valid configuration" << endl;
+        return 1;
+    }
+    
+    if(info)
+    {
+        printInfo(log, config);
+        return 0;
+    }
+    
+    // starting at a later frame only reproduces the session if the objects were not tracked before
+    if(seekFrame)
+    {
+        const vector<LogIndexEntry> &index = log.getIndex();
+        int i = 0;
+        while(i < index.size() && index[i].frameID < fromFrameID)
+        {
+            i++;
+        }
+        if(i == index.size())
+        {
+            cout << "The session log has no frame " << fromFrameID << endl;
+            return 1;
+        }
+        log.seek(index[i].offset);
+    }
+    
+    // the engines of the pose estimator render with the context of this one and take over its depth format
+    RenderingEngine *renderingEngine = new RenderingEngine();
+    if(!renderingEngine->isValid())
+    {
+        delete renderingEngine;
+        return 1;
+    }
+    renderingEngine->setHalfFloatDepth(config.halfFloatDepth);
+    
+    vector<Object3D*> objects;
+    for(int i = 0; i < config.objects.size(); i++)
+    {
+        ObjectConfig &o = config.objects[i];
+        objects.push_back(new Object3D(o.filename, o.tx, o.ty, o.tz, o.alpha, o.beta, o.gamma, o.scale, o.qualityThreshold, config.templateDistances));
+    }
+    
+    PoseEstimator6D *poseEstimator = new PoseEstimator6D(config.width, config.height, config.zNear, config.zFar, config.K, config.distCoeffs, objects, renderingEngine);
+    
+    Mat frame;
+    LogFrame logFrame;
+    uint64_t frameTimestamp = 0;
+    
+    LogPoses logPoses;
+    vector<ObjectPose> recordedPoses;
+    vector<ObjectPose> replayedPoses;
+    
+    vector<FrameTiming> timings;
+    int numFrames = 0;
+    int numMismatches = 0;
+    bool corrupt = false;
+    
+    while(log.readRecord(header, data))
+    {
+        if(header.type == LOG_RECORD_FRAME)
+        {
+            if(!SessionLogReader::decodeFrame(data, logFrame, frame))
+            {
+                corrupt = true;
+                break;
+            }
+            frameTimestamp = header.timestamp;
+            numFrames++;
+            
+            poseEstimator->setFrameFormat(frameFormat(logFrame.pixelFormat));
+            poseEstimator->setFrameGeometry(Rect(logFrame.cropX, logFrame.cropY, logFrame.cropWidth, logFrame.cropHeight), logFrame.scaleShift);
+        }
+        else if(frame.empty())
+        {
+            // the calls preceding the first replayed frame
+            continue;
+        }
+        else if(header.type == LOG_RECORD_TOGGLE)
+        {
+            LogToggle toggle;
+            if(data.size() != sizeof(LogToggle))
+            {
+                corrupt = true;
+                break;
+            }
+            memcpy(&toggle, data.data(), sizeof(LogToggle));
+            
+            if(toggle.objectIndex >= 0 && toggle.objectIndex < objects.size())
+                poseEstimator->toggleTracking(frame, toggle.objectIndex, false);
+        }
+        else if(header.type == LOG_RECORD_RESET)
+        {
+            poseEstimator->reset();
+        }
+        else if(header.type == LOG_RECORD_POSES)
+        {
+            if(!SessionLogReader::decodePoses(data, logPoses, recordedPoses))
+            {
+                corrupt = true;
+                break;
+            }
+            
+            int64_t start = now();
+            poseEstimator->estimatePoses(frame, false, logPoses.checkForLoss != 0);
+            double replayTime = (now() - start)/1000.0;
+            
+            FrameTiming timing = {logPoses.frameID, replayTime, (header.timestamp - frameTimestamp)/1000.0};
+            timings.push_back(timing);
+            
+            SessionRecorder::collectPoses(objects, replayedPoses);
+            if(replayedPoses.size() != recordedPoses.size() || memcmp(replayedPoses.data(), recordedPoses.data(), replayedPoses.size()*sizeof(ObjectPose)) != 0)
+            {
+                if(numMismatches == 0)
+                    cout << "The poses of frame " << logPoses.frameID << " differ from the recorded ones by up to " << maxDifference(replayedPoses, recordedPoses) << endl;
+                numMismatches++;
+            }
+        }
+    }
+    
+    if(corrupt)
+        cout << "The session log is corrupt after frame " << logFrame.frameID << endl;
+    
+    vector<double> replayTimes;
+    vector<double> sessionTimes;
+    for(int i = 0; i < timings.size(); i++)
+    {
+        replayTimes.push_back(timings[i].replayTime);
+        sessionTimes.push_back(timings[i].sessionTime);
+    }
+    
+    cout << "frames: " << numFrames << ", estimated: " << timings.size() << endl;
+    cout << "replay estimatePoses p50/p95/p99/max: " << percentile(replayTimes, 0.5) << " / " << percentile(replayTimes, 0.95) << " / " << percentile(replayTimes, 0.99) << " / " << percentile(replayTimes, 1.0) << " ms" << endl;
+    cout << "session frame to poses p50/p95/p99/max: " << percentile(sessionTimes, 0.5) << " / " << percentile(sessionTimes, 0.95) << " / " << percentile(sessionTimes, 0.99) << " / " << percentile(sessionTimes, 1.0) << " ms" << endl;
+    
+    sort(timings.begin(), timings.end(), [](const FrameTiming &a, const FrameTiming &b) { return a.replayTime > b.replayTime; });
+    for(int i = 0; i < numSlowest && i < timings.size(); i++)
+    {
+        cout << "  frame " << timings[i].frameID << ": " << timings[i].replayTime << " ms (session " << timings[i].sessionTime << " ms)" << endl;
+    }
+    
+    cout << "differing frames: " << numMismatches << endl;
+    
+    for(int i = 0; i < objects.size(); i++)
+    {
+        delete objects[i];
+    }
+    objects.clear();
+    
+    delete poseEstimator;
+    delete renderingEngine;
+    
+    RenderingEngine::terminate();
+    
+    return (numMismatches > 0 || corrupt) ? 1 : 0;
+}
@@ -18,6 +18,10 @@
 class Shader
 {
 public:
+    // the attribute locations of the vertex streams of a model, see Model::initBuffers
+    static const GLuint POSITION_LOCATION = 0;
+    static const GLuint NORMAL_LOCATION = 1;
+    
     unsigned int ID;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
@@ -80,6 +84,9 @@ std::cout << "FRAGMENT SHADER = " << fragment << std::endl;
 std::cout << "SHADER PROGRAM = " << ID << std::endl;
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
+        // the shaders do not declare the locations of their inputs themselves
+        glBindAttribLocation(ID, POSITION_LOCATION, "aPosition");
+        glBindAttribLocation(ID, NORMAL_LOCATION, "aNormal");
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessery
@@ -0,0 +1,376 @@
+#include "shared_memory_transport.h"
+
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+using namespace std;
+using namespace cv;
+
+// frame headers and payloads start at cache line boundaries
+static size_t align64(size_t size)
+{
+    return (size + 63) & ~(size_t)63;
+}
+
+
+// the futexes are shared between processes, so they must not use FUTEX_PRIVATE_FLAG
+static void futexWait(atomic<uint32_t> &word, uint32_t value, int64_t timeoutMicroseconds)
+{
+    timespec timeout;
+    timeout.tv_sec = timeoutMicroseconds/1000000;
+    timeout.tv_nsec = (timeoutMicroseconds%1000000)*1000;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, value, &timeout, NULL, 0);
+}
+
+
+static void futexWake(atomic<uint32_t> &word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+
+// waits until the word differs from the given value, returns false if the time is up
+static bool waitForChange(atomic<uint32_t> &word, atomic<uint32_t> &waiters, uint32_t value, chrono::steady_clock::time_point deadline)
+{
+    int64_t remaining = chrono::duration_cast<chrono::microseconds>(deadline - chrono::steady_clock::now()).count();
+    if(remaining <= 0)
+        return false;
+    
+    waiters++;
+    futexWait(word, value, remaining);
+    waiters--;
+    
+    return true;
+}
+
+
+SharedMemoryTransport* SharedMemoryTransport::create(const std::string &name, int numSlots, size_t maxPayloadLength, int maxObjects)
+{
+    if(numSlots < 3 || numSlots > SHARED_MEMORY_MAX_SLOTS || maxObjects < 1)
+        return NULL;
+    
+    size_t slotStride = align64(sizeof(FrameHeader)) + align64(maxPayloadLength);
+    size_t replyStride = align64(sizeof(CropRequest) + sizeof(PoseReply) + maxObjects*sizeof(ObjectPose));
+    size_t size = align64(sizeof(Layout)) + numSlots*slotStride + NUM_REPLIES*replyStride;
+    
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0 || ftruncate(fd, size) != 0)
+    {
+        cout << "Could not create the shared memory \"" << name << "\": " << strerror(errno) << endl;
+        if(fd >= 0)
+        {
+            ::close(fd);
+            shm_unlink(name.c_str());
+        }
+        return NULL;
+    }
+    
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(memory == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return NULL;
+    }
+    
+    // the atomics are constructed in place, a producer can only open the segment once the magic is set
+    Layout *layout = new(memory) Layout();
+    layout->version = PROTOCOL_VERSION;
+    layout->numSlots = numSlots;
+    layout->maxObjects = maxObjects;
+    layout->maxPayloadLength = maxPayloadLength;
+    layout->slotStride = slotStride;
+    layout->replyStride = replyStride;
+    for(int i = 0; i < SHARED_MEMORY_MAX_SLOTS; i++)
+    {
+        layout->slotStates[i] = FREE;
+    }
+    layout->newestSlot = -1;
+    layout->frameSequence = 0;
+    layout->replySequence = 0;
+    layout->frameWaiters = 0;
+    layout->replyWaiters = 0;
+    layout->closed = 0;
+    layout->numDropped = 0;
+    layout->commandsWritten = 0;
+    layout->commandsRead = 0;
+    
+    atomic_thread_fence(memory_order_release);
+    layout->magic = SHARED_MEMORY_MAGIC;
+    
+    return new SharedMemoryTransport(name, layout, size, true);
+}
+
+
+SharedMemoryTransport* SharedMemoryTransport::open(const std::string &name)
+{
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    struct stat status;
+    if(fd < 0 || fstat(fd, &status) != 0 || status.st_size < (off_t)sizeof(Layout))
+    {
+        cout << "Could not open the shared memory \"" << name << "\"" << endl;
+        if(fd >= 0)
+            ::close(fd);
+        return NULL;
+    }
+    
+    void *memory = mmap(NULL, status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(memory == MAP_FAILED)
+        return NULL;
+    
+    Layout *layout = (Layout*)memory;
+    if(layout->magic != SHARED_MEMORY_MAGIC || layout->version != PROTOCOL_VERSION)
+    {
+        cout << "The shared memory \"" << name << "\" is not compatible" << endl;
+        munmap(memory, status.st_size);
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    
+    return new SharedMemoryTransport(name, layout, status.st_size, false);
+}
+
+
+SharedMemoryTransport::SharedMemoryTransport(const std::string &name, Layout *layout, size_t size, bool owner)
+{
+    this->name = name;
+    this->layout = layout;
+    this->size = size;
+    this->owner = owner;
+    
+    lastReply = layout->replySequence;
+}
+
+
+SharedMemoryTransport::~SharedMemoryTransport()
+{
+    munmap(layout, size);
+    
+    if(owner)
+        shm_unlink(name.c_str());
+}
+
+
+uchar* SharedMemoryTransport::getSlot(int slot)
+{
+    return (uchar*)layout + align64(sizeof(Layout)) + slot*layout->slotStride;
+}
+
+
+uchar* SharedMemoryTransport::getReply(uint32_t sequence)
+{
+    return getSlot(layout->numSlots) + (sequence % NUM_REPLIES)*layout->replyStride;
+}
+
+
+int SharedMemoryTransport::beginWrite()
+{
+    // at most one slot is being read and one is the newest, so one of three slots is always free
+    for(int i = 0; i < layout->numSlots; i++)
+    {
+        uint32_t expected = FREE;
+        if(layout->slotStates[i].compare_exchange_strong(expected, WRITING))
+            return i;
+    }
+    return -1;
+}
+
+
+void SharedMemoryTransport::commitWrite(int slot)
+{
+    layout->slotStates[slot].store(READY, memory_order_release);
+    
+    // the previous newest slot can only still be READY if the tracker has not taken it
+    int previous = layout->newestSlot.exchange(slot);
+    if(previous >= 0)
+    {
+        layout->slotStates[previous].store(FREE, memory_order_release);
+        layout->numDropped++;
+    }
+    
+    layout->frameSequence++;
+    if(layout->frameWaiters > 0)
+        futexWake(layout->frameSequence);
+}
+
+
+void SharedMemoryTransport::abortWrite(int slot)
+{
+    layout->slotStates[slot].store(FREE, memory_order_release);
+}
+
+
+int SharedMemoryTransport::acquireNewest()
+{
+    int slot = layout->newestSlot.exchange(-1);
+    if(slot < 0)
+        return -1;
+    
+    layout->slotStates[slot].store(READING, memory_order_release);
+    atomic_thread_fence(memory_order_acquire);
+    
+    return slot;
+}
+
+
+int SharedMemoryTransport::waitForNewest(int timeout)
+{
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout);
+    while(true)
+    {
+        // reading the sequence first ensures that a frame published in between wakes up the futex
+        uint32_t sequence = layout->frameSequence;
+        
+        int slot = acquireNewest();
+        if(slot >= 0)
+            return slot;
+        
+        if(isClosed() || !waitForChange(layout->frameSequence, layout->frameWaiters, sequence, deadline))
+            return -1;
+    }
+}
+
+
+void SharedMemoryTransport::release(int slot)
+{
+    layout->slotStates[slot].store(FREE, memory_order_release);
+}
+
+
+FrameHeader& SharedMemoryTransport::getHeader(int slot)
+{
+    return *(FrameHeader*)getSlot(slot);
+}
+
+
+uchar* SharedMemoryTransport::getPayload(int slot)
+{
+    return getSlot(slot) + align64(sizeof(FrameHeader));
+}
+
+
+Mat SharedMemoryTransport::image(int slot)
+{
+    return FrameProtocol::image(getHeader(slot), getPayload(slot));
+}
+
+
+size_t SharedMemoryTransport::getMaxPayloadLength()
+{
+    return layout->maxPayloadLength;
+}
+
+
+int SharedMemoryTransport::getMaxObjects()
+{
+    return layout->maxObjects;
+}
+
+
+void SharedMemoryTransport::sendReply(const CropRequest &cropRequest, const PoseReply &poseReply, const std::vector<ObjectPose> &objectPoses)
+{
+    uint32_t sequence = layout->replySequence;
+    uint32_t numObjects = min(poseReply.numObjects, layout->maxObjects);
+    
+    uchar *reply = getReply(sequence);
+    memcpy(reply, &cropRequest, sizeof(CropRequest));
+    memcpy(reply + sizeof(CropRequest), &poseReply, sizeof(PoseReply));
+    ((PoseReply*)(reply + sizeof(CropRequest)))->numObjects = numObjects;
+    memcpy(reply + sizeof(CropRequest) + sizeof(PoseReply), objectPoses.data(), numObjects*sizeof(ObjectPose));
+    
+    layout->replySequence.store(sequence + 1, memory_order_release);
+    if(layout->replyWaiters > 0)
+        futexWake(layout->replySequence);
+}
+
+
+bool SharedMemoryTransport::waitForReply(CropRequest &cropRequest, PoseReply &poseReply, std::vector<ObjectPose> &objectPoses, int timeout)
+{
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout);
+    while(true)
+    {
+        uint32_t sequence = layout->replySequence.load(memory_order_acquire);
+        if(sequence != lastReply)
+        {
+            uchar *reply = getReply(sequence - 1);
+            memcpy(&cropRequest, reply, sizeof(CropRequest));
+            memcpy(&poseReply, reply + sizeof(CropRequest), sizeof(PoseReply));
+            objectPoses.resize(min(poseReply.numObjects, layout->maxObjects));
+            memcpy(objectPoses.data(), reply + sizeof(CropRequest) + sizeof(PoseReply), objectPoses.size()*sizeof(ObjectPose));
+            
+            // the record might have been overwritten while copying it if the tracker went all the way around
+            atomic_thread_fence(memory_order_acquire);
+            if(layout->replySequence - sequence < NUM_REPLIES - 1)
+            {
+                lastReply = sequence;
+                return true;
+            }
+            continue;
+        }
+        
+        if(!waitForChange(layout->replySequence, layout->replyWaiters, sequence, deadline))
+            return false;
+    }
+}
+
+
+bool SharedMemoryTransport::sendCommand(const CommandMessage &command)
+{
+    uint32_t written = layout->commandsWritten;
+    if(written - layout->commandsRead >= NUM_COMMANDS)
+        return false;
+    
+    layout->commands[written % NUM_COMMANDS] = command;
+    layout->commandsWritten.store(written + 1, memory_order_release);
+    return true;
+}
+
+
+void SharedMemoryTransport::takeCommands(std::vector<CommandMessage> &commands)
+{
+    uint32_t written = layout->commandsWritten.load(memory_order_acquire);
+    for(uint32_t read = layout->commandsRead; read != written; read++)
+    {
+        commands.push_back(layout->commands[read % NUM_COMMANDS]);
+    }
+    layout->commandsRead.store(written, memory_order_release);
+}
+
+
+void SharedMemoryTransport::close()
+{
+    layout->closed = 1;
+    
+    layout->frameSequence++;
+    futexWake(layout->frameSequence);
+}
+
+
+bool SharedMemoryTransport::isClosed()
+{
+    return layout->closed != 0;
+}
+
+
+bool SharedMemoryTransport::hasNewest()
+{
+    return layout->newestSlot >= 0;
+}
+
+
+uint64_t SharedMemoryTransport::getNumDropped()
+{
+    return layout->numDropped;
+}
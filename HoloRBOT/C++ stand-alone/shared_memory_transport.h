@@ -0,0 +1,276 @@
+#ifndef SHARED_MEMORY_TRANSPORT_H
+#define SHARED_MEMORY_TRANSPORT_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "frame_protocol.h"
+
+/**
+ *  Magic number at the start of the shared memory segment ("HRBS" in little endian).
+ */
+#define SHARED_MEMORY_MAGIC 0x53425248
+
+/**
+ *  The most frame slots a shared memory segment can have.
+ */
+#define SHARED_MEMORY_MAX_SLOTS 8
+
+/**
+ *  This class exchanges frames and replies with a producer running on the
+ *  same host through a POSIX shared memory segment, instead of a TCP
+ *  connection. The producer writes every frame, i.e. a FrameHeader and the
+ *  raw pixels, directly into a slot of the segment, such that handing it
+ *  over to the tracker does not copy anything. The tracker writes the same
+ *  replies as over TCP (CropRequest, PoseReply and the ObjectPoses) into a
+ *  small ring of reply records, and the producer may send CommandMessages
+ *  through a command queue.
+ *
+ *  The slots are handed over in the same way as by FrameRing: the tracker
+ *  always takes the newest frame and older ones are dropped. Waiting sides
+ *  sleep on futexes in the segment, which are only woken if somebody waits.
+ *
+ *  The tracker creates the segment and removes it when it is destroyed,
+ *  the producer opens it by name afterwards. Only one producer may use a
+ *  segment at a time. Frames must not be compressed.
+ */
+class SharedMemoryTransport
+{
+public:
+    /**
+     *  Creates a new shared memory segment on the tracker side. An existing
+     *  segment of the same name, e.g. left behind by a crashed tracker, is
+     *  replaced.
+     *
+     *  @param  name The name of the segment, e.g. "/rbot".
+     *  @param  numSlots The number of frame slots, within [3, SHARED_MEMORY_MAX_SLOTS].
+     *  @param  maxPayloadLength The largest frame payload in bytes a slot has to hold.
+     *  @param  maxObjects The largest number of object poses in a reply.
+     *  @return The transport or NULL if the segment could not be created.
+     */
+    static SharedMemoryTransport* create(const std::string &name, int numSlots, size_t maxPayloadLength, int maxObjects);
+    
+    /**
+     *  Opens the segment created by a tracker on the producer side.
+     *
+     *  @param  name The name of the segment.
+     *  @return The transport or NULL if there is no compatible segment of that name.
+     */
+    static SharedMemoryTransport* open(const std::string &name);
+    
+    /**
+     *  Unmaps the segment and removes it if it has been created by this
+     *  transport. A producer closes the transport before.
+     */
+    ~SharedMemoryTransport();
+    
+    /**
+     *  Reserves a free slot for the producer to write the next frame into.
+     *
+     *  @return The index of the reserved slot or -1 if no slot is free.
+     */
+    int beginWrite();
+    
+    /**
+     *  Publishes a completely written slot, making it the newest frame and
+     *  dropping the previous one if the tracker has not taken it yet.
+     *
+     *  @param  slot The index of the slot as returned by beginWrite.
+     */
+    void commitWrite(int slot);
+    
+    /**
+     *  Returns a reserved slot without publishing it.
+     *
+     *  @param  slot The index of the slot as returned by beginWrite.
+     */
+    void abortWrite(int slot);
+    
+    /**
+     *  Takes the newest published frame on the tracker side, if there is one.
+     *
+     *  @return The index of the taken slot or -1 if no new frame is available.
+     */
+    int acquireNewest();
+    
+    /**
+     *  Same as acquireNewest but waits up to the given time for a frame to
+     *  be published if none is available.
+     *
+     *  @param  timeout The maximum waiting time in milliseconds.
+     *  @return The index of the taken slot or -1 if no new frame arrived in time or the producer has closed the transport.
+     */
+    int waitForNewest(int timeout);
+    
+    /**
+     *  Hands a processed slot back to the producer.
+     *
+     *  @param  slot The index of the slot as returned by acquireNewest or waitForNewest.
+     */
+    void release(int slot);
+    
+    /**
+     *  Returns the header of the frame in a slot owned by the caller.
+     *
+     *  @param  slot The index of the slot.
+     *  @return The frame header.
+     */
+    FrameHeader& getHeader(int slot);
+    
+    /**
+     *  Returns the memory the pixels of a slot are written to, aligned to 64 bytes.
+     *
+     *  @param  slot The index of the slot.
+     *  @return The first byte of the payload.
+     */
+    uchar* getPayload(int slot);
+    
+    /**
+     *  Wraps the payload of a slot as an OpenCV image without copying it.
+     *
+     *  @param  slot The index of the slot.
+     *  @return The image corresponding to the header and payload of the frame.
+     */
+    cv::Mat image(int slot);
+    
+    size_t getMaxPayloadLength();
+    
+    int getMaxObjects();
+    
+    /**
+     *  Writes the reply to a processed frame for the producer.
+     *
+     *  @param  cropRequest The region requested for the next frame.
+     *  @param  poseReply The timestamps of the frame, numObjects must not exceed getMaxObjects().
+     *  @param  objectPoses The poses of the objects.
+     */
+    void sendReply(const CropRequest &cropRequest, const PoseReply &poseReply, const std::vector<ObjectPose> &objectPoses);
+    
+    /**
+     *  Waits for the next reply on the producer side. If the producer falls
+     *  behind, older replies are skipped and only the newest one is returned.
+     *
+     *  @param  cropRequest The region requested for the next frame.
+     *  @param  poseReply The timestamps of the processed frame.
+     *  @param  objectPoses The poses of the objects.
+     *  @param  timeout The maximum waiting time in milliseconds.
+     *  @return True if a reply has been read and false otherwise.
+     */
+    bool waitForReply(CropRequest &cropRequest, PoseReply &poseReply, std::vector<ObjectPose> &objectPoses, int timeout);
+    
+    /**
+     *  Queues a command on the producer side.
+     *
+     *  @param  command The command to be applied before the next frame.
+     *  @return False if the queue is full and true otherwise.
+     */
+    bool sendCommand(const CommandMessage &command);
+    
+    /**
+     *  Appends all queued commands on the tracker side.
+     *
+     *  @param  commands The vector the commands are appended to.
+     */
+    void takeCommands(std::vector<CommandMessage> &commands);
+    
+    /**
+     *  Tells the tracker that the producer will not publish any further frames.
+     */
+    void close();
+    
+    bool isClosed();
+    
+    /**
+     *  Returns whether a published frame is waiting to be taken.
+     *
+     *  @return True if acquireNewest would return a slot and false otherwise.
+     */
+    bool hasNewest();
+    
+    /**
+     *  Returns the number of published frames that were never processed,
+     *  because a newer frame was available.
+     *
+     *  @return The number of dropped frames.
+     */
+    uint64_t getNumDropped();
+
+private:
+    enum SlotState
+    {
+        FREE,
+        WRITING,
+        READY,
+        READING
+    };
+    
+    // the size of the command queue
+    static const int NUM_COMMANDS = 16;
+    
+    // the number of reply records, the producer skips older ones if it falls behind
+    static const int NUM_REPLIES = 8;
+    
+    /**
+     *  The start of the segment, followed by the frame slots and the reply
+     *  records. It only contains lock-free atomics, which work across
+     *  processes.
+     */
+    struct Layout
+    {
+        uint32_t magic;
+        uint32_t version;
+        
+        uint32_t numSlots;
+        uint32_t maxObjects;
+        uint64_t maxPayloadLength;
+        
+        // the distances between two slots and two reply records in bytes
+        uint64_t slotStride;
+        uint64_t replyStride;
+        
+        std::atomic<uint32_t> slotStates[SHARED_MEMORY_MAX_SLOTS];
+        
+        // the newest published slot or -1
+        std::atomic<int32_t> newestSlot;
+        
+        // futex words, incremented with every published frame (or closing) and every written reply
+        std::atomic<uint32_t> frameSequence;
+        std::atomic<uint32_t> replySequence;
+        
+        // the number of threads sleeping on the futexes, such that waking is only a system call if needed
+        std::atomic<uint32_t> frameWaiters;
+        std::atomic<uint32_t> replyWaiters;
+        
+        std::atomic<uint32_t> closed;
+        
+        std::atomic<uint64_t> numDropped;
+        
+        // single producer single consumer queue
+        std::atomic<uint32_t> commandsWritten;
+        std::atomic<uint32_t> commandsRead;
+        CommandMessage commands[NUM_COMMANDS];
+    };
+    
+    SharedMemoryTransport(const std::string &name, Layout *layout, size_t size, bool owner);
+    
+    std::string name;
+    
+    Layout *layout;
+    
+    size_t size;
+    
+    // the tracker owns the segment
+    bool owner;
+    
+    // the last reply sequence seen by the producer
+    uint32_t lastReply;
+    
+    uchar* getSlot(int slot);
+    
+    uchar* getReply(uint32_t sequence);
+};
+
+#endif /* SHARED_MEMORY_TRANSPORT_H */
@@ -38,9 +38,15 @@
 uniform vec3 uColor;
 uniform float uAlpha;
 
+in float vDepth;
+
 layout(location = 0) out vec4 fragColor;
 
+// the linear depth map, 0 where no model is rendered
+layout(location = 1) out float fragDepth;
+
 void main()
 {
 	fragColor = vec4(uColor, uAlpha);
+	fragDepth = vDepth;
 }
@@ -36,11 +36,17 @@
 #version 330
 
 uniform mat4 uMVPMatrix;
+uniform mat4 uMVMatrix;
 in vec3 aPosition;
 
+// the metric Z-distance to the camera (the OpenGL camera looks along -z)
+out float vDepth;
+
 
 void main()
 {
 	// vertex position
 	gl_Position = uMVPMatrix * vec4(aPosition, 1.0);
+	
+	vDepth = -(uMVMatrix * vec4(aPosition, 1.0)).z;
 }
@@ -0,0 +1,247 @@
+#include "software_rasterizer.h"
+
+using namespace std;
+using namespace cv;
+
+// the number of rows rasterized together, small enough to balance the threads for small regions of interest
+static const int BAND_HEIGHT = 16;
+
+
+SoftwareRasterizer::SoftwareRasterizer(void)
+{
+    fullWidth = 0;
+    fullHeight = 0;
+    
+    zNear = 0.1f;
+    zFar = 1000.0f;
+    
+    numLevels = 1;
+    
+    calibrationMatrices.push_back(Matx44f::eye());
+    
+    projectionMatrix = Transformations::perspectiveMatrix(50, 16.0f/10.67f, 0.1, 1000.0);
+    
+    // the same view as that of the rendering engine
+    lookAtMatrix = Transformations::lookAtMatrix(0, 0, 0, 0, 0, 1, 0, -1, 0);
+    
+    roiProjectionMatrix = projectionMatrix;
+    
+    currentLevel = 0;
+}
+
+
+SoftwareRasterizer::~SoftwareRasterizer(void)
+{
+    
+}
+
+
+void SoftwareRasterizer::init(const Matx33f &K, int width, int height, float zNear, float zFar, int numLevels)
+{
+    this->zNear = zNear;
+    this->zFar = zFar;
+    
+    this->numLevels = numLevels;
+    
+    setCalibration(K, width, height);
+}
+
+
+void SoftwareRasterizer::setCalibration(const Matx33f &K, int width, int height)
+{
+    fullWidth = width;
+    fullHeight = height;
+    
+    projectionMatrix = Transformations::perspectiveMatrix(K, width, height, zNear, zFar, true);
+    
+    calibrationMatrices.clear();
+    
+    for(int i = 0; i < numLevels; i++)
+    {
+        float s = pow(2, i);
+        
+        Matx44f K_l = Matx44f::eye();
+        K_l(0, 0) = K(0, 0)/s;
+        K_l(1, 1) = K(1, 1)/s;
+        K_l(0, 2) = K(0, 2)/s;
+        K_l(1, 2) = K(1, 2)/s;
+        
+        calibrationMatrices.push_back(K_l);
+    }
+    
+    setLevel(currentLevel);
+}
+
+
+int SoftwareRasterizer::getNumLevels()
+{
+    return numLevels;
+}
+
+
+void SoftwareRasterizer::setLevel(int level)
+{
+    // the same image size as the frame buffer of the rendering engine
+    currentLevel = level;
+    int s = pow(2, currentLevel);
+    width = fullWidth/s;
+    height = fullHeight/s;
+    
+    width += width%4;
+    height += height%4;
+    
+    setROI(Rect(0, 0, width, height));
+}
+
+
+int SoftwareRasterizer::getLevel()
+{
+    return currentLevel;
+}
+
+
+void SoftwareRasterizer::setROI(const Rect &roi)
+{
+    this->roi = roi & Rect(0, 0, width, height);
+    if(this->roi.area() == 0)
+        this->roi = Rect(0, 0, width, height);
+    
+    // scales and shifts the normalized device coordinates, such that the region covers [-1, 1]
+    float sx = (float)width/this->roi.width;
+    float sy = (float)height/this->roi.height;
+    Matx44f crop(sx, 0,  0, (float)(width - 2*this->roi.x - this->roi.width)/this->roi.width,
+                 0,  sy, 0, (float)(height - 2*this->roi.y - this->roi.height)/this->roi.height,
+                 0,  0,  1, 0,
+                 0,  0,  0, 1);
+    
+    roiProjectionMatrix = crop*projectionMatrix;
+}
+
+
+Rect SoftwareRasterizer::getROI()
+{
+    return roi;
+}
+
+
+Matx44f SoftwareRasterizer::getCalibrationMatrix()
+{
+    return calibrationMatrices[currentLevel];
+}
+
+
+void SoftwareRasterizer::renderSilhouette(Model *model, bool invertDepth, uchar value, bool drawAll)
+{
+    clear(invertDepth);
+    
+    if(model->isInitialized() || drawAll)
+        setupTriangles(model, value);
+    
+    rasterize(invertDepth);
+}
+
+
+void SoftwareRasterizer::renderSilhouette(vector<Model*> models, bool invertDepth, bool drawAll)
+{
+    clear(invertDepth);
+    
+    for(int i = 0; i < models.size(); i++)
+    {
+        if(models[i]->isInitialized() || drawAll)
+            setupTriangles(models[i], (uchar)models[i]->getModelID());
+    }
+    
+    rasterize(invertDepth);
+}
+
+
+Mat SoftwareRasterizer::downloadFrame(RenderingEngine::FrameType type)
+{
+    Mat res;
+    switch(type)
+    {
+        case RenderingEngine::MASK:
+            res = mask.clone();
+            break;
+        case RenderingEngine::DEPTH:
+            // like reading a 24 bit depth buffer as floats
+            depth.convertTo(res, CV_32F, 1.0/16777215.0);
+            break;
+        case RenderingEngine::LINEAR_DEPTH:
+            res = linearDepth.clone();
+            break;
+        default:
+            res = Mat::zeros(roi.height, roi.width, CV_8UC1);
+            break;
+    }
+    return res;
+}
+
+
+void SoftwareRasterizer::clear(bool invertDepth)
+{
+    mask.create(roi.height, roi.width, CV_8UC1);
+    depth.create(roi.height, roi.width, CV_32SC1);
+    linearDepth.create(roi.height, roi.width, CV_32FC1);
+    
+    mask.setTo(Scalar::all(0));
+    depth.setTo(Scalar::all(invertDepth ? 16777215 : 0));
+    linearDepth.setTo(Scalar::all(0));
+    
+    triangles.clear();
+}
+
+
+void SoftwareRasterizer::setupTriangles(Model *model, uchar value)
+{
+    Matx44f pose = model->getPose();
+    Matx44f normalization = model->getNormalization();
+    
+    Matx44f modelViewMatrix = lookAtMatrix*(pose*normalization);
+    
+    Matx44f modelViewProjectionMatrix = roiProjectionMatrix*modelViewMatrix;
+    
+    // the triangles drawn by the rendering engine
+    const vector<Vec3f> &vertices = model->getVertices();
+    const vector<GLuint> &indices = model->getIndices();
+    
+    vector<Vec4f> clip(vertices.size());
+    for(int i = 0; i < vertices.size(); i++)
+    {
+        const Vec3f &p = vertices[i];
+        clip[i] = modelViewProjectionMatrix*Vec4f(p[0], p[1], p[2], 1.0f);
+    }
+    
+    int threads = 8;
+    vector<vector<RasterTriangle> > trianglesCollection(threads);
+    
+    parallel_for_(cv::Range(0, threads), Parallel_For_setupTriangles(clip, indices, roi.width, roi.height, value, trianglesCollection.data(), threads));
+    
+    // keep the order of drawing, the first of two surfaces at the same depth wins
+    for(int i = 0; i < threads; i++)
+    {
+        triangles.insert(triangles.end(), trianglesCollection[i].begin(), trianglesCollection[i].end());
+    }
+}
+
+
+void SoftwareRasterizer::rasterize(bool invertDepth)
+{
+    int numBands = (roi.height + BAND_HEIGHT - 1)/BAND_HEIGHT;
+    
+    bins.resize(numBands);
+    for(int b = 0; b < numBands; b++)
+    {
+        bins[b].clear();
+    }
+    
+    for(int i = 0; i < triangles.size(); i++)
+    {
+        for(int b = triangles[i].minY/BAND_HEIGHT; b <= triangles[i].maxY/BAND_HEIGHT; b++)
+        {
+            bins[b].push_back(i);
+        }
+    }
+    
+    parallel_for_(cv::Range(0, numBands), Parallel_For_rasterize(triangles, bins, BAND_HEIGHT, invertDepth, mask, depth, linearDepth));
+}
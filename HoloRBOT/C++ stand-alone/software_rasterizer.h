@@ -0,0 +1,565 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <cmath>
+#include <vector>
+
+#include <emmintrin.h>
+
+#include <opencv2/core.hpp>
+
+#include "model.h"
+#include "rendering_engine.h"
+
+/**
+ *  A triangle in window coordinates of the region of interest, set up for
+ *  being rasterized by Parallel_For_rasterize.
+ */
+struct RasterTriangle
+{
+    // the edges from vertex k to vertex k+1 in 1/256 pixels, the triangle is to their left
+    int64_t ax[3], ay[3];
+    int64_t dx[3], dy[3];
+    
+    // 0 if pixel centers exactly on the edge are covered and 1 otherwise
+    int64_t bias[3];
+    
+    // the pixels covered by the bounding box, clipped to the region of interest
+    int minX, maxX, minY, maxY;
+    
+    // the depth buffer value and 1/w are linear in window coordinates relative to the first vertex
+    double x0, y0;
+    double depth0, depthDx, depthDy;
+    double invW0, invWDx, invWDy;
+    
+    uchar value;
+};
+
+
+/**
+ *  This class implements a CPU rasterizer producing the same silhouette
+ *  masks, depth buffers and linear depth maps as RenderingEngine's
+ *  renderSilhouette with the frame types MASK, DEPTH and LINEAR_DEPTH. It
+ *  supports the same pyramid levels and regions of interest, but it needs
+ *  no OpenGL context, so any number of rasterizers can be used by different
+ *  threads at the same time (e.g. for generating templates in parallel, for
+ *  the coarse pyramid levels or on servers without a GPU).
+ *
+ *  Like a GPU, the vertices are snapped to 1/256 pixel and the triangles
+ *  are covered with exact integer edge functions at the pixel centers,
+ *  where pixel centers exactly on an edge are resolved by the top left rule
+ *  of the image coordinates. The depth buffer is quantized to 24 bits like
+ *  the one of the rendering engine. The image is split into bands of rows
+ *  that are rasterized in parallel, each triangle only visits the bands it
+ *  overlaps and per row only the span it covers, four pixels at a time.
+ *
+ *  Compared to a GPU the results can differ where two surfaces are within
+ *  the last bit of the depth buffer, along edges through pixel centers if
+ *  the GPU uses another fill rule, and in the last bits of the linear depth.
+ */
+class SoftwareRasterizer
+{
+public:
+    SoftwareRasterizer(void);
+    
+    ~SoftwareRasterizer(void);
+    
+    /**
+     *  Initializes the rasterizer like RenderingEngine::init.
+     *
+     *  @param  K The intrinsic camera matrix.
+     *  @param  width The width in pixels of the rendered images at level 0.
+     *  @param  height The height in pixels of the rendered images at level 0.
+     *  @param  zNear The distance of the near plane.
+     *  @param  zFar The distance of the far plane.
+     *  @param  numLevels Number of supported pyramid levels with a downscale factor of 2.
+     */
+    void init(const cv::Matx33f &K, int width, int height, float zNear, float zFar, int numLevels);
+    
+    /**
+     *  Replaces the intrinsic camera matrix and the image resolution at level 0
+     *  like RenderingEngine::setCalibration.
+     *
+     *  @param  K The intrinsic camera matrix of the (cropped or scaled) camera frame.
+     *  @param  width The width in pixels of the rendered images at level 0.
+     *  @param  height The height in pixels of the rendered images at level 0.
+     */
+    void setCalibration(const cv::Matx33f &K, int width, int height);
+    
+    /**
+     *  Returns the number of supported pyramid levels for rendering.
+     *
+     *  @return  The number of supported pyramid levels for rendering.
+     */
+    int getNumLevels();
+    
+    /**
+     *  Sets a pyramid level to be used for rendering, the images have the
+     *  same size as those of the rendering engine at that level.
+     *
+     *  @param level The pyramid level to be used for rendering.
+     */
+    void setLevel(int level);
+    
+    /**
+     *  Returns the current pyramid level used for rendering.
+     *
+     *  @return  The current pyramid level used for rendering.
+     */
+    int getLevel();
+    
+    /**
+     *  Restricts rendering to a 2D region of interest of the current pyramid
+     *  level like RenderingEngine::setROI.
+     *
+     *  @param roi The region in pixels of the current pyramid level, it is clipped to the image.
+     */
+    void setROI(const cv::Rect &roi);
+    
+    /**
+     *  Returns the region of interest used for rendering.
+     *
+     *  @return  The region of interest used for rendering.
+     */
+    cv::Rect getROI();
+    
+    /**
+     *  Returns a 4x4 float version of the intrinsic camera matrix wrt the current
+     *  pyramid level like RenderingEngine::getCalibrationMatrix.
+     *
+     *  @return  A 4x4 float version of the intrinsic camera matrix wrt the current
+     *  pyramid level.
+     */
+    cv::Matx44f getCalibrationMatrix();
+    
+    /**
+     *  Renders the silhouette of a single model wrt its current pose.
+     *
+     *  @param model The model to be rendered.
+     *  @param invertDepth Whether to invert the depth test during rendering (default = false).
+     *  @param value The intensity of the model in the mask (default = 255).
+     *  @param drawAll Whether to draw the model even if it has not yet been initlaized for tracking (default = false).
+     */
+    void renderSilhouette(Model *model, bool invertDepth = false, uchar value = 255, bool drawAll = false);
+    
+    /**
+     *  Renders multiple models in a common scene with correct occlusions, each
+     *  with its model ID as its intensity in the mask.
+     *
+     *  @param models The models to be rendered.
+     *  @param invertDepth Whether to invert the depth test during rendering (default = false).
+     *  @param drawAll Whether to draw all models even if they been not yet initlaized for tracking (default = false).
+     */
+    void renderSilhouette(std::vector<Model*> models, bool invertDepth = false, bool drawAll = false);
+    
+    /**
+     *  Returns a copy of the most recently rendered image of the current
+     *  region of interest in the same format as RenderingEngine::downloadFrame.
+     *
+     *  @param type The frame type to be returned (MASK, DEPTH or LINEAR_DEPTH).
+     *
+     *  @return  The most recently rendered image according to the desired frame type.
+     */
+    cv::Mat downloadFrame(RenderingEngine::FrameType type);
+
+private:
+    int width;
+    int height;
+    
+    int fullWidth;
+    int fullHeight;
+    
+    float zNear;
+    float zFar;
+    
+    int numLevels;
+    
+    int currentLevel;
+    
+    std::vector<cv::Matx44f> calibrationMatrices;
+    cv::Matx44f projectionMatrix;
+    
+    cv::Rect roi;
+    
+    // the projection matrix mapping the region of interest to the whole image
+    cv::Matx44f roiProjectionMatrix;
+    cv::Matx44f lookAtMatrix;
+    
+    cv::Mat mask;
+    
+    // the depth buffer values as 24 bit integers
+    cv::Mat depth;
+    cv::Mat linearDepth;
+    
+    // the triangles of all models of the current rendering in the order of drawing
+    std::vector<RasterTriangle> triangles;
+    
+    // the indices of the triangles overlapping each band of rows
+    std::vector<std::vector<int> > bins;
+    
+    void clear(bool invertDepth);
+    
+    void setupTriangles(Model *model, uchar value);
+    
+    void rasterize(bool invertDepth);
+};
+
+
+/**
+ *  This class extends the OpenCV ParallelLoopBody for efficiently parallelized
+ *  computations. Within the corresponding for loop, the triangles of a mesh are
+ *  clipped in homogeneous coordinates, projected into the region of interest
+ *  and set up for rasterization.
+ */
+class Parallel_For_setupTriangles: public cv::ParallelLoopBody
+{
+private:
+    const cv::Vec4f *_clip;
+    const unsigned int *_indices;
+    
+    int _numTriangles;
+    
+    int _width;
+    int _height;
+    
+    uchar _value;
+    
+    std::vector<RasterTriangle>* _trianglesCollection;
+    
+    int _threads;
+    
+    static int64_t floorDiv(int64_t a, int64_t b)
+    {
+        return a >= 0 ? a/b : -((-a + b - 1)/b);
+    }
+    
+    void addTriangle(const cv::Vec4d &v0, const cv::Vec4d &v1, const cv::Vec4d &v2, std::vector<RasterTriangle> &triangles) const
+    {
+        // snap the vertices to 1/256 pixel
+        const cv::Vec4d *v[3] = {&v0, &v1, &v2};
+        int64_t x[3], y[3];
+        for(int k = 0; k < 3; k++)
+        {
+            x[k] = llround((*v[k])[0]*256.0);
+            y[k] = llround((*v[k])[1]*256.0);
+        }
+        
+        int64_t area = (x[1] - x[0])*(y[2] - y[0]) - (y[1] - y[0])*(x[2] - x[0]);
+        if(area == 0)
+            return;
+        
+        // both sides are drawn, so the vertices are ordered such that the triangle is left of its edges
+        if(area < 0)
+        {
+            std::swap(v[1], v[2]);
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+        }
+        
+        RasterTriangle t;
+        
+        // the pixels whose centers are within the bounding box
+        t.minX = (int)-floorDiv(-(std::min(x[0], std::min(x[1], x[2])) - 128), 256);
+        t.maxX = (int)floorDiv(std::max(x[0], std::max(x[1], x[2])) - 128, 256);
+        t.minY = (int)-floorDiv(-(std::min(y[0], std::min(y[1], y[2])) - 128), 256);
+        t.maxY = (int)floorDiv(std::max(y[0], std::max(y[1], y[2])) - 128, 256);
+        
+        t.minX = std::max(t.minX, 0);
+        t.maxX = std::min(t.maxX, _width - 1);
+        t.minY = std::max(t.minY, 0);
+        t.maxY = std::min(t.maxY, _height - 1);
+        
+        if(t.minX > t.maxX || t.minY > t.maxY)
+            return;
+        
+        for(int k = 0; k < 3; k++)
+        {
+            int l = (k + 1)%3;
+            t.ax[k] = x[k];
+            t.ay[k] = y[k];
+            t.dx[k] = x[l] - x[k];
+            t.dy[k] = y[l] - y[k];
+            
+            // top and left edges wrt the image rows, i.e. the triangle is below or right of them
+            bool topLeft = t.dy[k] < 0 || (t.dy[k] == 0 && t.dx[k] > 0);
+            t.bias[k] = topLeft ? 0 : 1;
+        }
+        
+        // the planes of the depth buffer value and of 1/w through the snapped vertices
+        t.x0 = x[0]/256.0;
+        t.y0 = y[0]/256.0;
+        double x1 = x[1]/256.0 - t.x0;
+        double y1 = y[1]/256.0 - t.y0;
+        double x2 = x[2]/256.0 - t.x0;
+        double y2 = y[2]/256.0 - t.y0;
+        double det = x1*y2 - x2*y1;
+        
+        t.depth0 = (*v[0])[2];
+        double d1 = (*v[1])[2] - t.depth0;
+        double d2 = (*v[2])[2] - t.depth0;
+        t.depthDx = (d1*y2 - d2*y1)/det;
+        t.depthDy = (d2*x1 - d1*x2)/det;
+        
+        t.invW0 = (*v[0])[3];
+        double w1 = (*v[1])[3] - t.invW0;
+        double w2 = (*v[2])[3] - t.invW0;
+        t.invWDx = (w1*y2 - w2*y1)/det;
+        t.invWDy = (w2*x1 - w1*x2)/det;
+        
+        t.value = _value;
+        
+        triangles.push_back(t);
+    }
+
+public:
+    Parallel_For_setupTriangles(const std::vector<cv::Vec4f> &clip, const std::vector<unsigned int> &indices, int width, int height, uchar value, std::vector<RasterTriangle>* trianglesCollection, int threads)
+    {
+        _clip = clip.data();
+        _indices = indices.data();
+        
+        _numTriangles = (int)indices.size()/3;
+        
+        _width = width;
+        _height = height;
+        
+        _value = value;
+        
+        _trianglesCollection = trianglesCollection;
+        
+        _threads = threads;
+    }
+    
+    virtual void operator()( const cv::Range &r ) const
+    {
+        int range = _numTriangles/_threads;
+        
+        int tEnd = r.end*range;
+        if(r.end == _threads)
+        {
+            tEnd = _numTriangles;
+        }
+        
+        std::vector<RasterTriangle> &triangles = _trianglesCollection[r.start];
+        
+        // the near and far planes and a guard band of 16 times the image, such
+        // that the fixed point coordinates cannot overflow
+        const float G = 16.0f;
+        const cv::Vec4f planes[6] = {cv::Vec4f(0, 0, 1, 1), cv::Vec4f(0, 0, -1, 1), cv::Vec4f(1, 0, 0, G), cv::Vec4f(-1, 0, 0, G), cv::Vec4f(0, 1, 0, G), cv::Vec4f(0, -1, 0, G)};
+        
+        cv::Vec4f polygons[2][9];
+        
+        for(int t = r.start*range; t < tEnd; t++)
+        {
+            const cv::Vec4f &c0 = _clip[_indices[3*t]];
+            const cv::Vec4f &c1 = _clip[_indices[3*t + 1]];
+            const cv::Vec4f &c2 = _clip[_indices[3*t + 2]];
+            
+            // reject triangles outside of a plane and only clip those crossing one
+            bool outside = false;
+            bool crossing = false;
+            for(int p = 0; p < 6 && !outside; p++)
+            {
+                int numInside = (planes[p].dot(c0) >= 0) + (planes[p].dot(c1) >= 0) + (planes[p].dot(c2) >= 0);
+                outside = numInside == 0;
+                crossing |= numInside < 3;
+            }
+            if(outside)
+                continue;
+            
+            cv::Vec4f *polygon = polygons[0];
+            polygon[0] = c0;
+            polygon[1] = c1;
+            polygon[2] = c2;
+            int n = 3;
+            
+            for(int p = 0; p < 6 && crossing && n >= 3; p++)
+            {
+                cv::Vec4f *clipped = (polygon == polygons[0]) ? polygons[1] : polygons[0];
+                int m = 0;
+                for(int i = 0; i < n; i++)
+                {
+                    const cv::Vec4f &a = polygon[i];
+                    const cv::Vec4f &b = polygon[(i + 1)%n];
+                    float da = planes[p].dot(a);
+                    float db = planes[p].dot(b);
+                    
+                    if(da >= 0)
+                        clipped[m++] = a;
+                    if((da >= 0) != (db >= 0))
+                        clipped[m++] = a + (da/(da - db))*(b - a);
+                }
+                polygon = clipped;
+                n = m;
+            }
+            
+            // the window coordinates, the depth buffer value and 1/w of the vertices
+            cv::Vec4d window[9];
+            for(int i = 0; i < n; i++)
+            {
+                double invW = 1.0/polygon[i][3];
+                window[i] = cv::Vec4d((polygon[i][0]*invW + 1.0)*0.5*_width,
+                                      (polygon[i][1]*invW + 1.0)*0.5*_height,
+                                      // the depth range is inverted
+                                      0.5 - 0.5*polygon[i][2]*invW,
+                                      invW);
+            }
+            
+            for(int i = 1; i + 1 < n; i++)
+            {
+                addTriangle(window[0], window[i], window[i + 1], triangles);
+            }
+        }
+    }
+};
+
+
+/**
+ *  This class extends the OpenCV ParallelLoopBody for efficiently parallelized
+ *  computations. Within the corresponding for loop, the triangles overlapping a
+ *  band of rows are rasterized into the mask, the depth buffer and the linear
+ *  depth map with a depth test.
+ */
+class Parallel_For_rasterize: public cv::ParallelLoopBody
+{
+private:
+    const RasterTriangle *_triangles;
+    const std::vector<int> *_bins;
+    
+    int _bandHeight;
+    
+    bool _invertDepth;
+    
+    cv::Mat _mask;
+    cv::Mat _depth;
+    cv::Mat _linearDepth;
+    
+    static int64_t floorDiv(int64_t a, int64_t b)
+    {
+        return a >= 0 ? a/b : -((-a + b - 1)/b);
+    }
+
+public:
+    Parallel_For_rasterize(const std::vector<RasterTriangle> &triangles, const std::vector<std::vector<int> > &bins, int bandHeight, bool invertDepth, cv::Mat &mask, cv::Mat &depth, cv::Mat &linearDepth)
+    {
+        _triangles = triangles.data();
+        _bins = bins.data();
+        
+        _bandHeight = bandHeight;
+        
+        _invertDepth = invertDepth;
+        
+        _mask = mask;
+        _depth = depth;
+        _linearDepth = linearDepth;
+    }
+    
+    virtual void operator()( const cv::Range &r ) const
+    {
+        const __m128 v_offsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        const __m128 v_scale = _mm_set1_ps(16777215.0f);
+        const __m128 v_zero = _mm_setzero_ps();
+        const __m128 v_one = _mm_set1_ps(1.0f);
+        
+        for(int b = r.start; b < r.end; b++)
+        {
+            int bandStart = b*_bandHeight;
+            int bandEnd = std::min(bandStart + _bandHeight, _mask.rows) - 1;
+            
+            const std::vector<int> &bin = _bins[b];
+            for(int i = 0; i < bin.size(); i++)
+            {
+                const RasterTriangle &t = _triangles[bin[i]];
+                
+                int yStart = std::max(t.minY, bandStart);
+                int yEnd = std::min(t.maxY, bandEnd);
+                
+                for(int y = yStart; y <= yEnd; y++)
+                {
+                    // the span of pixel centers covered by all three edges
+                    int64_t py = (int64_t)y*256 + 128;
+                    int64_t xs = t.minX;
+                    int64_t xe = t.maxX;
+                    for(int k = 0; k < 3; k++)
+                    {
+                        // the edge function at the center of pixel x is c + s*x
+                        int64_t c = t.dx[k]*(py - t.ay[k]) - t.dy[k]*(128 - t.ax[k]);
+                        int64_t s = -t.dy[k]*256;
+                        
+                        if(s > 0)
+                            xs = std::max(xs, -floorDiv(c - t.bias[k], s));
+                        else if(s < 0)
+                            xe = std::min(xe, floorDiv(c - t.bias[k], -s));
+                        else if(c < t.bias[k])
+                            xe = xs - 1;
+                    }
+                    if(xs > xe)
+                        continue;
+                    
+                    uchar *maskRow = (uchar*)_mask.ptr<uchar>(y);
+                    int *depthRow = (int*)_depth.ptr<int>(y);
+                    float *linearDepthRow = (float*)_linearDepth.ptr<float>(y);
+                    
+                    // the interpolated values at the first pixel of the span
+                    double fx = xs + 0.5 - t.x0;
+                    double fy = y + 0.5 - t.y0;
+                    float d = (float)(t.depth0 + t.depthDx*fx + t.depthDy*fy);
+                    float invW = (float)(t.invW0 + t.invWDx*fx + t.invWDy*fy);
+                    float dStep = (float)t.depthDx;
+                    float invWStep = (float)t.invWDx;
+                    
+                    __m128 v_d = _mm_set1_ps(d);
+                    __m128 v_dStep = _mm_set1_ps(dStep);
+                    __m128 v_invW = _mm_set1_ps(invW);
+                    __m128 v_invWStep = _mm_set1_ps(invWStep);
+                    
+                    int x = (int)xs;
+                    for(; x + 3 <= xe; x += 4)
+                    {
+                        __m128 v_i = _mm_add_ps(_mm_set1_ps((float)(x - xs)), v_offsets);
+                        
+                        // quantize the depth like a 24 bit depth buffer
+                        __m128 v_dx = _mm_min_ps(_mm_max_ps(_mm_add_ps(v_d, _mm_mul_ps(v_dStep, v_i)), v_zero), v_one);
+                        __m128i v_q = _mm_cvtps_epi32(_mm_mul_ps(v_dx, v_scale));
+                        
+                        __m128i v_old = _mm_loadu_si128((__m128i*)&depthRow[x]);
+                        __m128i v_pass = _invertDepth ? _mm_cmplt_epi32(v_q, v_old) : _mm_cmpgt_epi32(v_q, v_old);
+                        
+                        int pass = _mm_movemask_ps(_mm_castsi128_ps(v_pass));
+                        if(pass == 0)
+                            continue;
+                        
+                        _mm_storeu_si128((__m128i*)&depthRow[x], _mm_or_si128(_mm_and_si128(v_pass, v_q), _mm_andnot_si128(v_pass, v_old)));
+                        
+                        __m128 v_z = _mm_div_ps(v_one, _mm_add_ps(v_invW, _mm_mul_ps(v_invWStep, v_i)));
+                        __m128 v_oldZ = _mm_loadu_ps(&linearDepthRow[x]);
+                        __m128 v_passZ = _mm_castsi128_ps(v_pass);
+                        _mm_storeu_ps(&linearDepthRow[x], _mm_or_ps(_mm_and_ps(v_passZ, v_z), _mm_andnot_ps(v_passZ, v_oldZ)));
+                        
+                        for(int k = 0; k < 4; k++)
+                        {
+                            if(pass & (1 << k))
+                                maskRow[x + k] = t.value;
+                        }
+                    }
+                    
+                    for(; x <= xe; x++)
+                    {
+                        float i = (float)(x - xs);
+                        float dx = std::min(std::max(d + dStep*i, 0.0f), 1.0f);
+                        int q = cvRound(dx*16777215.0f);
+                        
+                        if(_invertDepth ? q < depthRow[x] : q > depthRow[x])
+                        {
+                            depthRow[x] = q;
+                            linearDepthRow[x] = 1.0f/(invW + invWStep*i);
+                            maskRow[x] = t.value;
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+
+#endif /* SOFTWARE_RASTERIZER_H */
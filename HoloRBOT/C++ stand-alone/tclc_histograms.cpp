@@ -65,9 +65,9 @@ TCLCHistograms::~TCLCHistograms()
     
 }
 
-void TCLCHistograms::update(const Mat &frame, const Mat &mask, const Mat &depth, Matx33f &K, float zNear, float zFar)
+void TCLCHistograms::update(const Mat &frame, const Mat &mask, const Mat &depth, Matx33f &K, FrameFormat format)
 {
-    _centersIDs = parallelComputeLocalHistogramCenters(mask, depth, K, zNear, zFar, 0);
+    _centersIDs = parallelComputeLocalHistogramCenters(mask, depth, K, 0);
     
     filterHistogramCenters(100, 10.0f);
     
@@ -81,14 +81,14 @@ void TCLCHistograms::update(const Mat &frame, const Mat &mask, const Mat &depth,
     
     Mat sumsFB = Mat::zeros((int)_centersIDs.size(), 1, CV_32SC2);
     
-    parallel_for_(cv::Range(0, threads), Parallel_For_buildLocalHistograms(frame, mask, _centersIDs, radius, numBins, notNormalizedFG, notNormalizedBG, sumsFB, _model->getModelID(), threads));
+    parallel_for_(cv::Range(0, threads), Parallel_For_buildLocalHistograms(frame, mask, _centersIDs, radius, numBins, notNormalizedFG, notNormalizedBG, sumsFB, _model->getModelID(), threads, format));
     
     parallel_for_(cv::Range(0, threads), Parallel_For_mergeLocalHistograms(notNormalizedFG, notNormalizedBG, normalizedFG, normalizedBG, initialized, _centersIDs, sumsFB, 0.1f, 0.2f, threads));
 }
 
-void TCLCHistograms::updateCentersAndIds(const cv::Mat &mask, const cv::Mat &depth, const cv::Matx33f &K, float zNear, float zFar, int level)
+void TCLCHistograms::updateCentersAndIds(const cv::Mat &mask, const cv::Mat &depth, const cv::Matx33f &K, int level)
 {
-    _centersIDs = parallelComputeLocalHistogramCenters(mask, depth, K, zNear, zFar, level);
+    _centersIDs = parallelComputeLocalHistogramCenters(mask, depth, K, level);
     
     filterHistogramCenters(100, 10.0f);
 }
@@ -124,7 +124,7 @@ vector<Point3i> TCLCHistograms::computeLocalHistogramCenters(const Mat &mask)
 }
 
 
-vector<Point3i> TCLCHistograms::parallelComputeLocalHistogramCenters(const Mat &mask, const Mat &depth, const Matx33f &K, float zNear, float zFar, int level)
+vector<Point3i> TCLCHistograms::parallelComputeLocalHistogramCenters(const Mat &mask, const Mat &depth, const Matx33f &K, int level)
 {
     vector<Point3i> res;
     
@@ -139,7 +139,7 @@ vector<Point3i> TCLCHistograms::parallelComputeLocalHistogramCenters(const Mat &
     
     int m_id = _model->getModelID();
     
-    parallel_for_(cv::Range(0, 8), Parallel_For_computeHistogramCenters(mask, depth, verticies, T_cm_n, K, zNear, zFar, m_id, level, centersIdsCollection.data(), 8));
+    parallel_for_(cv::Range(0, 8), Parallel_For_computeHistogramCenters(mask, depth, verticies, T_cm_n, K, m_id, level, centersIdsCollection.data(), 8));
     
     for(int i = 0; i < centersIdsCollection.size(); i++)
     {
@@ -39,6 +39,8 @@
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include "pixel_layout.h"
+
 class Model;
 
 /**
@@ -68,25 +70,22 @@ public:
      *
      *  @param  frame The color frame to be used for updating the histograms.
      *  @param  mask The corresponding binary shilhouette mask of the object.
-     *  @param  depth The per pixel depth map of the object used to filter histograms on the back of the object,
+     *  @param  depth The per pixel linear depth map of the object used to filter histograms on the back of the object,
      *  @param  K The camera's instrinsic matrix.
-     *  @param  zNear The near plane used to render the depth map.
-     *  @param  zFar The far plane used to render the depth map.
+     *  @param  format The format of the frame, the histograms are built in YUV for YUV frames (default = FRAME_FORMAT_BGR).
      */
-    void update(const cv::Mat &frame, const cv::Mat &mask, const cv::Mat &depth, cv::Matx33f &K, float zNear, float zFar);
+    void update(const cv::Mat &frame, const cv::Mat &mask, const cv::Mat &depth, cv::Matx33f &K, FrameFormat format = FRAME_FORMAT_BGR);
     
     /**
      *  Computes updated center locations and IDs of all histograms that project onto or close
      *  to the contour based on the current object pose at a specified image pyramid level.
      *
      *  @param  mask The binary shilhouette mask of the object.
-     *  @param  depth The per pixel depth map of the object used to filter histograms on the back of the object,
+     *  @param  depth The per pixel linear depth map of the object used to filter histograms on the back of the object,
      *  @param  K The camera's instrinsic matrix.
-     *  @param  zNear The near plane used to render the depth map.
-     *  @param  zFar The far plane used to render the depth map.
      *  @param  level The image pyramid level to be used for the update.
      */
-    void updateCentersAndIds(const cv::Mat &mask, const cv::Mat &depth, const cv::Matx33f &K, float zNear, float zFar, int level);
+    void updateCentersAndIds(const cv::Mat &mask, const cv::Mat &depth, const cv::Matx33f &K, int level);
     
     /**
      *  Returns all normalized forground histograms in their current state.
@@ -178,7 +177,7 @@ private:
     
     std::vector<cv::Point3i> computeLocalHistogramCenters(const cv::Mat &mask);
     
-    std::vector<cv::Point3i> parallelComputeLocalHistogramCenters(const cv::Mat &mask, const cv::Mat &depth, const cv::Matx33f &K, float zNear, float zFar, int level);
+    std::vector<cv::Point3i> parallelComputeLocalHistogramCenters(const cv::Mat &mask, const cv::Mat &depth, const cv::Matx33f &K, int level);
     
     void filterHistogramCenters(int numHistograms, float offset);
 };
@@ -202,6 +201,8 @@ private:
     size_t frameStep;
     size_t maskStep;
     
+    PixelLayout layout;
+    
     cv::Size size;
     
     std::vector<cv::Point3i> _centers;
@@ -226,7 +227,7 @@ private:
     int _threads;
     
 public:
-    Parallel_For_buildLocalHistograms(const cv::Mat &frame, const cv::Mat &mask, const std::vector<cv::Point3i> &centers, float radius, int numBins, cv::Mat &localHistogramsFG, cv::Mat &localHistogramsBG, cv::Mat &sumsFB, int m_id, int threads)
+    Parallel_For_buildLocalHistograms(const cv::Mat &frame, const cv::Mat &mask, const std::vector<cv::Point3i> &centers, float radius, int numBins, cv::Mat &localHistogramsFG, cv::Mat &localHistogramsBG, cv::Mat &sumsFB, int m_id, int threads, FrameFormat format = FRAME_FORMAT_BGR)
     {
         _frame = frame;
         _mask = mask;
@@ -237,6 +238,8 @@ public:
         frameStep = _frame.step;
         maskStep = _mask.step;
         
+        layout = PixelLayout(_frame, format);
+        
         size = frame.size();
         
         _centers = centers;
@@ -261,22 +264,14 @@ public:
         _threads = threads;
     }
     
-    void processLine(uchar *frameRow, uchar* maskRow, int xl, int xr, int* localHistogramFG, int* localHistogramBG, int* sumFB) const
+    void processLine(uchar *frameRow, uchar* maskRow, int y, int xl, int xr, int* localHistogramFG, int* localHistogramBG, int* sumFB) const
     {
-        uchar* frame_ptr = (uchar*)(frameRow) + 3*xl;
-        
         uchar* mask_ptr = (uchar*)(maskRow) + xl;
         uchar* mask_max_ptr = (uchar*)(maskRow) + xr;
         
-        for( ; mask_ptr <= mask_max_ptr; mask_ptr += 1, frame_ptr += 3)
+        for(int x = xl; mask_ptr <= mask_max_ptr; mask_ptr += 1, x++)
         {
-            int pidx;
-            int ru, gu, bu;
-            
-            ru = (frame_ptr[0] >> _binShift);
-            gu = (frame_ptr[1] >> _binShift);
-            bu = (frame_ptr[2] >> _binShift);
-            pidx = (ru * _numBins + gu) * _numBins + bu;
+            int pidx = layout.bin(frameRow, x, y, _binShift, _numBins);
             
             if(*mask_ptr == _m_id)
             {
@@ -337,8 +332,8 @@ public:
                     uchar *maskRow0 = maskData + y11 * maskStep;
                     uchar *maskRow1 = maskData + y12 * maskStep;
                     
-                    processLine(frameRow0, maskRow0, x11, x12, localHistogramFG, localHistogramBG, sumFB);
-                    if(y11 != y12) processLine(frameRow1, maskRow1, x11, x12, localHistogramFG, localHistogramBG, sumFB);
+                    processLine(frameRow0, maskRow0, y11, x11, x12, localHistogramFG, localHistogramBG, sumFB);
+                    if(y11 != y12) processLine(frameRow1, maskRow1, y12, x11, x12, localHistogramFG, localHistogramBG, sumFB);
                     
                     frameRow0 = frameData + y21 * frameStep;
                     frameRow1 = frameData + y22 * frameStep;
@@ -348,8 +343,8 @@ public:
                     
                     if(olddx != dx)
                     {
-                        if(y11 != y21) processLine(frameRow0, maskRow0, x21, x22, localHistogramFG, localHistogramBG, sumFB);
-                        if(y12 != y22) processLine(frameRow1, maskRow1, x21, x22, localHistogramFG, localHistogramBG, sumFB);
+                        if(y11 != y21) processLine(frameRow0, maskRow0, y21, x21, x22, localHistogramFG, localHistogramBG, sumFB);
+                        if(y12 != y22) processLine(frameRow1, maskRow1, y22, x21, x22, localHistogramFG, localHistogramBG, sumFB);
                     }
                 }
                 else if( x11 < size.width && x12 >= 0 && y21 < size.height && y22 >= 0 )
@@ -362,7 +357,7 @@ public:
                         uchar *frameRow = frameData + y11 * frameStep;
                         uchar *maskRow = maskData + y11 * maskStep;
                         
-                        processLine(frameRow, maskRow, x11, x12, localHistogramFG, localHistogramBG, sumFB);
+                        processLine(frameRow, maskRow, y11, x11, x12, localHistogramFG, localHistogramBG, sumFB);
                     }
                     
                     if( (unsigned)y12 < (unsigned)size.height && (y11 != y12))
@@ -370,7 +365,7 @@ public:
                         uchar *frameRow = frameData + y12 * frameStep;
                         uchar *maskRow = maskData + y12 * maskStep;
                         
-                        processLine(frameRow, maskRow, x11, x12, localHistogramFG, localHistogramBG, sumFB);
+                        processLine(frameRow, maskRow, y12, x11, x12, localHistogramFG, localHistogramBG, sumFB);
                     }
                     
                     if( x21 < size.width && x22 >= 0 && (olddx != dx))
@@ -383,7 +378,7 @@ public:
                             uchar *frameRow = frameData + y21 * frameStep;
                             uchar *maskRow = maskData + y21 * maskStep;
                             
-                            processLine(frameRow, maskRow, x21, x22, localHistogramFG, localHistogramBG, sumFB);
+                            processLine(frameRow, maskRow, y21, x21, x22, localHistogramFG, localHistogramBG, sumFB);
                         }
                         
                         if( (unsigned)y22 < (unsigned)size.height )
@@ -391,7 +386,7 @@ public:
                             uchar *frameRow = frameData + y22 * frameStep;
                             uchar *maskRow = maskData + y22 * maskStep;
                             
-                            processLine(frameRow, maskRow, x21, x22, localHistogramFG, localHistogramBG, sumFB);
+                            processLine(frameRow, maskRow, y22, x21, x22, localHistogramFG, localHistogramBG, sumFB);
                         }
                     }
                 }
@@ -564,9 +559,6 @@ private:
     cv::Matx44f _T_cm;
     cv::Matx33f _K;
     
-    float _zNear;
-    float _zFar;
-    
     int _m_id;
     
     int _level;
@@ -577,7 +569,7 @@ private:
     int _threads;
     
 public:
-    Parallel_For_computeHistogramCenters(const cv::Mat &mask, const cv::Mat &depth, const std::vector<cv::Vec3f> &verticies, const cv::Matx44f &T_cm, const cv::Matx33f &K, float zNear, float zFar, int m_id, int level, std::vector<cv::Point3i>* centersIds, int threads)
+    Parallel_For_computeHistogramCenters(const cv::Mat &mask, const cv::Mat &depth, const std::vector<cv::Vec3f> &verticies, const cv::Matx44f &T_cm, const cv::Matx33f &K, int m_id, int level, std::vector<cv::Point3i>* centersIds, int threads)
     {
         _verticies = verticies;
         
@@ -603,9 +595,6 @@ public:
         _T_cm = T_cm;
         _K = K;
         
-        _zNear = zNear;
-        _zFar = zFar;
-        
         _m_id = m_id;
         
         _centersIds = centersIds;
@@ -642,11 +631,10 @@ public:
             
             if(x >= 0 && x < _depth.cols && y >= 0 && y < _depth.rows)
             {
-                float d = 1.0f - _depth.at<float>(y, x);
-                
-                float Z_d = 2.0f * _zNear * _zFar / (_zFar + _zNear - (2.0f*(d) - 1.0) * (_zFar - _zNear));
+                float Z_d = _depth.at<float>(y, x);
                 
-                if(fabs(Z_c - Z_d) < 1.0f || d == 1.0)
+                // the linear depth map is 0 where the object has not been rendered
+                if(fabs(Z_c - Z_d) < 1.0f || Z_d == 0)
                 {
                     int xi = (int)x;
                     int yi = (int)y;
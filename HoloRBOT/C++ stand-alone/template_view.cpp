@@ -38,29 +38,10 @@
 using namespace std;
 using namespace cv;
 
-TemplateView::TemplateView(Object3D *object, float alpha, float beta, float gamma, float distance, int numLevels, bool generateNeighbors)
+TemplateView::TemplateView(float alpha, float beta, float gamma, float distance, int numLevels, bool generateNeighbors)
 {
     T_cm = Transformations::translationMatrix(0, 0, distance)*Transformations::rotationMatrix(gamma, Vec3f(0, 0, 1))*Transformations::rotationMatrix(alpha, Vec3f(1, 0, 0))*Transformations::rotationMatrix(beta, Vec3f(0, 1, 0));
     
-    object->setPose(T_cm);
-    
-    renderingEngine = RenderingEngine::Instance();
-    
-    renderingEngine->setLevel(0);
-    renderingEngine->renderSilhouette(object, GL_FILL, false, 1.0f, 1.0f, 1.0f, true);
-    
-    Mat mask0 = renderingEngine->downloadFrame(RenderingEngine::MASK);
-    Mat depth0 = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
-    
-    Matx33f K = renderingEngine->getCalibrationMatrix().get_minor<3, 3>(0, 0);
-    
-    float zNear = renderingEngine->getZNear();
-    float zFar = renderingEngine->getZFar();
-    
-    TCLCHistograms *tclcHistograms = object->getTCLCHistograms();
-    
-    int m_id = object->getModelID();
-    
     _alpha = alpha;
     _beta = beta;
     _gamma = gamma;
@@ -76,82 +57,87 @@ TemplateView::TemplateView(Object3D *object, float alpha, float beta, float gamm
     sdtPyramid.resize(_numLevels);
     heavisidePyramid.resize(_numLevels);
     pixelDataPyramid.resize(_numLevels);
+}
+
+
+TemplateView::~TemplateView()
+{
+    for(int i = 0; i < pixelDataPyramid.size(); i++)
+    {
+        for(int j = 0; j < pixelDataPyramid[i].size(); j++)
+        {
+            delete[] pixelDataPyramid[i][j].ids;
+        }
+        pixelDataPyramid[i].clear();
+    }
+    pixelDataPyramid.clear();
+}
+
+void TemplateView::computeHistogramCenters(Object3D *object, const Mat &mask, const Mat &depth, const Point &offset, const Matx33f &K, const Size &imageSize)
+{
+    object->setPose(T_cm);
     
-    SignedDistanceTransform2D SDT2D(8.0f);
+    TCLCHistograms *tclcHistograms = object->getTCLCHistograms();
     
-    Size maxSize = mask0.size();
+    int m_id = object->getModelID();
+    
+    // the vertices are projected into the region
+    Matx33f K_roi = K;
+    K_roi(0, 2) -= offset.x;
+    K_roi(1, 2) -= offset.y;
+    
+    tclcHistograms->updateCentersAndIds(mask/255*m_id, depth, K_roi, 0);
+    
+    vector<Point3i> centersIDs = tclcHistograms->getCentersAndIDs();
+    for(int i = 0; i < centersIDs.size(); i++)
+    {
+        centersIDs[i].x += offset.x;
+        centersIDs[i].y += offset.y;
+    }
     
     for(int level = 2; level < _numLevels; level++)
     {
         int scale = pow(2, level);
-  
-        //cout << "mask0->downloadFrame" << endl;
-        //cout << "depth0->downloadFrame" << endl;
-        tclcHistograms->updateCentersAndIds(mask0/255*m_id, depth0, K, zNear, zFar, 0);
-    
-        std::vector<cv::Point3i> centersIDs = tclcHistograms->getCentersAndIDs();
         
         centersIDsPyramid[level] = centersIDs;
-    
-        int offset = tclcHistograms->getRadius()/pow(2, level);
-        
-        //cout << "ROI start" << endl;
-        //cout << "centersIDs :" << centersIDs << endl;
-        //cout << "offset :" << offset << endl;
-        //cout << "level :" << level << endl;
-        //cout << "Size(maxSize.width/scale, maxSize.height/scale) :" << Size(maxSize.width/scale, maxSize.height/scale) << endl;
-    
-        Rect roi = computeBoundingBox(centersIDs, offset, level, Size(maxSize.width/scale, maxSize.height/scale));
-        
-        //cout << "ROI [x] :" << roi.x << endl;
-        //cout << "ROI [y] :" << roi.y << endl;
-        //cout << "ROI [w] :" << roi.width << endl;
-        //cout << "ROI [h] :" << roi.height << endl;
-        
-        roiPyramid[level] = roi;
-    
-        renderingEngine->setLevel(level);
-        renderingEngine->renderSilhouette(object, GL_FILL, false, 1.0f, 1.0f, 1.0f, true);
         
-        Mat mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
-        //cout << "ROI mid" << endl;
-        mask = mask(roi).clone();
+        int margin = tclcHistograms->getRadius()/pow(2, level);
         
-        
-        etaFPyramid[level] = countNonZero(mask);
-        
-        maskPyramid[level] = mask*255;
-        
-        Mat sdt, xyPos;
-        SDT2D.computeTransform(mask, sdt, xyPos, 8);
-    
-        sdtPyramid[level] = sdt;
-        
-        Mat heaviside;
-        parallel_for_(cv::Range(0, 8), Parallel_For_convertToHeaviside(sdt, heaviside, 8));
-        
-        heavisidePyramid[level] = heaviside;
-        
-        //cout << "ROI end" << endl;
-        
-        compressTemplateData(centersIDs, heaviside, roi, tclcHistograms->getRadius(), level);
+        roiPyramid[level] = computeBoundingBox(centersIDs, margin, level, Size(imageSize.width/scale, imageSize.height/scale));
     }
 }
 
 
-TemplateView::~TemplateView()
+void TemplateView::computeTemplate(Object3D *object, int level, const Mat &mask)
 {
-    for(int i = 0; i < pixelDataPyramid.size(); i++)
+    Rect roi = roiPyramid[level];
+    
+    if(mask.empty())
     {
-        for(int j = 0; j < pixelDataPyramid[i].size(); j++)
-        {
-            delete[] pixelDataPyramid[i][j].ids;
-        }
-        pixelDataPyramid[i].clear();
+        etaFPyramid[level] = 0;
+        return;
     }
-    pixelDataPyramid.clear();
+    
+    etaFPyramid[level] = countNonZero(mask);
+    
+    maskPyramid[level] = mask*255;
+    
+    SignedDistanceTransform2D SDT2D(8.0f);
+    
+    Mat sdt, xyPos;
+    SDT2D.computeTransform(mask.clone(), sdt, xyPos, 8);
+    
+    sdtPyramid[level] = sdt;
+    
+    Mat heaviside;
+    parallel_for_(cv::Range(0, 8), Parallel_For_convertToHeaviside(sdt, heaviside, 8));
+    
+    heavisidePyramid[level] = heaviside;
+    
+    compressTemplateData(centersIDsPyramid[level], heaviside, roi, object->getTCLCHistograms()->getRadius(), level);
 }
 
+
 Matx44f TemplateView::getPose()
 {
     return T_cm;
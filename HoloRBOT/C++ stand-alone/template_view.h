@@ -74,9 +74,12 @@ class TemplateView {
 public:
     /**
      *  Constructor for the template view at a given object rotation and
-     *  distance to the camera.
+     *  distance to the camera. The template itself is computed afterwards
+     *  from renderings of the object in the pose of the template, first with
+     *  computeHistogramCenters and then with computeTemplate for every
+     *  pyramid level from 2 on, such that the renderings of many templates
+     *  can be batched (see Object3D::generateTemplates).
      *
-     *  @param  object The 3D object for which the template view is to be created.
      *  @param  alpha The Euler angle of the object's rotation around the x-axis (in degrees).
      *  @param  beta The Euler angle of the object's rotation around the y-axis (in degrees).
      *  @param  gamma The Euler angle of the object's rotation around the z-axis (in degrees).
@@ -84,10 +87,37 @@ public:
      *  @param  numLevels Number of template pyramid levels to be created with a downscale factor of 2.
      *  @param  generateNeighbors A flag telling whether neighboring templates should also be created or not.
      */
-    TemplateView(Object3D *object, float alpha, float beta, float gamma, float distance, int numLevels, bool generateNeighbors);
+    TemplateView(float alpha, float beta, float gamma, float distance, int numLevels, bool generateNeighbors);
     
     ~TemplateView();
     
+    /**
+     *  Computes the 2D centers of the object's tclc-histograms in the template
+     *  and the regions of interest of all pyramid levels from a rendering of
+     *  the object in the pose of the template at pyramid level 0, which may be
+     *  cropped to a region containing the whole silhouette. The pose of the
+     *  object is changed.
+     *
+     *  @param  object The 3D object for which the template view is created.
+     *  @param  mask The rendered silhouette mask (see RenderingEngine::MASK) of the region.
+     *  @param  depth The rendered linear depth map (see RenderingEngine::LINEAR_DEPTH) of the region.
+     *  @param  offset The top left corner of the region in the image.
+     *  @param  K The intrinsic camera matrix of pyramid level 0.
+     *  @param  imageSize The size of the rendered image at pyramid level 0.
+     */
+    void computeHistogramCenters(Object3D *object, const cv::Mat &mask, const cv::Mat &depth, const cv::Point &offset, const cv::Matx33f &K, const cv::Size &imageSize);
+    
+    /**
+     *  Computes the template at a given pyramid level from a rendering of the
+     *  object in the pose of the template, cropped to the region of interest
+     *  of that level (see getROI).
+     *
+     *  @param  object The 3D object for which the template view is created.
+     *  @param  level The pyramid level to be computed.
+     *  @param  mask The rendered silhouette mask (see RenderingEngine::MASK) of the region of interest.
+     */
+    void computeTemplate(Object3D *object, int level, const cv::Mat &mask);
+    
     /**
      *  Returns the 6DOF object pose coresponding to the
      *  template view in form of a 4x4 float matrix
@@ -230,8 +260,6 @@ public:
     std::vector<TemplateView*> getNeighborTemplates();
     
 private:
-    RenderingEngine *renderingEngine;
-    
     cv::Matx44f T_cm;
     
     std::vector<int> etaFPyramid;
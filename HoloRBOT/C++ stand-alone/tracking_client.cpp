@@ -0,0 +1,206 @@
+#include "tracking_client.h"
+
+#include <iostream>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+using namespace cv;
+
+TrackingClient::TrackingClient() : socket(io_cont)
+{
+    codec = FRAME_CODEC_RAW;
+    maxWidth = 0;
+    maxHeight = 0;
+    
+    // send the whole image until the server requests something else
+    crop.magic = CROP_MAGIC;
+    crop.frameID = 0;
+    crop.x = 0;
+    crop.y = 0;
+    crop.width = 0;
+    crop.height = 0;
+    crop.scaleShift = 0;
+}
+
+
+TrackingClient::~TrackingClient()
+{
+    close();
+}
+
+
+bool TrackingClient::connect(const std::string &host, int port, uint32_t supportedCodecs, boost::system::error_code &error)
+{
+    boost::asio::ip::tcp::resolver resolver(io_cont);
+    boost::asio::ip::tcp::resolver::results_type endpoints = resolver.resolve(host, to_string(port), error);
+    if(error)
+        return false;
+    
+    boost::asio::connect(socket, endpoints, error);
+    if(error)
+        return false;
+    
+    socket.set_option(boost::asio::ip::tcp::no_delay(true), error);
+    
+    HelloMessage hello;
+    hello.magic = HELLO_MAGIC;
+    hello.version = PROTOCOL_VERSION;
+    hello.supportedCodecs = supportedCodecs;
+    boost::asio::write(socket, boost::asio::buffer(&hello, sizeof(HelloMessage)), error);
+    if(error)
+        return false;
+    
+    HelloReply reply;
+    boost::asio::read(socket, boost::asio::buffer(&reply, sizeof(HelloReply)), boost::asio::transfer_exactly(sizeof(HelloReply)), error);
+    if(error)
+        return false;
+    
+    if(reply.magic != HELLO_MAGIC || !(supportedCodecs & (1 << reply.codec)))
+    {
+        cout << "server does not support any of the client's codecs" << endl;
+        error = boost::asio::error::operation_not_supported;
+        return false;
+    }
+    
+    codec = reply.codec;
+    maxWidth = reply.maxWidth;
+    maxHeight = reply.maxHeight;
+    
+    return true;
+}
+
+
+void TrackingClient::close()
+{
+    boost::system::error_code error;
+    socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, error);
+    socket.close(error);
+}
+
+
+bool TrackingClient::sendFrame(const cv::Mat &image, uint32_t frameID, uint64_t captureTimestamp, uint64_t displayTimestamp, boost::system::error_code &error)
+{
+    CropRequest request;
+    {
+        lock_guard<mutex> lock(cropMutex);
+        request = crop;
+    }
+    
+    // the region is aligned to the scale, such that the downscaled frame covers it exactly
+    int shift = min((int)request.scaleShift, 3);
+    Rect region = Rect(request.x, request.y, request.width, request.height) & Rect(0, 0, image.cols, image.rows);
+    if(region.area() == 0)
+    {
+        region = Rect(0, 0, image.cols, image.rows);
+        shift = 0;
+    }
+    region.width &= ~((1 << shift) - 1);
+    region.height &= ~((1 << shift) - 1);
+    
+    Mat roi = image(region);
+    if(shift > 0)
+        resize(roi, scaled, Size(region.width >> shift, region.height >> shift), 0, 0, INTER_AREA);
+    else
+        scaled = roi;
+    
+    FrameHeader header;
+    header.magic = FRAME_MAGIC;
+    header.frameID = frameID;
+    header.captureTimestamp = captureTimestamp;
+    header.width = scaled.cols;
+    header.height = scaled.rows;
+    header.pixelFormat = (scaled.channels() == 4) ? PIXEL_FORMAT_BGRA : PIXEL_FORMAT_BGR;
+    header.cropX = region.x;
+    header.cropY = region.y;
+    header.scaleShift = shift;
+    header.displayTimestamp = displayTimestamp;
+    
+    const uchar *payload;
+    if(codec == FRAME_CODEC_RAW)
+    {
+        // a cropped frame is not continuous in memory
+        if(!scaled.isContinuous())
+            scaled = scaled.clone();
+        payload = scaled.data;
+        header.payloadLength = (uint32_t)(scaled.total()*scaled.elemSize());
+    }
+    else
+    {
+        if(scaled.channels() == 4)
+        {
+            cvtColor(scaled, converted, COLOR_BGRA2BGR);
+            scaled = converted;
+        }
+        imencode((codec == FRAME_CODEC_JPEG) ? ".jpg" : ".png", scaled, encoded);
+        payload = encoded.data();
+        header.payloadLength = (uint32_t)encoded.size();
+    }
+    
+    vector<boost::asio::const_buffer> buffers;
+    buffers.push_back(boost::asio::buffer(&header, sizeof(FrameHeader)));
+    buffers.push_back(boost::asio::buffer(payload, header.payloadLength));
+    
+    lock_guard<mutex> lock(sendMutex);
+    boost::asio::write(socket, buffers, error);
+    
+    return !error;
+}
+
+
+bool TrackingClient::sendCommand(uint32_t command, int objectIndex, boost::system::error_code &error)
+{
+    CommandMessage message;
+    message.magic = COMMAND_MAGIC;
+    message.command = command;
+    message.objectIndex = objectIndex;
+    
+    lock_guard<mutex> lock(sendMutex);
+    boost::asio::write(socket, boost::asio::buffer(&message, sizeof(CommandMessage)), error);
+    
+    return !error;
+}
+
+
+bool TrackingClient::receiveReply(CropRequest &request, PoseReply &reply, std::vector<ObjectPose> &poses, boost::system::error_code &error)
+{
+    boost::asio::read(socket, boost::asio::buffer(&request, sizeof(CropRequest)), boost::asio::transfer_exactly(sizeof(CropRequest)), error);
+    if(error)
+        return false;
+    
+    if(request.magic != CROP_MAGIC)
+    {
+        cout << "received malformed crop request" << endl;
+        error = boost::asio::error::invalid_argument;
+        return false;
+    }
+    
+    boost::asio::read(socket, boost::asio::buffer(&reply, sizeof(PoseReply)), boost::asio::transfer_exactly(sizeof(PoseReply)), error);
+    if(error)
+        return false;
+    
+    // a sane server never tracks more than a handful of objects
+    if(reply.magic != POSE_MAGIC || reply.numObjects > 256)
+    {
+        cout << "received malformed pose reply" << endl;
+        error = boost::asio::error::invalid_argument;
+        return false;
+    }
+    
+    poses.resize(reply.numObjects);
+    boost::asio::read(socket, boost::asio::buffer(poses), boost::asio::transfer_exactly(reply.numObjects*sizeof(ObjectPose)), error);
+    if(error)
+        return false;
+    
+    lock_guard<mutex> lock(cropMutex);
+    crop = request;
+    
+    return true;
+}
+
+
+uint32_t TrackingClient::getCodec()
+{
+    return codec;
+}
@@ -0,0 +1,104 @@
+#ifndef TRACKING_CLIENT_H
+#define TRACKING_CLIENT_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "boost/asio.hpp"
+#include "boost/asio/ip/tcp.hpp"
+
+#include <opencv2/core.hpp>
+
+#include "frame_protocol.h"
+
+/**
+ *  The client side of the tracking server protocol, as implemented by the
+ *  HoloLens app: it negotiates the codec, sends camera frames cropped and
+ *  scaled as requested by the server and receives the crop requests and
+ *  poses sent back. Sending and receiving may be done by different threads.
+ */
+class TrackingClient
+{
+public:
+    TrackingClient();
+    
+    ~TrackingClient();
+    
+    /**
+     *  Connects to a tracking server and performs the handshake.
+     *
+     *  @param  host The host name or address of the server.
+     *  @param  port The TCP port of the server.
+     *  @param  supportedCodecs A bit mask with bit (1 << codec) set for every FrameCodec the client is willing to use.
+     *  @param  error The socket error in case connecting failed.
+     *  @return True if the connection was established and false otherwise.
+     */
+    bool connect(const std::string &host, int port, uint32_t supportedCodecs, boost::system::error_code &error);
+    
+    /**
+     *  Closes the connection, which also wakes up a thread blocked in receiveReply.
+     */
+    void close();
+    
+    /**
+     *  Sends a camera frame, restricted to the region and scale requested by
+     *  the last crop request received from the server. The frame is encoded
+     *  with the negotiated codec.
+     *
+     *  @param  image The full resolution camera image (BGR or BGRA).
+     *  @param  frameID The consecutive number of the frame.
+     *  @param  captureTimestamp The capture time of the frame in microseconds.
+     *  @param  displayTimestamp The time the poses will be displayed at in microseconds (0 = no extrapolation).
+     *  @param  error The socket error in case sending failed.
+     *  @return True if the frame was sent and false otherwise.
+     */
+    bool sendFrame(const cv::Mat &image, uint32_t frameID, uint64_t captureTimestamp, uint64_t displayTimestamp, boost::system::error_code &error);
+    
+    /**
+     *  Sends a command controlling the tracking, which the server applies
+     *  before processing the next frame.
+     *
+     *  @param  command One of TrackingCommand.
+     *  @param  objectIndex The index of the object the command refers to, -1 for all objects.
+     *  @param  error The socket error in case sending failed.
+     *  @return True if the command was sent and false otherwise.
+     */
+    bool sendCommand(uint32_t command, int objectIndex, boost::system::error_code &error);
+    
+    /**
+     *  Waits for the reply to a processed frame, i.e. the crop request for
+     *  the next frame followed by the pose reply with the poses of all
+     *  objects. The crop request is applied to all frames sent afterwards.
+     *
+     *  @param  request The received crop request.
+     *  @param  reply The received pose reply including the timestamps of the frame.
+     *  @param  poses The received poses, one per object.
+     *  @param  error The socket error in case receiving failed.
+     *  @return True if a reply was received and false otherwise.
+     */
+    bool receiveReply(CropRequest &request, PoseReply &reply, std::vector<ObjectPose> &poses, boost::system::error_code &error);
+    
+    uint32_t getCodec();
+
+private:
+    boost::asio::io_context io_cont;
+    boost::asio::ip::tcp::socket socket;
+    
+    uint32_t codec;
+    int maxWidth;
+    int maxHeight;
+    
+    // the crop requested for the next frame, written by the receiving and read by the sending thread
+    std::mutex cropMutex;
+    CropRequest crop;
+    
+    // commands may be sent by another thread than the frames, they must not end up inside a frame
+    std::mutex sendMutex;
+    
+    cv::Mat scaled;
+    cv::Mat converted;
+    std::vector<uchar> encoded;
+};
+
+#endif /* TRACKING_CLIENT_H */
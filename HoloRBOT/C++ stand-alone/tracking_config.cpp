@@ -0,0 +1,261 @@
+#include "tracking_config.h"
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+using namespace cv;
+
+TrackingConfig::TrackingConfig()
+{
+    width = 1408;
+    height = 792;
+    
+    K = Matx33f(1031.328, 0, 679.696, 0, 1034.549, 394.479, 0, 0, 1);
+    distCoeffs = Matx14f(0.231, -0.367, -0.0016, -0.0013);
+    
+    zNear = 10.0;
+    zFar = 10000.0;
+    
+    templateDistances = {200.0f, 400.0f, 600.0f};
+    
+    ObjectConfig eggbox = {"data/eggbox.obj", 15, -0, 500, 195, -10, -20, 1.0, 0.55f};
+    objects.push_back(eggbox);
+    
+    port = 27015;
+    numWorkers = 2;
+    sharedMemoryName = "";
+    
+    headless = false;
+    autoStart = false;
+    overlayInterval = 1;
+    
+    cropMargin = 64;
+    fullFrameInterval = 30;
+    
+    decoderThreads = 2;
+    
+    motionSmoothing = 0.5f;
+    maxExtrapolation = 0.1f;
+    
+    recordDirectory = "";
+    
+    halfFloatDepth = false;
+}
+
+
+// only overwrite the value if the key exists, reading a missing key would reset it
+template<typename T> static void readValue(const FileNode &node, T &value)
+{
+    if(!node.empty())
+        node >> value;
+}
+
+
+static void readValue(const FileNode &node, bool &value)
+{
+    if(!node.empty())
+        value = (int)node != 0;
+}
+
+
+static vector<float> splitValues(const string &list)
+{
+    vector<float> values;
+    stringstream stream(list);
+    string value;
+    while(getline(stream, value, ','))
+    {
+        values.push_back((float)atof(value.c_str()));
+    }
+    return values;
+}
+
+
+bool TrackingConfig::load(const std::string &filename)
+{
+    FileStorage fs(filename, FileStorage::READ);
+    if(!fs.isOpened())
+    {
+        cout << "Could not open the configuration file: \"" << filename << "\"" << endl;
+        return false;
+    }
+    
+    read(fs);
+    return true;
+}
+
+
+bool TrackingConfig::loadString(const std::string &yaml)
+{
+    FileStorage fs(yaml, FileStorage::READ | FileStorage::MEMORY);
+    if(!fs.isOpened())
+        return false;
+    
+    read(fs);
+    return true;
+}
+
+
+void TrackingConfig::read(const FileStorage &fs)
+{
+    readValue(fs["width"], width);
+    readValue(fs["height"], height);
+    readValue(fs["camera_matrix"], K);
+    readValue(fs["distortion_coefficients"], distCoeffs);
+    readValue(fs["z_near"], zNear);
+    readValue(fs["z_far"], zFar);
+    readValue(fs["template_distances"], templateDistances);
+    
+    FileNode objectsNode = fs["objects"];
+    if(objectsNode.isSeq())
+    {
+        objects.clear();
+        for(FileNodeIterator it = objectsNode.begin(); it != objectsNode.end(); ++it)
+        {
+            FileNode node = *it;
+            
+            vector<float> pose;
+            node["pose"] >> pose;
+            pose.resize(6, 0.0f);
+            
+            ObjectConfig object = {"", pose[0], pose[1], pose[2], pose[3], pose[4], pose[5], 1.0f, 0.55f};
+            readValue(node["file"], object.filename);
+            readValue(node["scale"], object.scale);
+            readValue(node["quality_threshold"], object.qualityThreshold);
+            objects.push_back(object);
+        }
+    }
+    
+    readValue(fs["port"], port);
+    readValue(fs["workers"], numWorkers);
+    readValue(fs["shared_memory"], sharedMemoryName);
+    readValue(fs["headless"], headless);
+    readValue(fs["auto_start"], autoStart);
+    readValue(fs["overlay_interval"], overlayInterval);
+    readValue(fs["crop_margin"], cropMargin);
+    readValue(fs["full_frame_interval"], fullFrameInterval);
+    readValue(fs["decoder_threads"], decoderThreads);
+    readValue(fs["motion_smoothing"], motionSmoothing);
+    readValue(fs["max_extrapolation"], maxExtrapolation);
+    readValue(fs["record_directory"], recordDirectory);
+    readValue(fs["half_float_depth"], halfFloatDepth);
+}
+
+
+std::string TrackingConfig::toString() const
+{
+    FileStorage fs(".yml", FileStorage::WRITE | FileStorage::MEMORY | FileStorage::FORMAT_YAML);
+    
+    fs << "width" << width;
+    fs << "height" << height;
+    fs << "camera_matrix" << Mat(K);
+    fs << "distortion_coefficients" << Mat(distCoeffs);
+    fs << "z_near" << zNear;
+    fs << "z_far" << zFar;
+    fs << "template_distances" << templateDistances;
+    
+    fs << "objects" << "[";
+    for(int i = 0; i < objects.size(); i++)
+    {
+        const ObjectConfig &o = objects[i];
+        vector<float> pose = {o.tx, o.ty, o.tz, o.alpha, o.beta, o.gamma};
+        fs << "{:" << "file" << o.filename << "pose" << pose << "scale" << o.scale << "quality_threshold" << o.qualityThreshold << "}";
+    }
+    fs << "]";
+    
+    fs << "port" << port;
+    fs << "workers" << numWorkers;
+    fs << "shared_memory" << sharedMemoryName;
+    fs << "headless" << (int)headless;
+    fs << "auto_start" << (int)autoStart;
+    fs << "overlay_interval" << overlayInterval;
+    fs << "crop_margin" << cropMargin;
+    fs << "full_frame_interval" << fullFrameInterval;
+    fs << "decoder_threads" << decoderThreads;
+    fs << "motion_smoothing" << motionSmoothing;
+    fs << "max_extrapolation" << maxExtrapolation;
+    fs << "record_directory" << recordDirectory;
+    fs << "half_float_depth" << (int)halfFloatDepth;
+    
+    return fs.releaseAndGetString();
+}
+
+
+bool TrackingConfig::parse(int argc, char *argv[])
+{
+    // the configuration file is the base for all other options
+    for(int i = 1; i < argc - 1; i++)
+    {
+        if(strcmp(argv[i], "--config") == 0 && !load(argv[i + 1]))
+            return false;
+    }
+    
+    bool modelsGiven = false;
+    for(int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        
+        if(option == "--headless" || option == "--server")
+            headless = true;
+        else if(option == "--auto-start")
+            autoStart = true;
+        else if(option == "--half-float-depth")
+            halfFloatDepth = true;
+        else if(!hasValue)
+        {
+            cout << "unknown option or missing value: " << option << endl;
+            return false;
+        }
+        else
+        {
+            string value = argv[++i];
+            vector<float> values = splitValues(value);
+            
+            if(option == "--config")
+                continue;
+            else if(option == "--port")
+                port = atoi(value.c_str());
+            else if(option == "--workers")
+                numWorkers = atoi(value.c_str());
+            else if(option == "--shm")
+                sharedMemoryName = value;
+            else if(option == "--overlay")
+                overlayInterval = atoi(value.c_str());
+            else if(option == "--record")
+                recordDirectory = value;
+            else if(option == "--distances")
+                templateDistances = values;
+            else if(option == "--size" && values.size() == 2)
+            {
+                width = (int)values[0];
+                height = (int)values[1];
+            }
+            else if(option == "--intrinsics" && values.size() == 4)
+                K = Matx33f(values[0], 0, values[2], 0, values[1], values[3], 0, 0, 1);
+            else if(option == "--model")
+            {
+                // the first model replaces the default ones
+                if(!modelsGiven)
+                    objects.clear();
+                modelsGiven = true;
+                
+                string filename = value.substr(0, value.find(','));
+                vector<float> pose = (value.find(',') != string::npos) ? splitValues(value.substr(value.find(',') + 1)) : vector<float>();
+                pose.resize(8, 0.0f);
+                
+                ObjectConfig object = {filename, pose[0], pose[1], pose[2], pose[3], pose[4], pose[5], (pose[6] > 0) ? pose[6] : 1.0f, (pose[7] > 0) ? pose[7] : 0.55f};
+                objects.push_back(object);
+            }
+            else
+            {
+                cout << "unknown option or invalid value: " << option << " " << value << endl;
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
@@ -0,0 +1,164 @@
+#ifndef TRACKING_CONFIG_H
+#define TRACKING_CONFIG_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/**
+ *  The model file and initial pose of a 3D object to be tracked, i.e. the
+ *  arguments of the Object3D constructor.
+ */
+struct ObjectConfig
+{
+    std::string filename;
+    
+    // initial translation and Euler angles in degrees
+    float tx, ty, tz;
+    float alpha, beta, gamma;
+    
+    float scale;
+    
+    float qualityThreshold;
+};
+
+/**
+ *  Everything a tracking session needs to know about the camera, the
+ *  objects and the streaming parameters. The default values correspond
+ *  to the HoloLens photo camera tracking the egg box model.
+ *
+ *  The values can be read from a YAML or XML file written with
+ *  cv::FileStorage, all keys are optional:
+ *
+ *      width: 1408
+ *      height: 792
+ *      camera_matrix: !!opencv-matrix (3x3, f)
+ *      distortion_coefficients: !!opencv-matrix (1x4, f)
+ *      z_near: 10.0
+ *      z_far: 10000.0
+ *      template_distances: [ 200.0, 400.0, 600.0 ]
+ *      objects:
+ *         - { file: "data/eggbox.obj", pose: [ 15, 0, 500, 195, -10, -20 ], scale: 1.0, quality_threshold: 0.55 }
+ *      port: 27015
+ *      shared_memory: "/rbot"
+ *      workers: 2
+ *      headless: 1
+ *      auto_start: 0
+ *      overlay_interval: 1
+ *      crop_margin: 64
+ *      full_frame_interval: 30
+ *      decoder_threads: 2
+ *      motion_smoothing: 0.5
+ *      max_extrapolation: 0.1
+ *      record_directory: "recordings"
+ *      half_float_depth: 0
+ */
+struct TrackingConfig
+{
+    TrackingConfig();
+    
+    /**
+     *  Overwrites the values found in a configuration file.
+     *
+     *  @param  filename The path to a YAML or XML file.
+     *  @return True if the file could be read and false otherwise.
+     */
+    bool load(const std::string &filename);
+    
+    /**
+     *  Same as load but reads the values from a string, e.g. one returned
+     *  by toString.
+     *
+     *  @param  yaml The contents of a YAML configuration file.
+     *  @return True if the string could be parsed and false otherwise.
+     */
+    bool loadString(const std::string &yaml);
+    
+    /**
+     *  Writes all values in the format read by load.
+     *
+     *  @return The contents of a YAML configuration file.
+     */
+    std::string toString() const;
+    
+    /**
+     *  Overwrites the values given on the command line. A configuration file
+     *  given with --config is loaded first, the other options override it:
+     *
+     *      --config <file>       load a configuration file
+     *      --headless            serve clients without any window (also --server)
+     *      --port <n>            the TCP port to listen on
+     *      --shm <name>          take the frames from a local producer through shared memory instead of TCP
+     *      --workers <n>         the number of tracking threads of the headless server
+     *      --model <file>[,tx,ty,tz,alpha,beta,gamma[,scale[,threshold]]]
+     *                            track this model instead of the default, may be repeated
+     *      --intrinsics fx,fy,cx,cy
+     *      --size <width>,<height>
+     *      --distances d1,d2,... the template distances
+     *      --auto-start          start tracking with the first frame of every session
+     *      --half-float-depth    render the linear depth maps with half float precision
+     *      --overlay <n>         draw the result overlay every n-th frame (0 = never)
+     *      --record <dir>        record every session into a log file in this directory
+     *
+     *  @param  argc The number of arguments.
+     *  @param  argv The arguments including the program name.
+     *  @return True if all arguments were valid and false otherwise.
+     */
+    bool parse(int argc, char *argv[]);
+    
+    // camera image size at full resolution
+    int width;
+    int height;
+    
+    // camera intrinsics
+    cv::Matx33f K;
+    cv::Matx14f distCoeffs;
+    
+    // near and far plane of the OpenGL view frustum
+    float zNear;
+    float zFar;
+    
+    // distances for the pose detection template generation
+    std::vector<float> templateDistances;
+    
+    std::vector<ObjectConfig> objects;
+    
+    // the TCP port and the number of worker threads of the server
+    int port;
+    int numWorkers;
+    
+    // if set, the interactive mode takes its frames from this shared memory segment instead of a TCP client
+    std::string sharedMemoryName;
+    
+    // serve any number of clients without windows and user interaction
+    bool headless;
+    
+    // start tracking with the first frame instead of waiting for a command from the client
+    bool autoStart;
+    
+    // the result overlay is only drawn for every overlayInterval-th frame (0 = never)
+    int overlayInterval;
+    
+    // crops are extended by this many pixels and a downscaled full frame is requested every fullFrameInterval frames
+    int cropMargin;
+    int fullFrameInterval;
+    
+    // number of threads decoding compressed frames per session
+    int decoderThreads;
+    
+    // weight of the previous velocity of the motion models and the longest extrapolation in seconds
+    float motionSmoothing;
+    float maxExtrapolation;
+    
+    // if set, every session is recorded into a log file in this directory, see SessionRecorder
+    std::string recordDirectory;
+    
+    // render the linear depth maps into a half float target to halve their downloads, see RenderingEngine
+    bool halfFloatDepth;
+    
+private:
+    void read(const cv::FileStorage &fs);
+};
+
+#endif /* TRACKING_CONFIG_H */
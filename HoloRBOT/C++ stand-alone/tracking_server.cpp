@@ -0,0 +1,250 @@
+#include "tracking_server.h"
+
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+TrackingServer::TrackingServer(const TrackingConfig &config) : acceptor(io_cont, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), config.port)), signals(io_cont, SIGINT, SIGTERM)
+{
+    this->config = config;
+    
+    running = true;
+    
+    nextSessionID = 0;
+    
+    int numWorkers = max(config.numWorkers, 1);
+    for(int i = 0; i < numWorkers; i++)
+    {
+        workers.push_back(thread(&TrackingServer::work, this));
+    }
+}
+
+
+TrackingServer::~TrackingServer()
+{
+    stop();
+    
+    // the workers leave the remaining queue unprocessed
+    queueCondition.notify_all();
+    for(int i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+    
+    for(list<TrackingSession*>::iterator it = sessions.begin(); it != sessions.end(); it++)
+    {
+        delete *it;
+    }
+    sessions.clear();
+}
+
+
+void TrackingServer::run(int statsInterval)
+{
+    cout << "Accept connections at " << acceptor.local_endpoint().port() << endl;
+    
+    accept();
+    signals.async_wait([this](const boost::system::error_code &error, int signal)
+    {
+        if(!error)
+            stop();
+    });
+    
+    chrono::steady_clock::time_point lastStats = chrono::steady_clock::now();
+    while(running)
+    {
+        // new connections are handled on this thread, such that their rendering engines are created here
+        io_cont.run_for(chrono::milliseconds(100));
+        
+        reapSessions();
+        
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - lastStats).count();
+        if(statsInterval > 0 && elapsed >= statsInterval)
+        {
+            printStats(elapsed);
+            lastStats = chrono::steady_clock::now();
+        }
+    }
+}
+
+
+void TrackingServer::stop()
+{
+    running = false;
+    queueCondition.notify_all();
+}
+
+
+void TrackingServer::schedule(TrackingSession *session)
+{
+    lock_guard<mutex> lock(queueMutex);
+    if(!running || session->scheduled)
+        return;
+    
+    session->scheduled = true;
+    queue.push_back(session);
+    queueCondition.notify_one();
+}
+
+
+void TrackingServer::accept()
+{
+    acceptor.async_accept([this](const boost::system::error_code &error, boost::asio::ip::tcp::socket socket)
+    {
+        if(!error)
+        {
+            int id = nextSessionID++;
+            cout << "session " << id << ": connected from " << socket.remote_endpoint() << endl;
+            
+            // the engine's window has to be created on the main thread, a worker activates its context later on
+            RenderingEngine *renderingEngine = new RenderingEngine();
+            renderingEngine->doneCurrent();
+            
+            // the socket is closed when it goes out of scope, the other sessions keep running
+            if(!renderingEngine->isValid())
+            {
+                cout << "session " << id << ": could not create an OpenGL context, closing the connection" << endl;
+                delete renderingEngine;
+            }
+            else
+            {
+                TrackingSession *session = new TrackingSession(id, std::move(socket), config, renderingEngine);
+                session->setListener([this, session]()
+                {
+                    schedule(session);
+                });
+                sessions.push_back(session);
+                lastProcessed[session] = 0;
+            
+                session->start();
+            
+                // the first run of a worker initializes the session
+                schedule(session);
+            }
+        }
+        else
+            cout << "accept failed: " << error.message() << endl;
+        
+        if(running)
+            accept();
+    });
+}
+
+
+void TrackingServer::work()
+{
+    while(true)
+    {
+        TrackingSession *session;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]()
+            {
+                return !running || !queue.empty();
+            });
+            if(!running)
+                break;
+            
+            session = queue.front();
+            queue.pop_front();
+        }
+        
+        process(session);
+        
+        // requeue the session if a frame arrived while it was processed, its listener did not do it
+        lock_guard<mutex> lock(queueMutex);
+        session->scheduled = false;
+        if(running && session->hasPendingWork())
+        {
+            session->scheduled = true;
+            queue.push_back(session);
+            queueCondition.notify_one();
+        }
+    }
+}
+
+
+void TrackingServer::process(TrackingSession *session)
+{
+    if(session->isFinished())
+        return;
+    
+    RenderingEngine *renderingEngine = session->getRenderingEngine();
+    renderingEngine->makeCurrent();
+    
+    // a failing session is closed, all other sessions continue
+    try
+    {
+        if(!session->isInitialized())
+        {
+            session->initialize();
+            cout << "session " << session->getID() << ": initialized" << endl;
+        }
+        else
+            session->processFrame();
+    }
+    catch(exception &e)
+    {
+        cout << "session " << session->getID() << ": " << e.what() << endl;
+        session->stop();
+    }
+    
+    renderingEngine->doneCurrent();
+}
+
+
+void TrackingServer::reapSessions()
+{
+    list<TrackingSession*>::iterator it = sessions.begin();
+    while(it != sessions.end())
+    {
+        TrackingSession *session = *it;
+        if(!session->isFinished() || session->scheduled)
+        {
+            it++;
+            continue;
+        }
+        
+        // after joining the receiving threads the session cannot be scheduled anymore
+        session->stop();
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if(session->scheduled)
+            {
+                it++;
+                continue;
+            }
+        }
+        
+        cout << "session " << session->getID() << ": processed " << session->getNumProcessed() << " frames, dropped " << session->getNumDropped() << endl;
+        
+        PredictionStatistics prediction = session->getPredictionStatistics();
+        if(prediction.count > 0)
+            cout << "session " << session->getID() << ": prediction error " << prediction.sumTranslationError/prediction.count << " (max " << prediction.maxTranslationError << "), " << prediction.sumRotationError/prediction.count << " deg (max " << prediction.maxRotationError << " deg)" << endl;
+        
+        lastProcessed.erase(session);
+        it = sessions.erase(it);
+        delete session;
+    }
+}
+
+
+void TrackingServer::printStats(double elapsed)
+{
+    if(sessions.empty())
+        return;
+    
+    uint64_t totalProcessed = 0;
+    for(list<TrackingSession*>::iterator it = sessions.begin(); it != sessions.end(); it++)
+    {
+        TrackingSession *session = *it;
+        uint64_t numProcessed = session->getNumProcessed();
+        uint64_t processed = numProcessed - lastProcessed[session];
+        lastProcessed[session] = numProcessed;
+        totalProcessed += processed;
+        
+        cout << "session " << session->getID() << ": " << processed/elapsed << " fps, dropped " << session->getNumDropped() << endl;
+    }
+    cout << sessions.size() << " sessions, " << totalProcessed/elapsed << " fps in total" << endl;
+}
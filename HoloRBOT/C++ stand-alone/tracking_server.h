@@ -0,0 +1,105 @@
+#ifndef TRACKING_SERVER_H
+#define TRACKING_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "boost/asio.hpp"
+#include "boost/asio/ip/tcp.hpp"
+
+#include "tracking_config.h"
+#include "tracking_session.h"
+
+/**
+ *  A tracking server accepting any number of clients, each of which gets
+ *  its own TrackingSession. The sessions are processed by a shared pool of
+ *  worker threads: whenever a session has received a new frame it is queued,
+ *  and the next idle worker activates the session's rendering engine and
+ *  estimates the poses for the newest frame. A session is never processed
+ *  by more than one worker at a time, so sessions do not have to be
+ *  synchronized, and a failing session is closed without affecting others.
+ *
+ *  Since GLFW windows can only be created and destroyed on the main thread,
+ *  run() has to be called from there. It accepts connections, creates the
+ *  rendering engines for new sessions and deletes finished sessions.
+ */
+class TrackingServer
+{
+public:
+    /**
+     *  Constructor of the server listening on the configured port.
+     *
+     *  @param  config The configuration used for every session, including the port and the number of worker threads.
+     */
+    TrackingServer(const TrackingConfig &config);
+    
+    /**
+     *  Stops the workers and deletes all remaining sessions, must be called
+     *  from the main thread.
+     */
+    ~TrackingServer();
+    
+    /**
+     *  Accepts clients and manages the sessions until stop() is called or
+     *  the process receives SIGINT or SIGTERM. Must be called from the main
+     *  thread.
+     *
+     *  @param  statsInterval The interval in seconds in which the throughput of all sessions is printed (0 = never).
+     */
+    void run(int statsInterval = 5);
+    
+    /**
+     *  Makes run() return, can be called from any thread.
+     */
+    void stop();
+    
+    /**
+     *  Queues a session for processing by the next idle worker, unless it is
+     *  already queued or being processed. Can be called from any thread.
+     *
+     *  @param  session The session to be processed.
+     */
+    void schedule(TrackingSession *session);
+
+private:
+    TrackingConfig config;
+    
+    boost::asio::io_context io_cont;
+    boost::asio::ip::tcp::acceptor acceptor;
+    boost::asio::signal_set signals;
+    
+    std::atomic<bool> running;
+    
+    int nextSessionID;
+    
+    // sessions are only added and removed by the main thread
+    std::list<TrackingSession*> sessions;
+    
+    // sessions waiting for a worker, guarded by queueMutex like the scheduled flag of each session
+    std::deque<TrackingSession*> queue;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    
+    std::vector<std::thread> workers;
+    
+    // number of frames processed by each session at the time of the last statistics output
+    std::map<TrackingSession*, uint64_t> lastProcessed;
+    
+    void accept();
+    
+    void work();
+    
+    void process(TrackingSession *session);
+    
+    void reapSessions();
+    
+    void printStats(double elapsed);
+};
+
+#endif /* TRACKING_SERVER_H */
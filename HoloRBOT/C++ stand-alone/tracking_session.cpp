@@ -0,0 +1,590 @@
+#include "tracking_session.h"
+
+#include <iostream>
+
+#include <opencv2/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+// the client delivers horizontally mirrored images, so the crop regions exchanged with it are mirrored as well
+static Rect mirrorCrop(const Rect &crop, int fullWidth)
+{
+    return Rect(fullWidth - crop.x - crop.width, crop.y, crop.width, crop.height);
+}
+
+
+// flips a frame horizontally in place, YUV frames have to keep their chroma with the pixels it belongs to
+static void mirrorFrame(Mat &frame, uint32_t pixelFormat)
+{
+    if(pixelFormat == PIXEL_FORMAT_NV12)
+    {
+        int height = frame.rows*2/3;
+        Mat luma = frame.rowRange(0, height);
+        Mat chroma(height/2, frame.cols/2, CV_8UC2, frame.data + height*frame.step, frame.step);
+        flip(luma, luma, 1);
+        flip(chroma, chroma, 1);
+    }
+    else if(pixelFormat == PIXEL_FORMAT_YUYV)
+    {
+        // flip the pairs and swap the two Y values of every pair
+        Mat pairs(frame.rows, frame.cols/2, CV_8UC4, frame.data, frame.step);
+        flip(pairs, pairs, 1);
+        for(int y = 0; y < pairs.rows; y++)
+        {
+            uchar *pair = pairs.data + y*pairs.step;
+            for(int x = 0; x < pairs.cols; x++, pair+=4)
+            {
+                std::swap(pair[0], pair[2]);
+            }
+        }
+    }
+    else
+    {
+        flip(frame, frame, 1);
+    }
+}
+
+
+TrackingSession::TrackingSession(int id, boost::asio::ip::tcp::socket socket, const TrackingConfig &config, RenderingEngine *renderingEngine) : socket(std::move(socket)), receiver(this->socket, (size_t)config.width*config.height*4), ring(4, (size_t)config.width*config.height*4)
+{
+    this->id = id;
+    this->config = config;
+    this->renderingEngine = renderingEngine;
+    
+    transport = NULL;
+    mirrored = true;
+    
+    init();
+}
+
+
+// the frames stay in the shared memory, so the ring does not need any payload buffers
+TrackingSession::TrackingSession(int id, SharedMemoryTransport *transport, const TrackingConfig &config, RenderingEngine *renderingEngine) : socket(ioContext), receiver(socket, 0), ring(4, 0)
+{
+    this->id = id;
+    this->config = config;
+    this->renderingEngine = renderingEngine;
+    
+    this->transport = transport;
+    mirrored = false;
+    
+    init();
+}
+
+
+void TrackingSession::init()
+{
+    packets = NULL;
+    decoder = NULL;
+    
+    poseEstimator = NULL;
+    
+    trackingStarted = false;
+    framesSinceFullFrame = 0;
+    acquireTimestamp = 0;
+    frameID = 0;
+    
+    recorder = NULL;
+    
+    numProcessed = 0;
+    
+    stopped = false;
+    
+    scheduled = false;
+    
+    receiver.setCommandHandler([this](const CommandMessage &command)
+    {
+        lock_guard<mutex> lock(commandMutex);
+        pendingCommands.push_back(command);
+    });
+    
+    ring.setListener([this]()
+    {
+        if(listener)
+            listener();
+    });
+}
+
+
+TrackingSession::~TrackingSession()
+{
+    stop();
+    
+    // completes the log with its index
+    delete recorder;
+    
+    delete packets;
+    delete transport;
+    
+    if(renderingEngine)
+    {
+        renderingEngine->makeCurrent();
+        
+        for(int i = 0; i < objects.size(); i++)
+        {
+            delete objects[i];
+        }
+        objects.clear();
+        
+        // the engines of the pose estimator render with the session's context
+        delete poseEstimator;
+        delete renderingEngine;
+    }
+}
+
+
+void TrackingSession::stop()
+{
+    stopped = true;
+    
+    // the shutdown wakes up and stops the receiver thread, which in turn stops the decoder
+    boost::system::error_code error;
+    socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, error);
+    if(receiverThread.joinable())
+        receiverThread.join();
+    socket.close(error);
+    
+    delete decoder;
+    decoder = NULL;
+}
+
+
+void TrackingSession::start()
+{
+    if(transport)
+        return;
+    
+    receiverThread = thread(&TrackingSession::receiveFrames, this);
+}
+
+
+void TrackingSession::receiveFrames()
+{
+    boost::system::error_code error;
+    
+    // let the client choose between raw and compressed frames
+    uint32_t serverCodecs = (1 << FRAME_CODEC_RAW) | (1 << FRAME_CODEC_JPEG) | (1 << FRAME_CODEC_PNG);
+    if(!receiver.handshake(serverCodecs, config.width, config.height, error))
+    {
+        cout << "session " << id << ": handshake failed: " << error.message() << endl;
+        ring.close();
+        return;
+    }
+    cout << "session " << id << ": client uses codec " << receiver.getCodec() << endl;
+    
+    FrameRing *target = &ring;
+    if(receiver.getCodec() != FRAME_CODEC_RAW)
+    {
+        packets = new FrameRing(4, receiver.getMaxPayloadLength());
+        decoder = new FrameDecoder(*packets, ring, config.decoderThreads);
+        target = packets;
+    }
+    
+    // receive frames as fast as the client sends them, independent of how long tracking takes
+    while(true)
+    {
+        int slot = target->beginWrite();
+        if(!receiver.receive(target->getFrame(slot), error))
+        {
+            target->abortWrite(slot);
+            break;
+        }
+        target->commitWrite(slot);
+    }
+    
+    if(error == boost::asio::error::eof)
+        cout << "session " << id << ": client disconnected" << endl;
+    else if(error != boost::asio::error::operation_aborted)
+        cout << "session " << id << ": receive failed: " << error.message() << endl;
+    
+    // with compressed frames the decoder closes the tracker's ring once it has finished
+    target->close();
+}
+
+
+void TrackingSession::initialize()
+{
+    // everything created from here on uses the session's context
+    renderingEngine->makeCurrent();
+    
+    for(int i = 0; i < config.objects.size(); i++)
+    {
+        ObjectConfig &o = config.objects[i];
+        objects.push_back(new Object3D(o.filename, o.tx, o.ty, o.tz, o.alpha, o.beta, o.gamma, o.scale, o.qualityThreshold, config.templateDistances));
+    }
+    
+    // the engines of the pose estimator take over the depth format
+    renderingEngine->setHalfFloatDepth(config.halfFloatDepth);
+    
+    poseEstimator = new PoseEstimator6D(config.width, config.height, config.zNear, config.zFar, config.K, config.distCoeffs, objects, renderingEngine);
+    
+    // the constructor leaves the context current
+    renderingEngine->makeCurrent();
+    
+    for(int i = 0; i < objects.size(); i++)
+    {
+        initialPoses.push_back(objects[i]->getPose());
+    }
+    objectPoses.resize(objects.size());
+    motionModels.resize(objects.size(), MotionModel(config.motionSmoothing, config.maxExtrapolation));
+    
+    if(!config.recordDirectory.empty())
+    {
+        string filename = config.recordDirectory + "/session-" + to_string(FrameProtocol::timestamp()/1000000) + "-" + to_string(id) + ".rbotlog";
+        recorder = SessionRecorder::create(filename, config.toString());
+        if(recorder)
+            cout << "session " << id << ": recording into " << filename << endl;
+    }
+}
+
+
+bool TrackingSession::isInitialized()
+{
+    return poseEstimator != NULL;
+}
+
+
+int TrackingSession::acquireFrame(cv::Mat &frame, int timeout)
+{
+    Mat image;
+    FrameHeader *header;
+    uint64_t receiveTimestamp;
+    int slot;
+    if(transport)
+    {
+        slot = (timeout > 0) ? transport->waitForNewest(timeout) : transport->acquireNewest();
+        if(slot < 0)
+            return -1;
+        
+        acquireTimestamp = FrameProtocol::timestamp();
+        
+        // the producer writes the header itself, so it has to be validated here
+        header = &transport->getHeader(slot);
+        if(!FrameProtocol::validateHeader(*header, transport->getMaxPayloadLength(), config.width, config.height))
+        {
+            cout << "session " << id << ": invalid frame header in the shared memory" << endl;
+            transport->release(slot);
+            return -1;
+        }
+        image = transport->image(slot);
+        receiveTimestamp = acquireTimestamp;
+    }
+    else
+    {
+        slot = (timeout > 0) ? ring.waitForNewest(timeout) : ring.acquireNewest();
+        if(slot < 0)
+            return -1;
+        
+        header = &ring.getFrame(slot).header;
+        image = ring.getFrame(slot).image();
+        receiveTimestamp = ring.getFrame(slot).receiveTimestamp;
+    }
+    
+    // the tracker reads all pixel formats directly, it only has to know which one it is
+    frame = image;
+    poseEstimator->setFrameFormat(frameFormat(header->pixelFormat));
+    
+    // tell the tracker which part of the camera image the frame shows
+    Rect crop = Rect(header->cropX, header->cropY, header->width << header->scaleShift, header->height << header->scaleShift);
+    if(mirrored)
+    {
+        mirrorFrame(frame, header->pixelFormat);
+        crop = mirrorCrop(crop, config.width);
+    }
+    if(!poseEstimator->setFrameGeometry(crop, header->scaleShift))
+    {
+        cout << "session " << id << ": frame " << header->frameID << " does not lie within the camera image" << endl;
+        releaseFrame(slot);
+        return -1;
+    }
+    
+    frameID = header->frameID;
+    
+    if(recorder)
+    {
+        LogFrame logFrame = {header->frameID, header->pixelFormat, header->width, header->height, crop.x, crop.y, crop.width, crop.height, header->scaleShift, header->captureTimestamp, receiveTimestamp, header->displayTimestamp};
+        recorder->recordFrame(logFrame, frame);
+    }
+    
+    return slot;
+}
+
+
+bool TrackingSession::sendReply(int slot)
+{
+    // request only the region around the tracked objects for the next frame, but the whole image at a lower
+    // resolution from time to time and while an object is lost, such that it can be relocalized
+    Rect nextCrop = poseEstimator->predictCrop(config.cropMargin);
+    int nextScaleShift = 0;
+    if(nextCrop.area() == 0)
+    {
+        // keep full resolution until tracking is started, the histograms are initialized from it
+        bool anyInitialized = false;
+        for(int i = 0; i < objects.size(); i++)
+            anyInitialized |= objects[i]->isInitialized();
+        
+        nextCrop = Rect(0, 0, config.width, config.height);
+        nextScaleShift = anyInitialized ? 1 : 0;
+    }
+    else if(++framesSinceFullFrame >= config.fullFrameInterval)
+    {
+        nextCrop = Rect(0, 0, config.width, config.height);
+        nextScaleShift = 1;
+        framesSinceFullFrame = 0;
+    }
+    if(mirrored)
+        nextCrop = mirrorCrop(nextCrop, config.width);
+    
+    FrameHeader &header = transport ? transport->getHeader(slot) : ring.getFrame(slot).header;
+    
+    CropRequest cropRequest;
+    cropRequest.magic = CROP_MAGIC;
+    cropRequest.frameID = header.frameID;
+    cropRequest.x = nextCrop.x;
+    cropRequest.y = nextCrop.y;
+    cropRequest.width = nextCrop.width;
+    cropRequest.height = nextCrop.height;
+    cropRequest.scaleShift = nextScaleShift;
+    
+    bool extrapolate = header.displayTimestamp > header.captureTimestamp;
+    
+    for(int i = 0; i < objects.size(); i++)
+    {
+        objectPoses[i].flags = 0;
+        if(objects[i]->isInitialized())
+            objectPoses[i].flags |= OBJECT_POSE_INITIALIZED;
+        if(objects[i]->isTrackingLost())
+            objectPoses[i].flags |= OBJECT_POSE_LOST;
+        
+        // the motion is only known while an object is tracked
+        Matx44f pose = objects[i]->getPose();
+        if(objects[i]->isInitialized() && !objects[i]->isTrackingLost())
+        {
+            motionModels[i].update(pose, header.captureTimestamp);
+            if(extrapolate)
+            {
+                pose = motionModels[i].predict(header.displayTimestamp);
+                objectPoses[i].flags |= OBJECT_POSE_EXTRAPOLATED;
+            }
+        }
+        else
+            motionModels[i].reset();
+        
+        // the client expects the poses relative to the initial poses
+        Matx44f deltaPose = pose*initialPoses[i].inv();
+        copy(deltaPose.val, deltaPose.val + 16, objectPoses[i].pose);
+        
+        objectPoses[i].energy = objects[i]->getEnergy();
+    }
+    
+    PoseReply poseReply;
+    poseReply.magic = POSE_MAGIC;
+    poseReply.frameID = header.frameID;
+    poseReply.captureTimestamp = header.captureTimestamp;
+    poseReply.receiveTimestamp = transport ? acquireTimestamp : ring.getFrame(slot).receiveTimestamp;
+    poseReply.displayTimestamp = header.displayTimestamp;
+    poseReply.numObjects = (uint32_t)objectPoses.size();
+    
+    numProcessed++;
+    
+    if(transport)
+    {
+        poseReply.sendTimestamp = FrameProtocol::timestamp();
+        transport->sendReply(cropRequest, poseReply, objectPoses);
+        return true;
+    }
+    
+    // the whole reply is sent with a single write, the send timestamp is taken right before
+    vector<boost::asio::const_buffer> buffers;
+    buffers.push_back(boost::asio::buffer(&cropRequest, sizeof(CropRequest)));
+    buffers.push_back(boost::asio::buffer(&poseReply, sizeof(PoseReply)));
+    buffers.push_back(boost::asio::buffer(objectPoses));
+    
+    poseReply.sendTimestamp = FrameProtocol::timestamp();
+    
+    boost::system::error_code error;
+    boost::asio::write(socket, buffers, error);
+    
+    if(error)
+    {
+        cout << "session " << id << ": send failed: " << error.message() << endl;
+        socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, error);
+        return false;
+    }
+    return true;
+}
+
+
+void TrackingSession::releaseFrame(int slot)
+{
+    if(transport)
+        transport->release(slot);
+    else
+        ring.release(slot);
+}
+
+
+void TrackingSession::applyCommands(cv::Mat &frame)
+{
+    vector<CommandMessage> commands;
+    {
+        lock_guard<mutex> lock(commandMutex);
+        commands.swap(pendingCommands);
+    }
+    if(transport)
+        transport->takeCommands(commands);
+    
+    // without a command from the client tracking starts right away with the initial poses
+    if(config.autoStart && !trackingStarted)
+    {
+        CommandMessage start = {COMMAND_MAGIC, COMMAND_START_TRACKING, -1};
+        commands.insert(commands.begin(), start);
+        trackingStarted = true;
+    }
+    
+    for(int c = 0; c < commands.size(); c++)
+    {
+        CommandMessage &command = commands[c];
+        switch(command.command)
+        {
+            case COMMAND_START_TRACKING:
+            case COMMAND_STOP_TRACKING:
+                for(int i = 0; i < objects.size(); i++)
+                {
+                    if(command.objectIndex >= 0 && command.objectIndex != i)
+                        continue;
+                    
+                    // toggling either initializes the histograms or resets the object
+                    bool start = command.command == COMMAND_START_TRACKING;
+                    if(objects[i]->isInitialized() != start)
+                        toggleTracking(frame, i);
+                }
+                break;
+            case COMMAND_RESET:
+                reset();
+                trackingStarted = false;
+                break;
+            default:
+                cout << "session " << id << ": unknown command " << command.command << endl;
+                break;
+        }
+    }
+}
+
+
+void TrackingSession::toggleTracking(cv::Mat &frame, int objectIndex)
+{
+    poseEstimator->toggleTracking(frame, objectIndex, false);
+    
+    if(recorder)
+        recorder->recordToggle(objectIndex);
+}
+
+
+void TrackingSession::reset()
+{
+    poseEstimator->reset();
+    
+    if(recorder)
+        recorder->recordReset();
+}
+
+
+void TrackingSession::estimatePoses(cv::Mat &frame, bool checkForLoss)
+{
+    poseEstimator->estimatePoses(frame, false, checkForLoss);
+    
+    if(recorder)
+        recorder->recordPoses(frameID, checkForLoss, objects);
+}
+
+
+bool TrackingSession::processFrame()
+{
+    Mat frame;
+    int slot = acquireFrame(frame);
+    if(slot < 0)
+        return false;
+    
+    applyCommands(frame);
+    
+    estimatePoses(frame);
+    
+    sendReply(slot);
+    
+    releaseFrame(slot);
+    
+    return true;
+}
+
+
+bool TrackingSession::hasPendingWork()
+{
+    return !stopped && (!isInitialized() || (transport ? transport->hasNewest() : ring.hasNewest()));
+}
+
+
+bool TrackingSession::isFinished()
+{
+    if(transport)
+        return stopped || (transport->isClosed() && !transport->hasNewest());
+    
+    return stopped || (ring.isClosed() && !ring.hasNewest());
+}
+
+
+void TrackingSession::setListener(std::function<void()> listener)
+{
+    this->listener = listener;
+}
+
+
+int TrackingSession::getID()
+{
+    return id;
+}
+
+
+vector<Object3D*>& TrackingSession::getObjects()
+{
+    return objects;
+}
+
+
+PoseEstimator6D* TrackingSession::getPoseEstimator()
+{
+    return poseEstimator;
+}
+
+
+RenderingEngine* TrackingSession::getRenderingEngine()
+{
+    return renderingEngine;
+}
+
+
+uint64_t TrackingSession::getNumProcessed()
+{
+    return numProcessed;
+}
+
+
+uint64_t TrackingSession::getNumDropped()
+{
+    if(transport)
+        return transport->getNumDropped();
+    
+    return ring.getNumDropped();
+}
+
+
+PredictionStatistics TrackingSession::getPredictionStatistics()
+{
+    PredictionStatistics statistics;
+    for(int i = 0; i < motionModels.size(); i++)
+    {
+        statistics.add(motionModels[i].getStatistics());
+    }
+    return statistics;
+}
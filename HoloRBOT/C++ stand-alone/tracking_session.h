@@ -0,0 +1,295 @@
+#ifndef TRACKING_SESSION_H
+#define TRACKING_SESSION_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "boost/asio.hpp"
+#include "boost/asio/ip/tcp.hpp"
+
+#include <opencv2/core.hpp>
+
+#include "tracking_config.h"
+#include "frame_receiver.h"
+#include "frame_ring.h"
+#include "frame_decoder.h"
+#include "object3d.h"
+#include "pose_estimator6d.h"
+#include "rendering_engine.h"
+#include "motion_model.h"
+#include "shared_memory_transport.h"
+#include "session_recorder.h"
+
+/**
+ *  This class holds everything needed for tracking the objects seen by a
+ *  single connected client: the socket with its receiver thread, the frame
+ *  rings and decoders, and a pose estimator with its own objects and
+ *  rendering engine. Sessions do not share any tracking state, such that
+ *  several of them can be processed concurrently by different threads,
+ *  as long as each session is only processed by one thread at a time.
+ *
+ *  Instead of a socket, a session can also take its frames from a producer
+ *  on the same host through a SharedMemoryTransport. Such frames are
+ *  tracked directly in the shared memory and are not mirrored.
+ *
+ *  If a record directory is configured, the session is recorded into a
+ *  session log, which is why the pose estimator should only be called
+ *  through the session.
+ */
+class TrackingSession
+{
+public:
+    /**
+     *  Constructor of a session for an accepted client connection.
+     *
+     *  @param  id A number identifying the session in log messages.
+     *  @param  socket The connected socket, the session takes ownership of it.
+     *  @param  config The camera, object and streaming parameters.
+     *  @param  renderingEngine The rendering engine whose OpenGL context is used exclusively by this session, it is destroyed together with the session.
+     */
+    TrackingSession(int id, boost::asio::ip::tcp::socket socket, const TrackingConfig &config, RenderingEngine *renderingEngine);
+    
+    /**
+     *  Constructor of a session for a producer on the same host.
+     *
+     *  @param  id A number identifying the session in log messages.
+     *  @param  transport The shared memory the producer writes its frames to, the session takes ownership of it.
+     *  @param  config The camera, object and streaming parameters.
+     *  @param  renderingEngine The rendering engine whose OpenGL context is used exclusively by this session, it is destroyed together with the session.
+     */
+    TrackingSession(int id, SharedMemoryTransport *transport, const TrackingConfig &config, RenderingEngine *renderingEngine);
+    
+    /**
+     *  Closes the connection and releases all resources. If the session
+     *  was initialized, the OpenGL context of its rendering engine must not
+     *  be current on any other thread, since it is activated for deleting
+     *  the objects and the engine.
+     */
+    ~TrackingSession();
+    
+    /**
+     *  Starts the receiver thread, which performs the handshake with the
+     *  client and then receives frames until the connection is closed.
+     *  Shared memory sessions do not need a receiver thread.
+     */
+    void start();
+    
+    /**
+     *  Closes the connection and waits for the receiving threads to finish.
+     *  Afterwards no more frames are received and the listener will not be
+     *  called anymore.
+     */
+    void stop();
+    
+    /**
+     *  Loads the 3D objects and creates the pose estimator including the
+     *  templates for pose detection. The rendering engine of the session
+     *  becomes the instance of the calling thread and its context is made
+     *  current.
+     */
+    void initialize();
+    
+    bool isInitialized();
+    
+    /**
+     *  Takes the newest received frame and tells the pose estimator which
+     *  part of the camera image it shows and in which channel order.
+     *
+     *  @param  frame The resulting camera frame, referring to the slot memory where possible.
+     *  @param  timeout The maximum time in milliseconds to wait for a frame (default = 0).
+     *  @return The slot of the frame, which must be handed back with releaseFrame, or -1 if no frame is available.
+     */
+    int acquireFrame(cv::Mat &frame, int timeout = 0);
+    
+    /**
+     *  Sends the crop request for the next frame and the pose reply with the
+     *  timestamps of the processed frame and the current poses of all
+     *  objects to the client. The poses of tracked objects are extrapolated
+     *  to the display timestamp requested by the client.
+     *
+     *  @param  slot The slot of the processed frame.
+     *  @return False if sending failed and true otherwise.
+     */
+    bool sendReply(int slot);
+    
+    /**
+     *  Hands a frame slot back to the receiver.
+     *
+     *  @param  slot The slot as returned by acquireFrame.
+     */
+    void releaseFrame(int slot);
+    
+    /**
+     *  Applies the commands received from the client since the last frame,
+     *  i.e. starts, stops or resets tracking. If the session is configured to
+     *  start automatically, tracking is started for all objects as well.
+     *
+     *  @param  frame The current camera frame, from which the histograms are initialized when tracking starts.
+     */
+    void applyCommands(cv::Mat &frame);
+    
+    /**
+     *  Starts or stops tracking an object with the current frame, see
+     *  PoseEstimator6D::toggleTracking.
+     *
+     *  @param  frame The current camera frame.
+     *  @param  objectIndex The index of the object.
+     */
+    void toggleTracking(cv::Mat &frame, int objectIndex);
+    
+    /**
+     *  Stops tracking all objects, see PoseEstimator6D::reset.
+     */
+    void reset();
+    
+    /**
+     *  Estimates the poses of all objects in the current frame, see
+     *  PoseEstimator6D::estimatePoses. The frame is not undistorted.
+     *
+     *  @param  frame The current camera frame.
+     *  @param  checkForLoss A flag indicating whether it should be checked for a tracking loss (default = true).
+     */
+    void estimatePoses(cv::Mat &frame, bool checkForLoss = true);
+    
+    /**
+     *  Processes the newest received frame without any user interaction:
+     *  the received commands are applied, the poses are estimated and sent
+     *  back to the client.
+     *
+     *  @return True if a frame was processed and false if none was available.
+     */
+    bool processFrame();
+    
+    /**
+     *  Returns whether the session has work to do, i.e. whether it still has
+     *  to be initialized or a new frame is waiting to be processed.
+     *
+     *  @return True if the session should be scheduled for processing.
+     */
+    bool hasPendingWork();
+    
+    /**
+     *  Returns whether the session has been stopped or the client has
+     *  disconnected and all frames have been processed.
+     *
+     *  @return True if the session can be deleted.
+     */
+    bool isFinished();
+    
+    /**
+     *  Sets a function that is called by the receiving threads whenever a
+     *  new frame can be processed or the client has disconnected.
+     *
+     *  @param  listener The function to be called.
+     */
+    void setListener(std::function<void()> listener);
+    
+    int getID();
+    
+    std::vector<Object3D*>& getObjects();
+    
+    PoseEstimator6D* getPoseEstimator();
+    
+    RenderingEngine* getRenderingEngine();
+    
+    /**
+     *  Returns the number of frames processed by the session so far.
+     *
+     *  @return The number of processed frames.
+     */
+    uint64_t getNumProcessed();
+    
+    /**
+     *  Returns the number of received frames that were dropped, because a
+     *  newer frame was available.
+     *
+     *  @return The number of dropped frames.
+     */
+    uint64_t getNumDropped();
+    
+    /**
+     *  Returns the error statistics of the motion models of all objects,
+     *  i.e. how well every pose estimate was predicted from the previous
+     *  ones.
+     *
+     *  @return The prediction error statistics of the session.
+     */
+    PredictionStatistics getPredictionStatistics();
+    
+    // set while the session is queued for or being processed by a worker
+    std::atomic<bool> scheduled;
+
+private:
+    int id;
+    
+    TrackingConfig config;
+    
+    // only used for constructing the unused socket of shared memory sessions
+    boost::asio::io_context ioContext;
+    
+    boost::asio::ip::tcp::socket socket;
+    
+    // replaces the socket, the receiver and the rings if the frames come from a local producer
+    SharedMemoryTransport *transport;
+    
+    FrameReceiver receiver;
+    
+    // the ring the tracker takes its frames from
+    FrameRing ring;
+    
+    // compressed frames are received into a separate ring and decoded from there into the tracker's ring
+    FrameRing *packets;
+    FrameDecoder *decoder;
+    
+    std::thread receiverThread;
+    
+    std::function<void()> listener;
+    
+    // commands are received by the receiver thread and applied by the thread processing the session
+    std::mutex commandMutex;
+    std::vector<CommandMessage> pendingCommands;
+    
+    RenderingEngine *renderingEngine;
+    
+    std::vector<Object3D*> objects;
+    
+    PoseEstimator6D *poseEstimator;
+    
+    // the initial poses of the objects, poses are sent relative to them
+    std::vector<cv::Matx44f> initialPoses;
+    
+    // one motion model per object, only accessed by the thread processing the session
+    std::vector<MotionModel> motionModels;
+    
+    // the pose reply is assembled here for every frame
+    std::vector<ObjectPose> objectPoses;
+    
+    // set once tracking has been started automatically, until the next reset
+    bool trackingStarted;
+    
+    int framesSinceFullFrame;
+    
+    // the frames of the HoloLens client are mirrored
+    bool mirrored;
+    
+    // the time the current shared memory frame has been taken, corresponding to the receive time of a socket frame
+    uint64_t acquireTimestamp;
+    
+    // the ID of the current frame
+    uint32_t frameID;
+    
+    // records the session if configured, NULL otherwise
+    SessionRecorder *recorder;
+    
+    std::atomic<uint64_t> numProcessed;
+    
+    std::atomic<bool> stopped;
+    
+    void init();
+    
+    void receiveFrames();
+};
+
+#endif /* TRACKING_SESSION_H */
@@ -180,10 +180,12 @@ Matx44f Transformations::exp(Matx61f xi)
     // angle of the twist/rotation
     float theta = norm(r);
     
-    // return the identity group element for theta == 0, as there is no motion
+    // without rotation the twist is a pure translation
     if(abs(theta) < FLT_EPSILON)
     {
-        return T;
+        T(0, 3) = v[0];
+        T(1, 3) = v[1];
+        T(2, 3) = v[2];
     }
     else
     {
@@ -212,3 +214,35 @@ Matx44f Transformations::exp(Matx61f xi)
     
     return T;
 }
+
+Matx61f Transformations::log(const Matx44f &T)
+{
+    Matx33f R = T.get_minor<3, 3>(0, 0);
+    Vec3f t = Vec3f(T(0, 3), T(1, 3), T(2, 3));
+    
+    // rotational part of the twist coordinates as the matrix logarithm of R
+    Vec3f r;
+    Rodrigues(R, r);
+    
+    float theta = norm(r);
+    
+    Vec3f v;
+    if(abs(theta) < FLT_EPSILON)
+    {
+        // a pure translation
+        v = t;
+    }
+    else
+    {
+        // invert the computation of the translation vector in exp
+        Matx33f I = Matx33f::eye();
+        Vec3f w = r/theta;
+        Matx33f w_x = Transformations::axiator(w);
+        
+        Matx33f A = (I - R)*w_x + w*w.t()*theta;
+        
+        v = A.inv()*t*theta;
+    }
+    
+    return Matx61f(r[0], r[1], r[2], v[0], v[1], v[2]);
+}
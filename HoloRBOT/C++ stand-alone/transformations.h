@@ -157,6 +157,16 @@ public:
      *  @return A 4x4 homogenbeous rigid body transformation matrix corresponding to the twist coordinates.
      */
     static cv::Matx44f exp(cv::Matx61f xi);
+    
+    /**
+     *  Computes the logarithmic map from a given rigid body transform in 4x4
+     *  homogeneous matrix representation to the corresponding 6D vector of
+     *  twist coordinates, i.e. the inverse of exp.
+     *
+     *  @param T A 4x4 homogenbeous rigid body transformation matrix.
+     *  @return A 6D vector of twist coordinates corresponding to the rigid body transformation.
+     */
+    static cv::Matx61f log(const cv::Matx44f &T);
 };
 
 #endif //TRANSFORMATIONS_H
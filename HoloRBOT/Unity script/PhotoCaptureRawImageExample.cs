@@ -14,6 +14,39 @@ public class PhotoCaptureRawImageExample : MonoBehaviour
     private TcpClient socketConnection;
     private Thread m_NetworkThread;
     Resolution cameraResolution
+    uint frameID = 0;
+
+    // frame header of the tracking server protocol, see frame_protocol.h
+    const uint FRAME_MAGIC = 0x46425248;
+    const uint PIXEL_FORMAT_BGRA = 0;
+    const int FRAME_HEADER_SIZE = 52;
+
+    // handshake of the tracking server protocol, the server chooses the codec
+    const uint HELLO_MAGIC = 0x48425248;
+    const uint PROTOCOL_VERSION = 5;
+    const uint FRAME_CODEC_RAW = 0;
+    const uint FRAME_CODEC_JPEG = 1;
+    const int HELLO_REPLY_SIZE = 20;
+    uint codec = FRAME_CODEC_RAW;
+
+    // region of the camera image requested by the server for the next frame, see CropRequest in frame_protocol.h
+    const uint CROP_MAGIC = 0x43425248;
+    const int CROP_REQUEST_SIZE = 28;
+    // commands controlling the tracking, see CommandMessage in frame_protocol.h
+    const uint COMMAND_MAGIC = 0x4D425248;
+    const uint COMMAND_START_TRACKING = 0;
+    const uint COMMAND_RESET = 2;
+    readonly object sendLock = new object();
+
+    // followed by the timestamps of the frame and the poses of all objects, see PoseReply and ObjectPose in frame_protocol.h
+    const uint POSE_MAGIC = 0x50425248;
+    const int POSE_REPLY_SIZE = 44;
+    const int OBJECT_POSE_SIZE = 72;
+    const uint OBJECT_POSE_LOST = 2;
+    // the server extrapolates the poses by the measured latency, such that they match the time they are shown at (us)
+    long latencyEstimate = 0;
+    readonly object cropLock = new object();
+    int cropX = 0, cropY = 0, cropWidth = 0, cropHeight = 0, cropScaleShift = 0;
 
     // Use this for initialization
     void Start()
@@ -44,12 +77,16 @@ public class PhotoCaptureRawImageExample : MonoBehaviour
         {
             socketConnection = new TcpClient("192.168.1.193", 27015);
 
-            sayHello();
+            negotiateCodec();
             //hearHello();
-            
-            //m_NetworkThread = new Thread(new ThreadStart(NetworkThread));
-            //m_NetworkThread.IsBackground = true;
-            //m_NetworkThread.Start();
+
+            // start with the whole image until the server requests a crop
+            cropWidth = cameraResolution.width;
+            cropHeight = cameraResolution.height;
+
+            m_NetworkThread = new Thread(new ThreadStart(NetworkThread));
+            m_NetworkThread.IsBackground = true;
+            m_NetworkThread.Start();
         }
         catch (Exception e)
         {
@@ -113,7 +150,30 @@ public class PhotoCaptureRawImageExample : MonoBehaviour
             NetworkStream stream = socketConnection.GetStream();
             if (stream.CanWrite)
             {
-                stream.Write(imageBufferList.ToArray(), 0, imageBufferList.Count);
+                int x, y, w, h, shift;
+                lock (cropLock)
+                {
+                    x = cropX; y = cropY; w = cropWidth; h = cropHeight; shift = cropScaleShift;
+                }
+
+                // only send the requested region, JPEG frames are about 10x smaller than raw BGRA32
+                int outWidth = w >> shift;
+                int outHeight = h >> shift;
+                byte[] payload = cropFrame(imageBufferList.ToArray(), x, y, w, h, shift, codec == FRAME_CODEC_JPEG);
+                if (codec == FRAME_CODEC_JPEG)
+                {
+                    Texture2D cropTexture = new Texture2D(outWidth, outHeight, TextureFormat.BGRA32, false);
+                    cropTexture.LoadRawTextureData(payload);
+                    cropTexture.Apply();
+                    payload = cropTexture.EncodeToJPG(80);
+                    Destroy(cropTexture);
+                }
+                byte[] header = createFrameHeader(payload.Length, x, y, outWidth, outHeight, shift);
+                lock (sendLock)
+                {
+                    stream.Write(header, 0, header.Length);
+                    stream.Write(payload, 0, payload.Length);
+                }
                 Debug.Log("Client sent his message - should be received by server");
             }
         }
@@ -125,16 +185,113 @@ public class PhotoCaptureRawImageExample : MonoBehaviour
         m_Sending = !success;
     }
 
-    private void sayHello()
+    // call once the object is aligned with its initial pose, e.g. from an air tap or voice command
+    public void StartTracking()
     {
+        sendCommand(COMMAND_START_TRACKING);
+    }
+
+    public void ResetTracking()
+    {
+        sendCommand(COMMAND_RESET);
+    }
+
+    private void sendCommand(uint command)
+    {
+        // magic, command, object index (-1 = all objects)
+        byte[] message = new byte[12];
+        BitConverter.GetBytes(COMMAND_MAGIC).CopyTo(message, 0);
+        BitConverter.GetBytes(command).CopyTo(message, 4);
+        BitConverter.GetBytes(-1).CopyTo(message, 8);
+        try
+        {
+            lock (sendLock)
+            {
+                socketConnection.GetStream().Write(message, 0, message.Length);
+            }
+        }
+        catch (Exception e)
+        {
+            Debug.Log("Sending command failed: " + e);
+        }
+    }
+
+    private void negotiateCodec()
+    {
+        // magic, version, supported codecs as bit mask
         NetworkStream stream = socketConnection.GetStream();
-        if (stream.CanWrite)
+        byte[] hello = new byte[12];
+        BitConverter.GetBytes(HELLO_MAGIC).CopyTo(hello, 0);
+        BitConverter.GetBytes(PROTOCOL_VERSION).CopyTo(hello, 4);
+        BitConverter.GetBytes((1u << (int)FRAME_CODEC_RAW) | (1u << (int)FRAME_CODEC_JPEG)).CopyTo(hello, 8);
+        stream.Write(hello, 0, hello.Length);
+
+        // magic, version, codec, max width, max height
+        byte[] reply = new byte[HELLO_REPLY_SIZE];
+        int received = 0;
+        while (received < reply.Length)
         {
-            //string clientMessage = "This is a message from one of your clients.";
-            byte[] dataLength = BitConverter.GetBytes(cameraResolution.width * cameraResolution.height);
-            stream.Write(dataLength, 0, sizeof(int));
-            Debug.Log("Client sent his message - should be received by server");
+            int n = stream.Read(reply, received, reply.Length - received);
+            if (n <= 0)
+                return; // server closed the connection, keep sending raw frames
+            received += n;
         }
+        codec = BitConverter.ToUInt32(reply, 8);
+        Debug.Log("Server chose codec " + codec);
+    }
+
+    private byte[] cropFrame(byte[] image, int x, int y, int w, int h, int shift, bool bottomUp)
+    {
+        // copies every (1 << shift)-th pixel of the region, textures expect the rows bottom-up
+        int step = 1 << shift;
+        int outWidth = w >> shift;
+        int outHeight = h >> shift;
+        byte[] crop = new byte[outWidth * outHeight * 4];
+        for (int j = 0; j < outHeight; j++)
+        {
+            int srcRow = (y + j * step) * cameraResolution.width;
+            int dstRow = (bottomUp ? outHeight - 1 - j : j) * outWidth;
+            if (step == 1)
+            {
+                Buffer.BlockCopy(image, (srcRow + x) * 4, crop, dstRow * 4, outWidth * 4);
+                continue;
+            }
+            for (int i = 0; i < outWidth; i++)
+                Buffer.BlockCopy(image, (srcRow + x + i * step) * 4, crop, (dstRow + i) * 4, 4);
+        }
+        return crop;
+    }
+
+    private byte[] createFrameHeader(int payloadLength, int x, int y, int width, int height, int shift)
+    {
+        // magic, frame id, capture timestamp (us), width, height, pixel format, payload length, crop x, crop y, scale shift, display timestamp (us)
+        byte[] header = new byte[FRAME_HEADER_SIZE];
+        ulong timestamp = (ulong)(DateTime.UtcNow.Ticks / 10);
+        BitConverter.GetBytes(FRAME_MAGIC).CopyTo(header, 0);
+        BitConverter.GetBytes(frameID++).CopyTo(header, 4);
+        BitConverter.GetBytes(timestamp).CopyTo(header, 8);
+        BitConverter.GetBytes((uint)width).CopyTo(header, 16);
+        BitConverter.GetBytes((uint)height).CopyTo(header, 20);
+        BitConverter.GetBytes(PIXEL_FORMAT_BGRA).CopyTo(header, 24);
+        BitConverter.GetBytes((uint)payloadLength).CopyTo(header, 28);
+        BitConverter.GetBytes(x).CopyTo(header, 32);
+        BitConverter.GetBytes(y).CopyTo(header, 36);
+        BitConverter.GetBytes((uint)shift).CopyTo(header, 40);
+        BitConverter.GetBytes(timestamp + (ulong)System.Threading.Interlocked.Read(ref latencyEstimate)).CopyTo(header, 44);
+        return header;
+    }
+
+    private bool readExactly(NetworkStream stream, byte[] buffer)
+    {
+        int received = 0;
+        while (received < buffer.Length)
+        {
+            int n = stream.Read(buffer, received, buffer.Length - received);
+            if (n <= 0)
+                return false;
+            received += n;
+        }
+        return true;
     }
 
     private void hearHello()
@@ -162,12 +319,40 @@ public class PhotoCaptureRawImageExample : MonoBehaviour
             // Get a stream object for reading 				
             using ( stream = socketConnection.GetStream())
             {
-                int length;
-                // Read incomming stream into byte arrary. 					
-                while ((length = stream.Read(bytes, 0, bytes.Length)) != 0)
+                byte[] cropData = new byte[CROP_REQUEST_SIZE];
+                byte[] replyData = new byte[POSE_REPLY_SIZE];
+                // every reply starts with the region to send next, followed by the timestamps and the poses
+                while (readExactly(stream, cropData) && readExactly(stream, replyData))
                 {
-                    var incommingData = new byte[length];
-                    Array.Copy(bytes, 0, incommingData, 0, length);
+                    if (BitConverter.ToUInt32(replyData, 0) != POSE_MAGIC)
+                        break;
+                    byte[] incommingData = new byte[BitConverter.ToUInt32(replyData, 40) * OBJECT_POSE_SIZE];
+                    if (!readExactly(stream, incommingData))
+                        break;
+
+                    if (BitConverter.ToUInt32(cropData, 0) == CROP_MAGIC)
+                    {
+                        lock (cropLock)
+                        {
+                            cropX = BitConverter.ToInt32(cropData, 8);
+                            cropY = BitConverter.ToInt32(cropData, 12);
+                            cropWidth = (int)BitConverter.ToUInt32(cropData, 16);
+                            cropHeight = (int)BitConverter.ToUInt32(cropData, 20);
+                            cropScaleShift = (int)BitConverter.ToUInt32(cropData, 24);
+                        }
+                    }
+
+                    // the capture timestamp is echoed, so the latency is measured on the clock of the device
+                    ulong captureTimestamp = BitConverter.ToUInt64(replyData, 8);
+                    ulong serverTime = BitConverter.ToUInt64(replyData, 24) - BitConverter.ToUInt64(replyData, 16);
+                    long latency = (long)((ulong)(DateTime.UtcNow.Ticks / 10) - captureTimestamp);
+                    Debug.Log("latency " + latency / 1000 + " ms, in server " + serverTime / 1000 + " ms");
+                    System.Threading.Interlocked.Exchange(ref latencyEstimate, (System.Threading.Interlocked.Read(ref latencyEstimate) * 7 + latency) / 8);
+
+                    // only the first object is shown, keep its last pose while it is lost
+                    if (incommingData.Length < OBJECT_POSE_SIZE || (BitConverter.ToUInt32(incommingData, 64) & OBJECT_POSE_LOST) != 0)
+                        continue;
+
                     for (int i = 0; i < 16; i++)
                         array[i] = System.BitConverter.toSingle(incommingData + i * 4);
 